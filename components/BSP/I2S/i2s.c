@@ -29,9 +29,10 @@
     .channel_format = I2S_CHANNEL_FMT_RIGHT_LEFT,                           \
     .communication_format = I2S_COMM_FORMAT_STAND_I2S,                      \
     .intr_alloc_flags = 0,                                                  \
-    .dma_buf_count = 16,                                                    \
-    .dma_buf_len = 512,                                                     \
-    .use_apll = false                                                       \
+    .dma_buf_count = I2S_DMA_BUF_COUNT,                                     \
+    .dma_buf_len = I2S_DMA_BUF_LEN,                                         \
+    .use_apll = false,                                                      \
+    .tx_desc_auto_clear = true  /* 发送欠载时输出静音而不是重复旧数据 */    \
 }
 
 /**
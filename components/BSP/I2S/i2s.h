@@ -40,6 +40,8 @@
 #define I2S_DI_IO               (GPIO_NUM_14)               /* ES8388_SDIN */
 #define IS2_MCLK_IO             (GPIO_NUM_3)                /* ES8388_MCLK */
 #define SAMPLE_RATE             (8000)                      /* 采样率: 8kHz (适配230400波特率) */
+#define I2S_DMA_BUF_COUNT       (16)                        /* DMA缓冲区个数 */
+#define I2S_DMA_BUF_LEN         (512)                       /* 每个DMA缓冲区的帧数 */
 
 /* 声明函数 */
 esp_err_t i2s_init(void);                                           /* I2S初始化 */
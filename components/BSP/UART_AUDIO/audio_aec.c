@@ -0,0 +1,493 @@
+/**
+ ****************************************************************************************************
+ * @file        audio_aec.c
+ * @author      Audio Serial Transfer
+ * @version     V1.0
+ * @date        2026-10-17
+ * @brief       回声消除 - 以 I2S 发送流为参考, 用 NLMS 自适应滤波从麦克风信号中减去喇叭回声
+ ****************************************************************************************************
+ */
+
+#include "audio_aec.h"
+#include "audio_mem.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "AUDIO_AEC";
+
+#define REF_MASK            (AUDIO_AEC_REF_FRAMES - 1)
+#define REF_GUARD           1024            /* 环形缓冲中混音任务可能正在覆盖的范围 (采样), 不读 */
+#define CHUNK               256             /* 每次装载参考的麦克风采样数 */
+#define SUB                 32              /* 远端静音/发散判断与 ERLE 统计的子块 (采样) */
+#define ENV_SAMPLES         32              /* 包络每点的采样数 */
+#define ENV_POINTS          (AUDIO_AEC_REF_FRAMES / ENV_SAMPLES)    /* 参考包络点数 */
+#define ENV_MASK            (ENV_POINTS - 1)
+#define ENV_GUARD           (REF_GUARD / ENV_SAMPLES)
+#define ENV_WINDOW          64              /* 延迟估计的麦克风包络窗口 (点) */
+#define ENV_INTERVAL        32              /* 每收到这么多个新包络点估计一次 */
+#define ENV_VAR_MIN         (ENV_WINDOW * 16.0f * 16.0f)    /* 包络起伏太小 (静音/稳态噪声) 不估计 */
+#define DELAY_CORR_MIN      0.6f            /* 接受延迟估计的最小归一化相关 */
+#define FAR_LEVEL           32.0f           /* 远端有声的均方根门限 */
+#define NOISE_LEVEL         64.0f           /* 正则化与双讲判断的噪声底 */
+#define DTD_RATIO           4.0f            /* 残差/回声估计的能量比超过收敛后典型值的倍数, 判为双讲 */
+#define DTD_SMOOTH          (1.0f / 32)     /* 双讲检测的短时能量平滑系数 (每采样) */
+#define DT_MAX_MS           1000            /* 连续冻结超过此时长视为回声路径变化, 重新收敛 */
+#define CONVERGED_RATIO     4.0f            /* ERLE 超过 6 dB 视为已收敛, 之后才做双讲检测 */
+#define DIVERGE_LIMIT       32              /* 连续发散的子块数, 超过后复位权重 */
+#define ERLE_SMOOTH         0.02f           /* ERLE 能量平滑系数 (每子块) */
+
+/* 参考: 混音任务写, 录音任务读 (单生产者单消费者, 先写数据再更新 head) */
+static int16_t *s_ref = NULL;                       /* 下混的单声道参考, 按发送采样序号存放 */
+static volatile uint32_t s_ref_head = 0;            /* 已写入的参考采样数 */
+static uint16_t s_ref_env[ENV_POINTS];              /* 参考包络 (每点平均绝对值) */
+static uint32_t s_ref_env_acc = 0;
+
+/* 滤波器: 仅录音任务使用, 热循环的数据放内部 RAM */
+static float s_w[AUDIO_AEC_MAX_TAPS];               /* 权重, 逆序存放: s_w[taps - 1] 为零延迟 */
+static float s_xb[AUDIO_AEC_MAX_TAPS + CHUNK];      /* 当前块用到的参考, 旧的在前 */
+static uint16_t s_mic_env[ENV_WINDOW];              /* 麦克风包络 (消除前) */
+static uint32_t s_mic_env_n = 0;                    /* 已完成的麦克风包络点数 */
+static uint32_t s_mic_env_acc = 0;
+static uint32_t s_mic_count = 0;                    /* 已处理的麦克风采样数 */
+static uint32_t s_taps = 0;
+static uint32_t s_delay = 0;                        /* 麦克风采样 c 对应参考 c - s_delay, 0 表示未锁定 */
+static int32_t s_est_prev = -1;                     /* 上一次延迟估计 (包络点), 连续两次一致才采用 */
+static uint32_t s_hangover = 0;                     /* 双讲冻结时长 (采样) */
+static uint32_t s_dt_max = 0;                       /* 连续冻结上限 (采样) */
+static uint32_t s_hold = 0;                         /* 剩余冻结采样数 */
+static uint32_t s_frozen = 0;                       /* 连续冻结采样数 */
+static uint32_t s_diverge = 0;                      /* 连续发散子块数 */
+static float s_pe = 0.0f;                           /* 短时残差能量 (每采样) */
+static float s_py = 0.0f;                           /* 短时回声估计能量 (每采样) */
+static float s_ed = 0.0f;                           /* 平滑的麦克风能量 (远端有声且未双讲) */
+static float s_ee = 0.0f;                           /* 平滑的残差能量 */
+static bool s_converged = false;
+
+static volatile bool s_active = false;
+static bool s_enabled = true;
+
+/* 会话: 控制任务在 audio_aec_start 中登记参数并递增序号, 录音任务在下一帧开始时据此复位滤波器,
+ * 上一会话的帧可能仍在录音任务中处理, 控制任务不直接改滤波器状态 */
+static volatile uint32_t s_session = 0;
+static uint32_t s_session_applied = 0;              /* 录音任务已复位到的会话 */
+static uint32_t s_next_taps = 0;                    /* 新会话阶数, 0 表示不消除 */
+static uint32_t s_next_rate = 0;
+
+/* 统计 */
+static uint32_t s_frames = 0;
+static uint32_t s_cycles_max = 0;
+static uint64_t s_cycles_total = 0;
+static uint32_t s_resets = 0;
+
+/**
+ * @brief       点积 (n 为 8 的倍数), 四路累加打断浮点加法的依赖链
+ */
+static inline float dot(const float *a, const float *b, uint32_t n)
+{
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+
+    for (uint32_t k = 0; k < n; k += 4) {
+        s0 += a[k] * b[k];
+        s1 += a[k + 1] * b[k + 1];
+        s2 += a[k + 2] * b[k + 2];
+        s3 += a[k + 3] * b[k + 3];
+    }
+    return (s0 + s1) + (s2 + s3);
+}
+
+/**
+ * @brief       w += g * x (n 为 8 的倍数)
+ */
+static inline void axpy(float *w, const float *x, float g, uint32_t n)
+{
+    for (uint32_t k = 0; k < n; k += 4) {
+        w[k] += g * x[k];
+        w[k + 1] += g * x[k + 1];
+        w[k + 2] += g * x[k + 2];
+        w[k + 3] += g * x[k + 3];
+    }
+}
+
+/**
+ * @brief       清零权重, 重新收敛
+ */
+static void reset_filter(void)
+{
+    memset(s_w, 0, sizeof(s_w));
+    s_hold = 0;
+    s_frozen = 0;
+    s_diverge = 0;
+    s_pe = 0.0f;
+    s_py = 0.0f;
+    s_ed = 0.0f;
+    s_ee = 0.0f;
+    s_converged = false;
+}
+
+/**
+ * @brief       按最近 ENV_WINDOW 个麦克风包络点与参考包络的归一化互相关估计延迟
+ * @note        只在参考环形缓冲的有效范围内搜索, 计算量约 ENV_POINTS × ENV_WINDOW × 3 次乘加,
+ *              每 ENV_INTERVAL 个包络点 (1024 采样) 算一次; 变化超过滤波器余量时才重新对齐
+ */
+static void estimate_delay(void)
+{
+    uint32_t m0 = s_mic_env_n - ENV_WINDOW;
+    uint32_t ref_n = s_ref_head / ENV_SAMPLES;
+    uint32_t oldest = ref_n > ENV_POINTS - ENV_GUARD ? ref_n - (ENV_POINTS - ENV_GUARD) : 0;
+    float mc[ENV_WINDOW];
+    float mean = 0.0f, var = 0.0f;
+
+    if (m0 < oldest) {
+        return;
+    }
+    /* 麦克风窗口去均值 */
+    for (int i = 0; i < ENV_WINDOW; i++) {
+        mc[i] = s_mic_env[(m0 + i) % ENV_WINDOW];
+        mean += mc[i];
+    }
+    mean /= ENV_WINDOW;
+    for (int i = 0; i < ENV_WINDOW; i++) {
+        mc[i] -= mean;
+        var += mc[i] * mc[i];
+    }
+    if (var < ENV_VAR_MIN) {
+        return;
+    }
+
+    /* 延迟 lag: 麦克风点 m 对应参考点 m - lag, 需已写入且未被覆盖 */
+    int32_t lo = (int32_t)(m0 + ENV_WINDOW) - (int32_t)ref_n;
+    int32_t hi = (int32_t)(m0 - oldest);
+    int32_t best = -1;
+    float best_corr = 0.0f;
+
+    for (int32_t lag = lo > 0 ? lo : 0; lag <= hi; lag++) {
+        uint32_t r0 = m0 - (uint32_t)lag;
+        float rmean = 0.0f, cov = 0.0f, rvar = 0.0f;
+        for (int i = 0; i < ENV_WINDOW; i++) {
+            rmean += s_ref_env[(r0 + i) & ENV_MASK];
+        }
+        rmean /= ENV_WINDOW;
+        for (int i = 0; i < ENV_WINDOW; i++) {
+            float r = s_ref_env[(r0 + i) & ENV_MASK] - rmean;
+            cov += mc[i] * r;
+            rvar += r * r;
+        }
+        if (rvar < ENV_VAR_MIN || cov <= 0.0f) {
+            continue;
+        }
+        float corr = cov / sqrtf(var * rvar);
+        if (corr > best_corr) {
+            best_corr = corr;
+            best = lag;
+        }
+    }
+
+    /* 滤波器从 delay 开始覆盖 taps 个采样, 估计点前留 1/4 余量 */
+    int32_t delay = best * ENV_SAMPLES - (int32_t)s_taps / 4;
+    if (best < 0 || best_corr < DELAY_CORR_MIN || delay <= 0) {
+        s_est_prev = -1;
+        return;
+    }
+    if (s_est_prev < 0 || abs(best - s_est_prev) > 1) {
+        s_est_prev = best;
+        return;
+    }
+    s_est_prev = best;
+
+    if (s_delay == 0 || abs(delay - (int32_t)s_delay) > (int32_t)s_taps / 4) {
+        if (s_delay) {
+            s_resets++;
+        }
+        s_delay = (uint32_t)delay;
+        reset_filter();
+        ESP_LOGI(TAG, "参考延迟 %u 采样 (相关 %d%%)", (unsigned)s_delay, (int)(best_corr * 100));
+    }
+}
+
+/**
+ * @brief       累计麦克风包络 (消除前), 未收敛时定期估计延迟
+ */
+static void track_mic(const int16_t *pcm, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        s_mic_env_acc += abs(pcm[i]);
+        if ((s_mic_count + i + 1) % ENV_SAMPLES == 0) {
+            s_mic_env[s_mic_env_n % ENV_WINDOW] = s_mic_env_acc / ENV_SAMPLES;
+            s_mic_env_acc = 0;
+            s_mic_env_n++;
+            /* 已收敛说明延迟正确, 不再估计, 免得双讲时的近端包络造成误判 */
+            if (s_mic_env_n >= ENV_WINDOW && s_mic_env_n % ENV_INTERVAL == 0 && !s_converged) {
+                estimate_delay();
+            }
+        }
+    }
+}
+
+/**
+ * @brief       对 n (≤ CHUNK) 个麦克风采样消除回声
+ */
+static void cancel(int16_t *pcm, size_t n)
+{
+    const uint32_t taps = s_taps;
+    const uint32_t head = s_ref_head;
+    const uint32_t r0 = s_mic_count - s_delay - (taps - 1);    /* s_xb[0] 的参考序号 */
+    const float far_min = taps * FAR_LEVEL * FAR_LEVEL;
+    const float reg = taps * NOISE_LEVEL * NOISE_LEVEL;
+    float power = 0.0f;
+
+    /* 装载参考, 尚未写入或可能正被覆盖的部分按静音 (会话开始时环形缓冲已清零) */
+    for (uint32_t k = 0; k < taps - 1 + n; k++) {
+        uint32_t age = head - (r0 + k);
+        s_xb[k] = (age >= 1 && age <= AUDIO_AEC_REF_FRAMES - REF_GUARD) ? s_ref[(r0 + k) & REF_MASK] : 0.0f;
+    }
+    for (uint32_t k = 0; k < taps - 1; k++) {
+        power += s_xb[k] * s_xb[k];
+    }
+
+    for (size_t s = 0; s < n; s += SUB) {
+        size_t m = (n - s < SUB) ? n - s : SUB;
+        const float *x = s_xb + s;      /* 采样 s + i 的参考窗口为 x[i .. i + taps - 1] */
+        int16_t *d = pcm + s;
+
+        /* 远端静音: 没有回声可消, 只维护窗口能量 */
+        if (power + x[taps - 1] * x[taps - 1] < far_min) {
+            for (size_t i = 0; i < m; i++) {
+                power += x[i + taps - 1] * x[i + taps - 1] - x[i] * x[i];
+            }
+            power = power > 0.0f ? power : 0.0f;
+            continue;
+        }
+
+        /* 双讲检测: 收敛后残差与回声估计的能量比一般稳定在 1/ERLE 附近, 与远端音量无关;
+         * 近端语音使残差突然升高, 即使比回声小也能发现, 此时冻结自适应 AUDIO_AEC_HANGOVER_MS */
+        const float dt_ratio = DTD_RATIO * s_ee / (s_ed + 1.0f);
+        float e_out[SUB];
+        float ed = 0.0f, ee = 0.0f;
+        bool adapted = true;
+        for (size_t i = 0; i < m; i++) {
+            const float *xi = x + i;
+            float newest = xi[taps - 1];
+            power += newest * newest;
+
+            float y = dot(s_w, xi, taps);
+            float di = d[i];
+            float e = di - y;
+            s_pe += DTD_SMOOTH * (e * e - s_pe);
+            s_py += DTD_SMOOTH * (y * y - s_py);
+            if (s_converged && s_pe > dt_ratio * s_py + NOISE_LEVEL * NOISE_LEVEL) {
+                s_hold = s_hangover;
+            }
+            if (s_hold == 0) {
+                axpy(s_w, xi, AUDIO_AEC_MU * e / (power + reg), taps);
+                s_frozen = 0;
+            } else {
+                s_hold--;
+                adapted = false;
+                if (++s_frozen > s_dt_max) {
+                    /* 长时间 "双讲" 多半是回声路径变了: 放开自适应重新收敛 */
+                    s_converged = false;
+                    s_ed = 0.0f;
+                    s_ee = 0.0f;
+                    s_hold = 0;
+                    s_frozen = 0;
+                }
+            }
+
+            power -= xi[0] * xi[0];
+            power = power > 0.0f ? power : 0.0f;
+            e_out[i] = e;
+            ed += di * di;
+            ee += e * e;
+        }
+
+        /* 残差比原信号还大: 滤波器发散, 本子块保留原信号, 持续发散则复位 */
+        if (ee > ed * 2.0f && ed > m * NOISE_LEVEL * NOISE_LEVEL) {
+            if (++s_diverge >= DIVERGE_LIMIT) {
+                s_resets++;
+                reset_filter();
+            }
+            continue;
+        }
+        s_diverge = 0;
+
+        for (size_t i = 0; i < m; i++) {
+            float v = e_out[i];
+            d[i] = v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : (int16_t)lrintf(v));
+        }
+
+        /* ERLE 只在仅有回声时统计, 近端语音会把残差抬高 */
+        if (adapted) {
+            s_ed += ERLE_SMOOTH * (ed - s_ed);
+            s_ee += ERLE_SMOOTH * (ee - s_ee);
+            s_converged = s_ed > CONVERGED_RATIO * s_ee;
+        }
+    }
+}
+
+/**
+ * @brief       初始化
+ */
+esp_err_t audio_aec_init(void)
+{
+    if (s_ref) {
+        return ESP_OK;
+    }
+    s_ref = audio_mem_alloc("aec_ref", AUDIO_MEM_PSRAM, AUDIO_AEC_REF_FRAMES * sizeof(int16_t));
+    if (!s_ref) {
+        ESP_LOGE(TAG, "参考缓冲分配失败");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief       开启/关闭回声消除
+ */
+void audio_aec_set_enabled(bool enable)
+{
+    s_enabled = enable;
+}
+
+/**
+ * @brief       查询是否开启
+ */
+bool audio_aec_enabled(void)
+{
+    return s_enabled;
+}
+
+/**
+ * @brief       开始一个会话 (控制任务, 混音已停): 清空参考, 滤波器留给录音任务复位
+ */
+void audio_aec_start(uint32_t rate)
+{
+    uint32_t taps = AUDIO_AEC_TAP_BUDGET / rate;
+
+    s_active = false;
+    taps = (taps > AUDIO_AEC_MAX_TAPS ? AUDIO_AEC_MAX_TAPS : taps) & ~7u;
+    if (!s_enabled || !s_ref) {
+        taps = 0;
+    } else if (taps < AUDIO_AEC_MIN_TAPS) {
+        ESP_LOGW(TAG, "%u Hz 下阶数不足 (%u), 不做回声消除", (unsigned)rate, (unsigned)taps);
+        taps = 0;
+    }
+
+    if (taps) {
+        memset(s_ref, 0, AUDIO_AEC_REF_FRAMES * sizeof(int16_t));
+        memset(s_ref_env, 0, sizeof(s_ref_env));
+        s_ref_env_acc = 0;
+        s_ref_head = 0;
+    }
+    s_next_taps = taps;
+    s_next_rate = rate;
+    s_session++;                /* 先登记参数再递增序号, 最后开启 */
+    s_active = (taps != 0);
+
+    if (taps) {
+        ESP_LOGI(TAG, "回声消除: %u Hz, %u 阶 (%u ms)", (unsigned)rate, (unsigned)taps,
+                 (unsigned)(taps * 1000 / rate));
+    }
+}
+
+/**
+ * @brief       按新会话复位滤波器与统计 (录音任务)
+ */
+static void apply_session(void)
+{
+    s_session_applied = s_session;
+    s_taps = s_next_taps;
+    s_hangover = s_next_rate * AUDIO_AEC_HANGOVER_MS / 1000;
+    s_dt_max = s_next_rate * DT_MAX_MS / 1000;
+    s_delay = 0;
+    s_mic_env_n = 0;
+    s_mic_env_acc = 0;
+    s_mic_count = 0;
+    s_est_prev = -1;
+    s_frames = 0;
+    s_cycles_max = 0;
+    s_cycles_total = 0;
+    s_resets = 0;
+    reset_filter();
+}
+
+/**
+ * @brief       结束会话
+ */
+void audio_aec_stop(void)
+{
+    s_active = false;
+}
+
+/**
+ * @brief       记录一块发送参考
+ */
+void audio_aec_push_ref(const int16_t *stereo, size_t frames)
+{
+    if (!s_active) {
+        return;
+    }
+
+    uint32_t head = s_ref_head;
+    for (size_t i = 0; i < frames; i++) {
+        int16_t v = (stereo[i * 2] + stereo[i * 2 + 1]) / 2;
+        uint32_t idx = head + i;
+        s_ref[idx & REF_MASK] = v;
+        s_ref_env_acc += abs(v);
+        if ((idx + 1) % ENV_SAMPLES == 0) {
+            s_ref_env[(idx / ENV_SAMPLES) & ENV_MASK] = s_ref_env_acc / ENV_SAMPLES;
+            s_ref_env_acc = 0;
+        }
+    }
+    s_ref_head = head + frames;
+}
+
+/**
+ * @brief       对一帧麦克风采样消除回声
+ */
+void audio_aec_process(int16_t *pcm, size_t samples)
+{
+    bool active = s_active;     /* 先读开关: 读到开启时新会话序号一定已可见 */
+
+    if (s_session_applied != s_session) {
+        apply_session();
+    }
+    if (!active) {
+        return;
+    }
+
+    uint32_t start = esp_cpu_get_cycle_count();
+    for (size_t off = 0; off < samples; off += CHUNK) {
+        size_t n = (samples - off < CHUNK) ? samples - off : CHUNK;
+        track_mic(pcm + off, n);
+        if (s_delay) {
+            cancel(pcm + off, n);
+        }
+        s_mic_count += n;
+    }
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+
+    s_frames++;
+    s_cycles_total += cycles;
+    if (cycles > s_cycles_max) {
+        s_cycles_max = cycles;
+    }
+}
+
+/**
+ * @brief       读取统计
+ */
+void audio_aec_get_stats(audio_aec_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->active = s_active;
+    stats->taps = s_taps;
+    stats->delay = s_delay;
+    stats->erle_db = (s_ed > 0.0f && s_ee > 0.0f) ? (int32_t)lrintf(10.0f * log10f(s_ed / s_ee)) : 0;
+    stats->frames = s_frames;
+    stats->cycles_avg = s_frames ? (uint32_t)(s_cycles_total / s_frames) : 0;
+    stats->cycles_max = s_cycles_max;
+    stats->resets = s_resets;
+}
@@ -0,0 +1,92 @@
+/**
+ ****************************************************************************************************
+ * @file        audio_aec.h
+ * @author      Audio Serial Transfer
+ * @version     V1.0
+ * @date        2026-10-17
+ * @brief       回声消除 - 以 I2S 发送流为参考, 用 NLMS 自适应滤波从麦克风信号中减去喇叭回声
+ *
+ *              混音任务每写一块 I2S 前调用 audio_aec_push_ref, 把下混后的单声道参考按发送采样序号
+ *              存入环形缓冲; 录音任务读到的第 c 个麦克风采样对应参考序号 c - delay。delay 包含
+ *              TX/RX DMA 环形缓冲与声学路径, 由麦克风与参考的包络互相关估计, 滤波器只需覆盖剩余的
+ *              回声尾部。滤波在录音任务 (核 1) 中原地进行, 阶数按采样率限制在 CPU 预算内。
+ *              远端静音时不滤波; 双讲 (近端说话) 时冻结自适应, 防止滤波器被近端语音带偏。
+ ****************************************************************************************************
+ */
+
+#ifndef __AUDIO_AEC_H__
+#define __AUDIO_AEC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+#define AUDIO_AEC_MAX_TAPS      512         /* 最大滤波器阶数 (采样) */
+#define AUDIO_AEC_MIN_TAPS      128         /* 低于此阶数不启用 (覆盖不了延迟估计的误差) */
+#define AUDIO_AEC_TAP_BUDGET    8192000     /* 阶数 x 采样率上限 (每秒约 1600 万次浮点乘加) */
+#define AUDIO_AEC_REF_FRAMES    16384       /* 参考环形缓冲采样数 (2 的幂, 大于 DMA 往返延迟) */
+#define AUDIO_AEC_MU            0.5f        /* NLMS 步长 */
+#define AUDIO_AEC_HANGOVER_MS   30          /* 检测到双讲后冻结自适应的时长 */
+
+/* 回声消除统计 (当前或上一个全双工会话) */
+typedef struct {
+    bool active;                    /* 正在消除回声 */
+    uint32_t taps;                  /* 滤波器阶数 */
+    uint32_t delay;                 /* 估计的参考延迟 (采样), 0 表示尚未锁定 */
+    int32_t erle_db;                /* 回声损耗增强 (dB, 远端有声时平滑) */
+    uint32_t frames;                /* 已处理的麦克风帧数 */
+    uint32_t cycles_avg;            /* 每帧平均 CPU 周期 (含延迟估计) */
+    uint32_t cycles_max;            /* 每帧最大 CPU 周期 */
+    uint32_t resets;                /* 权重复位次数 (延迟变化或发散) */
+} audio_aec_stats_t;
+
+/**
+ * @brief       初始化 (分配参考环形缓冲), 启动时调用一次
+ * @retval      ESP_OK: 成功; ESP_ERR_NO_MEM: 内存不足
+ */
+esp_err_t audio_aec_init(void);
+
+/**
+ * @brief       开启/关闭回声消除, 从下一个全双工会话起生效
+ * @param       enable: true 开启 (默认)
+ */
+void audio_aec_set_enabled(bool enable);
+
+/**
+ * @brief       查询是否开启
+ */
+bool audio_aec_enabled(void);
+
+/**
+ * @brief       开始一个会话 (I2S 收发启动前调用, 此时混音未运行)
+ * @note        录音任务可能仍在处理上一会话的帧, 滤波器由它在下一次 audio_aec_process 开始时复位
+ * @param       rate: 采样率, 决定滤波器阶数
+ */
+void audio_aec_start(uint32_t rate);
+
+/**
+ * @brief       结束会话, 之后 push_ref / process 直接返回
+ */
+void audio_aec_stop(void);
+
+/**
+ * @brief       记录一块发送参考 (混音任务, 写入 I2S 之前)
+ * @param       stereo: 立体声 16bit 交错采样
+ * @param       frames: 帧数
+ */
+void audio_aec_push_ref(const int16_t *stereo, size_t frames);
+
+/**
+ * @brief       对一帧麦克风采样消除回声 (录音任务, 原地处理)
+ * @param       pcm: 单声道 16bit 采样
+ * @param       samples: 采样数
+ */
+void audio_aec_process(int16_t *pcm, size_t samples);
+
+/**
+ * @brief       读取统计
+ */
+void audio_aec_get_stats(audio_aec_stats_t *stats);
+
+#endif /* __AUDIO_AEC_H__ */
@@ -0,0 +1,165 @@
+/**
+ ****************************************************************************************************
+ * @file        audio_fec.c
+ * @author      Audio Serial Transfer
+ * @version     V1.0
+ * @date        2026-10-17
+ * @brief       音频前向纠错 - 每组连续序号的音频帧附一个按字节异或的校验帧, 可重建组内任意一帧
+ ****************************************************************************************************
+ */
+
+#include "audio_fec.h"
+#include <string.h>
+
+#define FEC_WINDOW      32          /* mask 位数 */
+
+/**
+ * @brief       初始化
+ */
+void audio_fec_init(audio_fec_t *fec, uint8_t *buf, size_t size)
+{
+    fec->acc = buf;
+    fec->size = size;
+    fec->max_len = (uint16_t)size;
+    audio_fec_reset(fec);
+}
+
+/**
+ * @brief       清空当前组 (acc 中 max_len 之后始终为 0, 只需清前 max_len 字节)
+ */
+void audio_fec_reset(audio_fec_t *fec)
+{
+    if (fec->acc) {
+        memset(fec->acc, 0, fec->max_len);
+    }
+    fec->base = 0;
+    fec->len_xor = 0;
+    fec->max_len = 0;
+    fec->mask = 0;
+}
+
+/**
+ * @brief       按字节异或累加
+ */
+static void xor_into(uint8_t *acc, const uint8_t *src, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        acc[i] ^= src[i];
+    }
+}
+
+/**
+ * @brief       加入一帧
+ */
+void audio_fec_add(audio_fec_t *fec, uint16_t seq, const uint8_t *prefix, uint16_t prefix_len,
+                   const uint8_t *data, uint16_t len)
+{
+    uint16_t total = prefix_len + len;
+
+    if (!fec->acc || total > fec->size) {
+        return;
+    }
+    if (fec->mask == 0) {
+        audio_fec_reset(fec);
+        fec->base = seq;
+    }
+
+    uint16_t off = seq - fec->base;
+    if (off >= FEC_WINDOW) {
+        audio_fec_reset(fec);       /* 校验帧丢失或序号跳变: 从这一帧重新开始 */
+        fec->base = seq;
+        off = 0;
+    }
+    if (fec->mask & (1u << off)) {
+        return;                     /* 重复帧 */
+    }
+
+    fec->mask |= 1u << off;
+    fec->len_xor ^= total;
+    if (prefix_len) {
+        xor_into(fec->acc, prefix, prefix_len);
+    }
+    xor_into(fec->acc + prefix_len, data, len);
+    if (total > fec->max_len) {
+        fec->max_len = total;
+    }
+}
+
+/**
+ * @brief       当前组已加入的帧数
+ */
+uint32_t audio_fec_count(const audio_fec_t *fec)
+{
+    return (uint32_t)__builtin_popcount(fec->mask);
+}
+
+/**
+ * @brief       生成当前组的校验帧
+ */
+uint16_t audio_fec_parity(const audio_fec_t *fec, uint8_t header[AUDIO_FEC_HEADER])
+{
+    header[0] = fec->base & 0xFF;
+    header[1] = fec->base >> 8;
+    header[2] = (uint8_t)audio_fec_count(fec);
+    header[3] = fec->len_xor & 0xFF;
+    header[4] = fec->len_xor >> 8;
+    return fec->max_len;
+}
+
+/**
+ * @brief       处理收到的校验帧
+ */
+audio_fec_result_t audio_fec_recover(audio_fec_t *fec, const uint8_t *parity, uint16_t len,
+                                     uint16_t *lost_seq, uint16_t *out_len)
+{
+    audio_fec_result_t result = AUDIO_FEC_FAILED;
+
+    if (len < AUDIO_FEC_HEADER || !fec->acc) {
+        audio_fec_reset(fec);
+        return result;
+    }
+
+    uint16_t first = parity[0] | (parity[1] << 8);
+    uint32_t count = parity[2];
+    uint16_t len_xor = parity[3] | (parity[4] << 8);
+    uint16_t plen = len - AUDIO_FEC_HEADER;
+    uint32_t full = (count >= FEC_WINDOW) ? 0xFFFFFFFFu : ((1u << count) - 1);
+    uint32_t rel = 0;
+
+    /* 把已收到的帧对齐到校验组的首帧 (首帧本身可能丢失, base 会晚于 first) */
+    if (fec->mask) {
+        uint16_t shift = fec->base - first;
+        if (shift >= count || (shift && (fec->mask >> (FEC_WINDOW - shift)))) {
+            audio_fec_reset(fec);
+            return result;
+        }
+        rel = fec->mask << shift;
+    }
+
+    uint32_t missing = full & ~rel;
+    if (count == 0 || count > FEC_WINDOW || plen > fec->size || (rel & ~full)) {
+        result = AUDIO_FEC_FAILED;
+    } else if (missing == 0) {
+        result = AUDIO_FEC_COMPLETE;
+    } else if ((missing & (missing - 1)) == 0) {
+        uint16_t rebuilt = len_xor ^ fec->len_xor;
+        if (rebuilt <= plen) {
+            xor_into(fec->acc, parity + AUDIO_FEC_HEADER, plen);
+            *lost_seq = first + (uint16_t)__builtin_ctz(missing);
+            *out_len = rebuilt;
+            result = AUDIO_FEC_REBUILT;
+        }
+    }
+
+    if (result == AUDIO_FEC_REBUILT) {
+        /* 保留重建的数据供调用方读取, 下一组开始时再清零 */
+        fec->mask = 0;
+        fec->len_xor = 0;
+        if (plen > fec->max_len) {
+            fec->max_len = plen;
+        }
+    } else {
+        audio_fec_reset(fec);
+    }
+    return result;
+}
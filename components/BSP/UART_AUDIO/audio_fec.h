@@ -0,0 +1,92 @@
+/**
+ ****************************************************************************************************
+ * @file        audio_fec.h
+ * @author      Audio Serial Transfer
+ * @version     V1.0
+ * @date        2026-10-17
+ * @brief       音频前向纠错 - 每组连续序号的音频帧附一个按字节异或的校验帧, 可重建组内任意一帧
+ *
+ *              校验帧数据: [首帧序号 u16][帧数 u8][各帧长度异或 u16][各帧数据按字节异或 (短帧补 0)]
+ *              发送方每加入 N 帧生成一个校验帧; 接收方把收到的帧异或累加, 校验帧到达时
+ *              若组内恰好缺一帧, 校验数据与累加结果再异或一次即为缺失的帧。
+ *              不依赖 FreeRTOS, PC 端工具按同样的格式实现。
+ ****************************************************************************************************
+ */
+
+#ifndef __AUDIO_FEC_H__
+#define __AUDIO_FEC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define AUDIO_FEC_HEADER        5           /* 校验帧头: 首帧序号 u16, 帧数 u8, 长度异或 u16 */
+#define AUDIO_FEC_MAX_GROUP     8           /* 每组最多帧数 (接收方为重建最多暂扣这么多帧) */
+
+/* 一组的异或累加 */
+typedef struct {
+    uint8_t *acc;                   /* 各帧数据异或 */
+    size_t size;                    /* acc 容量 (字节) */
+    uint16_t base;                  /* 组内最早收到的帧序号 */
+    uint16_t len_xor;               /* 各帧长度异或 */
+    uint16_t max_len;               /* 最长帧 (acc 有效长度) */
+    uint32_t mask;                  /* 已加入的帧 (位 i 为序号 base + i) */
+} audio_fec_t;
+
+/* 校验帧处理结果 */
+typedef enum {
+    AUDIO_FEC_COMPLETE = 0,         /* 组内没有缺帧 */
+    AUDIO_FEC_REBUILT,              /* 缺一帧, 已重建 */
+    AUDIO_FEC_FAILED,               /* 缺两帧及以上, 或累加的帧与校验组不符 */
+} audio_fec_result_t;
+
+/**
+ * @brief       初始化
+ * @param       fec: 状态
+ * @param       buf: 累加缓冲 (至少为最长帧长度)
+ * @param       size: 缓冲字节数
+ */
+void audio_fec_init(audio_fec_t *fec, uint8_t *buf, size_t size);
+
+/**
+ * @brief       清空当前组
+ */
+void audio_fec_reset(audio_fec_t *fec);
+
+/**
+ * @brief       加入一帧 (发送前或收到后)
+ * @note        数据为序号之后的全部内容, 分为前缀 (如全双工流 ID) 和数据两段传入;
+ *              与当前组相距 32 帧以上时视为新组
+ * @param       seq: 帧序号
+ * @param       prefix: 前缀, 可为 NULL
+ * @param       prefix_len: 前缀字节数
+ * @param       data: 数据
+ * @param       len: 数据字节数
+ */
+void audio_fec_add(audio_fec_t *fec, uint16_t seq, const uint8_t *prefix, uint16_t prefix_len,
+                   const uint8_t *data, uint16_t len);
+
+/**
+ * @brief       当前组已加入的帧数
+ */
+uint32_t audio_fec_count(const audio_fec_t *fec);
+
+/**
+ * @brief       生成当前组的校验帧 (发送方), 之后调用 audio_fec_reset 开始下一组
+ * @param       header: 输出校验帧头 (AUDIO_FEC_HEADER 字节)
+ * @retval      校验数据长度, 数据位于 fec->acc
+ */
+uint16_t audio_fec_parity(const audio_fec_t *fec, uint8_t header[AUDIO_FEC_HEADER]);
+
+/**
+ * @brief       处理收到的校验帧 (接收方), 处理后当前组清空
+ * @param       parity: 校验帧数据 (含帧头)
+ * @param       len: 校验帧数据长度
+ * @param       lost_seq: 输出, 重建的帧序号
+ * @param       out_len: 输出, 重建的帧长度 (数据位于 fec->acc)
+ * @retval      处理结果
+ */
+audio_fec_result_t audio_fec_recover(audio_fec_t *fec, const uint8_t *parity, uint16_t len,
+                                     uint16_t *lost_seq, uint16_t *out_len);
+
+#endif /* __AUDIO_FEC_H__ */
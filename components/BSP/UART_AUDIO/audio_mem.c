@@ -0,0 +1,389 @@
+/**
+ ****************************************************************************************************
+ * @file        audio_mem.c
+ * @author      Audio Serial Transfer
+ * @version     V1.0
+ * @date        2026-10-17
+ * @brief       音频内存计划 - 按内存层级放置缓冲区, 按板载内存确定缓冲规模, 启动时打印占用表
+ ****************************************************************************************************
+ */
+
+#include "audio_mem.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_memory_utils.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include <string.h>
+#include <stdlib.h>
+
+static const char *TAG = "AUDIO_MEM";
+
+#define MAX_LIVE            48      /* 同时存活的分配数 */
+
+/* 占用表条目 (同名分配合并) */
+typedef struct {
+    const char *name;
+    audio_mem_tier_t want;          /* 期望层级 */
+    audio_mem_tier_t tier;          /* 实际层级 (最近一次分配) */
+    uint32_t bytes;                 /* 当前字节数 */
+    uint32_t peak;                  /* 最高字节数 */
+    uint32_t count;                 /* 当前块数 */
+} mem_entry_t;
+
+/* 存活分配 */
+typedef struct {
+    void *ptr;
+    uint16_t entry;
+    uint32_t size;
+} mem_live_t;
+
+static mem_entry_t s_entries[AUDIO_MEM_MAX_ENTRIES];
+static mem_live_t s_live[MAX_LIVE];
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* 按层级合计 (内部 RAM 含 DMA) */
+static uint32_t s_internal_bytes = 0;
+static uint32_t s_internal_peak = 0;
+static uint32_t s_psram_bytes = 0;
+static uint32_t s_psram_peak = 0;
+
+static audio_mem_plan_t s_plan;
+static bool s_planned = false;
+
+static const char *s_tier_names[] = {"DMA", "内部", "PSRAM"};
+
+#if CONFIG_HEAP_USE_HOOKS
+/* 零分配检查窗口内的堆操作记录 */
+typedef struct {
+    char task[configMAX_TASK_NAME_LEN];     /* 发起任务, 中断中为 "ISR" */
+    uint32_t size;                          /* 分配字节数, free 为 0 */
+    bool alloc;
+} guard_rec_t;
+
+static volatile bool s_guard_active = false;
+static uint32_t s_guard_ops = 0;
+static guard_rec_t s_guard_recs[AUDIO_MEM_GUARD_RECORDS];
+
+/**
+ * @brief       记录一次堆操作 (堆钩子中调用, 不能再访问堆)
+ */
+static void IRAM_ATTR guard_record(size_t size, bool alloc)
+{
+    uint32_t idx = __atomic_fetch_add(&s_guard_ops, 1, __ATOMIC_RELAXED);
+    if (idx >= AUDIO_MEM_GUARD_RECORDS) {
+        return;
+    }
+
+    guard_rec_t *rec = &s_guard_recs[idx];
+    const char *name = xPortInIsrContext() ? "ISR" : pcTaskGetName(NULL);
+    int i = 0;
+    for (; i < configMAX_TASK_NAME_LEN - 1 && name[i]; i++) {
+        rec->task[i] = name[i];
+    }
+    rec->task[i] = '\0';
+    rec->size = size;
+    rec->alloc = alloc;
+}
+
+/* 堆钩子 (CONFIG_HEAP_USE_HOOKS): 每次 malloc/free 后由堆组件调用 */
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    if (s_guard_active) {
+        guard_record(size, true);
+    }
+}
+
+void IRAM_ATTR esp_heap_trace_free_hook(void *ptr)
+{
+    if (s_guard_active) {
+        guard_record(0, false);
+    }
+}
+#endif
+
+/**
+ * @brief       获取内存计划
+ */
+const audio_mem_plan_t *audio_mem_get_plan(void)
+{
+    if (s_planned) {
+        return &s_plan;
+    }
+
+    size_t psram_free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+    size_t internal_free = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+
+    if (psram_free >= AUDIO_MEM_PSRAM_MIN) {
+        /* 大档: 抖动缓冲 ~1s@8kHz, 预取 24 块, 都在 PSRAM */
+        s_plan.psram = true;
+        s_plan.mixer_ring_frames = 8192;
+        s_plan.play_queue_len = 24;
+        s_plan.mp3_input_size = 16384;
+    } else if (internal_free >= AUDIO_MEM_INTERNAL_COMFORT) {
+        /* 标准档: 仅内部 RAM */
+        s_plan.mixer_ring_frames = 2048;
+        s_plan.play_queue_len = 6;
+        s_plan.mp3_input_size = 4096;
+    } else {
+        /* 紧凑档: 内部 RAM 偏少的板型 */
+        s_plan.mixer_ring_frames = 1024;
+        s_plan.play_queue_len = 3;
+        s_plan.mp3_input_size = 4096;
+    }
+    s_planned = true;
+
+    ESP_LOGI(TAG, "内存计划: PSRAM %s (空闲 %u KB), 内部空闲 %u KB -> 混音缓冲 %lu 帧, 预取 %lu 块, MP3 输入 %lu B",
+             s_plan.psram ? "可用" : "不可用", (unsigned)(psram_free / 1024), (unsigned)(internal_free / 1024),
+             (unsigned long)s_plan.mixer_ring_frames, (unsigned long)s_plan.play_queue_len,
+             (unsigned long)s_plan.mp3_input_size);
+    return &s_plan;
+}
+
+/**
+ * @brief       按名称查找或新建占用表条目
+ * @retval      条目下标, 表满返回 -1
+ */
+static int entry_find(const char *name, audio_mem_tier_t want)
+{
+    for (int i = 0; i < AUDIO_MEM_MAX_ENTRIES; i++) {
+        if (s_entries[i].name == name || (s_entries[i].name && strcmp(s_entries[i].name, name) == 0)) {
+            return i;
+        }
+    }
+    for (int i = 0; i < AUDIO_MEM_MAX_ENTRIES; i++) {
+        if (!s_entries[i].name) {
+            s_entries[i].name = name;
+            s_entries[i].want = want;
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief       按层级分配并计入占用表
+ */
+void *audio_mem_alloc(const char *name, audio_mem_tier_t tier, size_t size)
+{
+    void *ptr = NULL;
+    audio_mem_tier_t actual = tier;
+
+    switch (tier) {
+        case AUDIO_MEM_DMA:
+            ptr = heap_caps_malloc(size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+            break;
+
+        case AUDIO_MEM_PSRAM:
+            ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+            if (ptr) {
+                break;
+            }
+            actual = AUDIO_MEM_INTERNAL;
+            /* fall through */
+
+        case AUDIO_MEM_INTERNAL:
+            ptr = heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+            break;
+    }
+    if (!ptr) {
+        ESP_LOGE(TAG, "%s: %s 分配 %u 字节失败", name, s_tier_names[actual], (unsigned)size);
+        return NULL;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    int e = entry_find(name, tier);
+    for (int i = 0; i < MAX_LIVE && e >= 0; i++) {
+        if (!s_live[i].ptr) {
+            s_live[i].ptr = ptr;
+            s_live[i].entry = e;
+            s_live[i].size = size;
+
+            mem_entry_t *ent = &s_entries[e];
+            ent->tier = actual;
+            ent->bytes += size;
+            ent->count++;
+            if (ent->bytes > ent->peak) {
+                ent->peak = ent->bytes;
+            }
+            if (actual == AUDIO_MEM_PSRAM) {
+                s_psram_bytes += size;
+                if (s_psram_bytes > s_psram_peak) {
+                    s_psram_peak = s_psram_bytes;
+                }
+            } else {
+                s_internal_bytes += size;
+                if (s_internal_bytes > s_internal_peak) {
+                    s_internal_peak = s_internal_bytes;
+                }
+            }
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    return ptr;
+}
+
+/**
+ * @brief       释放 audio_mem_alloc 分配的内存
+ */
+void audio_mem_free(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    for (int i = 0; i < MAX_LIVE; i++) {
+        if (s_live[i].ptr == ptr) {
+            mem_entry_t *ent = &s_entries[s_live[i].entry];
+            ent->bytes -= s_live[i].size;
+            ent->count--;
+            if (esp_ptr_external_ram(ptr)) {
+                s_psram_bytes -= s_live[i].size;
+            } else {
+                s_internal_bytes -= s_live[i].size;
+            }
+            s_live[i].ptr = NULL;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+    heap_caps_free(ptr);
+}
+
+/**
+ * @brief       查询指针实际所在层级
+ */
+audio_mem_tier_t audio_mem_tier_of(const void *ptr)
+{
+    return esp_ptr_external_ram(ptr) ? AUDIO_MEM_PSRAM : AUDIO_MEM_INTERNAL;
+}
+
+/**
+ * @brief       层级名称
+ */
+const char *audio_mem_tier_name(audio_mem_tier_t tier)
+{
+    return (unsigned)tier < sizeof(s_tier_names) / sizeof(s_tier_names[0]) ? s_tier_names[tier] : "?";
+}
+
+/**
+ * @brief       打印一种堆的总量、空闲、最高占用
+ */
+static void report_heap(const char *label, uint32_t caps)
+{
+    size_t total = heap_caps_get_total_size(caps);
+    if (total == 0) {
+        ESP_LOGI(TAG, "%-6s 不存在", label);
+        return;
+    }
+    size_t free_now = heap_caps_get_free_size(caps);
+    size_t free_min = heap_caps_get_minimum_free_size(caps);
+    size_t largest = heap_caps_get_largest_free_block(caps);
+
+    ESP_LOGI(TAG, "%-6s 总计 %6u KB, 已用 %6u KB, 最高 %6u KB, 剩余 %6u KB (最大连续 %u KB)",
+             label, (unsigned)(total / 1024), (unsigned)((total - free_now) / 1024),
+             (unsigned)((total - free_min) / 1024), (unsigned)(free_now / 1024), (unsigned)(largest / 1024));
+}
+
+/**
+ * @brief       打印占用表
+ */
+void audio_mem_report(void)
+{
+    mem_entry_t entries[AUDIO_MEM_MAX_ENTRIES];
+
+    portENTER_CRITICAL(&s_lock);
+    memcpy(entries, s_entries, sizeof(entries));
+    uint32_t internal_bytes = s_internal_bytes, internal_peak = s_internal_peak;
+    uint32_t psram_bytes = s_psram_bytes, psram_peak = s_psram_peak;
+    portEXIT_CRITICAL(&s_lock);
+
+    ESP_LOGI(TAG, "---------------- 音频内存占用 ----------------");
+    ESP_LOGI(TAG, "%-12s %-6s %-6s %8s %8s %4s", "缓冲", "期望", "实际", "当前(B)", "最高(B)", "块");
+    for (int i = 0; i < AUDIO_MEM_MAX_ENTRIES; i++) {
+        mem_entry_t *ent = &entries[i];
+        if (!ent->name) {
+            continue;
+        }
+        ESP_LOGI(TAG, "%-12s %-6s %-6s %8lu %8lu %4lu", ent->name, s_tier_names[ent->want],
+                 s_tier_names[ent->tier], (unsigned long)ent->bytes, (unsigned long)ent->peak,
+                 (unsigned long)ent->count);
+    }
+    ESP_LOGI(TAG, "音频缓冲合计: 内部 %lu B (最高 %lu), PSRAM %lu B (最高 %lu)",
+             (unsigned long)internal_bytes, (unsigned long)internal_peak,
+             (unsigned long)psram_bytes, (unsigned long)psram_peak);
+
+    report_heap("内部", MALLOC_CAP_INTERNAL);
+    report_heap("DMA", MALLOC_CAP_DMA);
+    report_heap("PSRAM", MALLOC_CAP_SPIRAM);
+
+    size_t headroom = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    if (headroom < AUDIO_MEM_INTERNAL_RESERVE) {
+        ESP_LOGW(TAG, "内部 RAM 最低剩余 %u KB, 低于保留余量 %u KB, 请缩小缓冲规模",
+                 (unsigned)(headroom / 1024), (unsigned)(AUDIO_MEM_INTERNAL_RESERVE / 1024));
+    } else {
+        ESP_LOGI(TAG, "内部 RAM 余量 %u KB (保留 %u KB)",
+                 (unsigned)((headroom - AUDIO_MEM_INTERNAL_RESERVE) / 1024),
+                 (unsigned)(AUDIO_MEM_INTERNAL_RESERVE / 1024));
+    }
+}
+
+/**
+ * @brief       开始零分配检查窗口
+ */
+void audio_mem_guard_begin(void)
+{
+#if CONFIG_HEAP_USE_HOOKS
+    s_guard_ops = 0;
+    s_guard_active = true;
+#endif
+}
+
+/**
+ * @brief       结束检查窗口
+ */
+uint32_t audio_mem_guard_end(void)
+{
+#if CONFIG_HEAP_USE_HOOKS
+    if (!s_guard_active) {
+        return s_guard_ops;
+    }
+    s_guard_active = false;
+
+    uint32_t ops = s_guard_ops;
+    if (ops == 0) {
+        ESP_LOGI(TAG, "会话期间无堆操作");
+        return 0;
+    }
+    ESP_LOGE(TAG, "会话期间发生 %lu 次堆操作:", (unsigned long)ops);
+    for (uint32_t i = 0; i < ops && i < AUDIO_MEM_GUARD_RECORDS; i++) {
+        guard_rec_t *rec = &s_guard_recs[i];
+        if (rec->alloc) {
+            ESP_LOGE(TAG, "  %-16s malloc %lu B", rec->task, (unsigned long)rec->size);
+        } else {
+            ESP_LOGE(TAG, "  %-16s free", rec->task);
+        }
+    }
+#if AUDIO_MEM_GUARD_ASSERT
+    abort();
+#endif
+    return ops;
+#else
+    return AUDIO_MEM_GUARD_UNTRACKED;
+#endif
+}
+
+/**
+ * @brief       当前 (或上一个) 检查窗口内的堆操作次数
+ */
+uint32_t audio_mem_guard_ops(void)
+{
+#if CONFIG_HEAP_USE_HOOKS
+    return s_guard_ops;
+#else
+    return AUDIO_MEM_GUARD_UNTRACKED;
+#endif
+}
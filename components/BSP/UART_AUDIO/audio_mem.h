@@ -0,0 +1,104 @@
+/**
+ ****************************************************************************************************
+ * @file        audio_mem.h
+ * @author      Audio Serial Transfer
+ * @version     V1.0
+ * @date        2026-10-17
+ * @brief       音频内存计划 - 按内存层级放置缓冲区, 按板载内存确定缓冲规模, 启动时打印占用表
+ *
+ *              DMA 缓冲固定在内部 RAM; 大的环形缓冲 (混音抖动缓冲、播放预取队列、解码输入)
+ *              有 PSRAM 时放入 PSRAM, 否则退回内部 RAM 并按剩余内部 RAM 缩小规模。
+ *              所有流缓冲在启动或会话建立时分配; 开启 CONFIG_HEAP_USE_HOOKS 后,
+ *              会话期间的任何 malloc/free 都被记录并断言 (零分配检查)。
+ ****************************************************************************************************
+ */
+
+#ifndef __AUDIO_MEM_H__
+#define __AUDIO_MEM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* 规模分档阈值 */
+#define AUDIO_MEM_PSRAM_MIN         (256 * 1024)    /* PSRAM 空闲不低于此值才按大档规划 */
+#define AUDIO_MEM_INTERNAL_COMFORT  (160 * 1024)    /* 无 PSRAM 时内部 RAM 空闲不低于此值按标准档规划 */
+#define AUDIO_MEM_INTERNAL_RESERVE  (32 * 1024)     /* 内部 RAM 保留余量 (任务栈/驱动), 低于此值告警 */
+#define AUDIO_MEM_MAX_ENTRIES       24              /* 占用表条目数 */
+
+/* 零分配检查 (CONFIG_HEAP_USE_HOOKS 启用时有效) */
+#define AUDIO_MEM_GUARD_ASSERT      1               /* 1: 会话结束时发现堆操作则 abort (测试模式) */
+#define AUDIO_MEM_GUARD_RECORDS     8               /* 记录的前几次堆操作 (任务名/大小) */
+#define AUDIO_MEM_GUARD_UNTRACKED   0xFFFFFFFFu     /* 未启用检查时的堆操作计数 */
+
+/* 内存层级 */
+typedef enum {
+    AUDIO_MEM_DMA = 0,              /* 内部 RAM, DMA 可访问 (I2S 收发) */
+    AUDIO_MEM_INTERNAL,             /* 内部 RAM */
+    AUDIO_MEM_PSRAM,                /* PSRAM, 不可用时退回内部 RAM */
+} audio_mem_tier_t;
+
+/* 缓冲规模 (启动时按可用内存确定一次) */
+typedef struct {
+    bool psram;                     /* PSRAM 可用 */
+    uint32_t mixer_ring_frames;     /* 混音器每路环形缓冲帧数 (2 的幂) */
+    uint32_t play_queue_len;        /* 播放预取队列深度 (音频块) */
+    uint32_t mp3_input_size;        /* MP3 解码输入缓冲 (字节) */
+} audio_mem_plan_t;
+
+/**
+ * @brief       获取内存计划 (首次调用时按当前空闲内存确定)
+ * @retval      计划 (长期有效)
+ */
+const audio_mem_plan_t *audio_mem_get_plan(void);
+
+/**
+ * @brief       按层级分配并计入占用表
+ * @param       name: 名称 (占用表用, 需长期有效; 同名分配合并统计)
+ * @param       tier: 期望层级 (PSRAM 不可用时退回内部 RAM)
+ * @param       size: 字节数
+ * @retval      内存指针, 失败返回 NULL
+ */
+void *audio_mem_alloc(const char *name, audio_mem_tier_t tier, size_t size);
+
+/**
+ * @brief       释放 audio_mem_alloc 分配的内存
+ * @param       ptr: 内存指针 (NULL 时忽略)
+ */
+void audio_mem_free(void *ptr);
+
+/**
+ * @brief       查询指针实际所在层级
+ * @param       ptr: 内存指针
+ * @retval      AUDIO_MEM_PSRAM 或 AUDIO_MEM_INTERNAL (DMA 缓冲也在内部 RAM)
+ */
+audio_mem_tier_t audio_mem_tier_of(const void *ptr);
+
+/**
+ * @brief       层级名称
+ */
+const char *audio_mem_tier_name(audio_mem_tier_t tier);
+
+/**
+ * @brief       打印占用表: 各缓冲所在层级与大小, 内部 RAM / PSRAM 合计、最高占用和剩余余量
+ */
+void audio_mem_report(void);
+
+/**
+ * @brief       开始零分配检查窗口 (会话建立完成后调用), 清零计数
+ */
+void audio_mem_guard_begin(void);
+
+/**
+ * @brief       结束检查窗口 (会话拆除前调用), 打印窗口内的堆操作; AUDIO_MEM_GUARD_ASSERT 时断言为零
+ * @retval      窗口内 malloc + free 次数, 未启用检查返回 AUDIO_MEM_GUARD_UNTRACKED
+ */
+uint32_t audio_mem_guard_end(void);
+
+/**
+ * @brief       当前 (或上一个) 检查窗口内的堆操作次数
+ * @retval      malloc + free 次数, 未启用检查返回 AUDIO_MEM_GUARD_UNTRACKED
+ */
+uint32_t audio_mem_guard_ops(void);
+
+#endif /* __AUDIO_MEM_H__ */
@@ -0,0 +1,681 @@
+/**
+ ****************************************************************************************************
+ * @file        audio_mixer.c
+ * @author      Audio Serial Transfer
+ * @version     V1.0
+ * @date        2026-10-17
+ * @brief       软件混音器 - 多路输入环形缓冲, 单一 I2S 写入任务
+ ****************************************************************************************************
+ */
+
+#include "audio_mixer.h"
+#include "audio_mem.h"
+#include "audio_aec.h"
+#include "i2s.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "MIXER";
+
+#define RING_MASK           (s_ring_frames - 1)             /* 帧数为 2 的幂 */
+#define GAIN_MAX            (AUDIO_MIXER_GAIN_UNITY * 2)    /* 32767 * 65536 仍在 int32 范围内 */
+
+/* 自适应重采样 */
+#define RS_LOOKAHEAD        4               /* 三次插值需要当前块之后的输入帧数 (含速率偏差余量) */
+#define RS_PPM_TO_Q32       4295            /* 2^32 / 10^6 */
+#define DRIFT_SMOOTH        (1.0f / 32)     /* 缓冲深度平滑系数 (每块) */
+#define DRIFT_KP            2000.0f         /* 比例项: 深度偏差 100% 对应的 ppm */
+#define DRIFT_KI            0.5f            /* 积分项: 每块每 100% 偏差累积的 ppm */
+#define TSM_SMOOTH          (1.0f / 4)      /* 时长伸缩判断用的快速平滑系数 (每块), 跟得上链路卡顿 */
+
+/* WSOLA 时长伸缩: 在块中部拼接, 跳过或重复一段与当前波形最相似的输入 (按 8-16kHz 语音基音周期取值) */
+#define TSM_SPLICE          (AUDIO_MIXER_BLOCK_FRAMES / 2)  /* 拼接点 (帧) */
+#define TSM_OVERLAP         64                              /* 交叉淡化长度 (帧) */
+#define TSM_SHIFT_MIN       32                              /* 最小跳过/重复帧数 */
+#define TSM_SHIFT_MAX       TSM_SPLICE                      /* 最大跳过/重复帧数 */
+#define TSM_IN_MAX          (AUDIO_MIXER_BLOCK_FRAMES + TSM_SHIFT_MAX)
+
+/* 单路输入: 单生产者 (写入方) / 单消费者 (混音任务) 环形缓冲 */
+typedef struct {
+    int16_t *ring;                  /* 立体声交错, s_ring_frames 帧 */
+    volatile uint32_t head;         /* 写入位置 (帧, 自由增长), 仅写入方修改 */
+    volatile uint32_t tail;         /* 读取位置 (帧, 自由增长), 仅混音任务修改 */
+    volatile bool open;             /* 已打开 */
+    volatile bool started;          /* 打开后已收到数据, 之后数据不足计为欠载 */
+    volatile bool ended;            /* 已标记结束, 播完后自动关闭 */
+    int32_t gain;                   /* 当前增益 (Q15), 仅混音任务修改 */
+    volatile int32_t target;        /* 目标增益 (Q15) */
+    volatile uint32_t ramp_left;    /* 剩余渐变帧数 */
+    SemaphoreHandle_t space;        /* 混音任务取走数据后释放, 唤醒阻塞的写入方 */
+    mixer_input_stats_t stats;
+
+    /* 自适应重采样, 仅混音任务修改 (depth/retarget 除外) */
+    volatile uint32_t depth;        /* 目标缓冲帧数, 0 表示不跟踪 */
+    volatile bool retarget;         /* 目标已改变, 控制器需复位 */
+    bool primed;                    /* 已预缓冲到目标深度 */
+    float level_avg;                /* 平滑后的缓冲帧数 (时钟偏差估计) */
+    float level_fast;               /* 快速平滑的缓冲帧数 (时长伸缩判断) */
+    float integ;                    /* 积分项 (ppm) */
+    uint32_t phase;                 /* 读位置的小数部分 (Q32, 相对 tail) */
+    int16_t hist[2];                /* 最后消耗的一帧, 作为插值的 x[-1] */
+    uint32_t tsm_wait;              /* 距下次允许时长伸缩的块数 */
+} mixer_in_t;
+
+static mixer_in_t s_inputs[AUDIO_MIXER_MAX_INPUTS];
+static uint32_t s_ring_frames = AUDIO_MIXER_RING_FRAMES;  /* 按内存计划确定 */
+static int32_t s_acc[AUDIO_MIXER_BLOCK_FRAMES * 2];         /* 32 位累加器 */
+static int16_t s_out[AUDIO_MIXER_BLOCK_FRAMES * 2];         /* 输出块 */
+static int16_t s_rs[AUDIO_MIXER_BLOCK_FRAMES * 2];          /* 重采样/伸缩后的一路输入 */
+static int16_t s_tsm[TSM_IN_MAX * 2];                       /* 时长伸缩的线性化输入 */
+
+static TaskHandle_t s_task = NULL;
+static SemaphoreHandle_t s_idle = NULL;                     /* 混音任务停止输出后释放 */
+static volatile bool s_running = false;
+
+/* 统计 */
+static uint32_t s_blocks = 0;
+static uint32_t s_cycles_last = 0;
+static uint32_t s_cycles_max = 0;
+static uint64_t s_cycles_total = 0;
+static uint32_t s_tsm_cycles_max = 0;
+
+/**
+ * @brief       以固定增益累加一段 (每次 2 帧 4 个采样)
+ */
+static void mix_const(int32_t *acc, const int16_t *src, size_t frames, int32_t g)
+{
+    size_t n = frames * 2;
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        int32_t a0 = src[i], a1 = src[i + 1], a2 = src[i + 2], a3 = src[i + 3];
+        acc[i]     += (a0 * g) >> 15;
+        acc[i + 1] += (a1 * g) >> 15;
+        acc[i + 2] += (a2 * g) >> 15;
+        acc[i + 3] += (a3 * g) >> 15;
+    }
+    for (; i < n; i++) {
+        acc[i] += ((int32_t)src[i] * g) >> 15;
+    }
+}
+
+/**
+ * @brief       增益渐变中累加一段 (每帧更新增益)
+ * @retval      处理的帧数 (渐变结束即返回, 剩余部分按固定增益处理)
+ */
+static size_t mix_ramp(mixer_in_t *in, int32_t *acc, const int16_t *src, size_t frames)
+{
+    int32_t target = in->target;
+    uint32_t left = in->ramp_left;
+    int32_t step = (target - in->gain) / (int32_t)left;
+    size_t i = 0;
+
+    for (; i < frames && left > 0; i++) {
+        in->gain += step;
+        left--;
+        if (left == 0) {
+            in->gain = target;
+        }
+        acc[i * 2]     += ((int32_t)src[i * 2] * in->gain) >> 15;
+        acc[i * 2 + 1] += ((int32_t)src[i * 2 + 1] * in->gain) >> 15;
+    }
+    in->ramp_left = left;
+    return i;
+}
+
+/**
+ * @brief       把连续的 frames 帧 (不跨环尾) 按当前增益累加到 acc
+ */
+static void mix_linear(mixer_in_t *in, int32_t *acc, const int16_t *src, size_t frames)
+{
+    size_t ramped = (in->ramp_left > 0) ? mix_ramp(in, acc, src, frames) : 0;
+    mix_const(acc + ramped * 2, src + ramped * 2, frames - ramped, in->gain);
+}
+
+/**
+ * @brief       把一路输入的 frames 帧 (从 tail 开始, 可能跨越环尾) 累加到 acc
+ */
+static void mix_input(mixer_in_t *in, int32_t *acc, size_t frames)
+{
+    size_t done = 0;
+
+    while (done < frames) {
+        uint32_t pos = (in->tail + done) & RING_MASK;
+        size_t seg = s_ring_frames - pos;
+        if (seg > frames - done) {
+            seg = frames - done;
+        }
+
+        mix_linear(in, acc + done * 2, in->ring + pos * 2, seg);
+        done += seg;
+    }
+}
+
+/**
+ * @brief       四点三次 Hermite 插值 (Catmull-Rom), mu 为 Q15 小数位置
+ */
+static inline int16_t hermite(int32_t xm1, int32_t x0, int32_t x1, int32_t x2, int32_t mu)
+{
+    /* 系数均为 2 倍, 最后右移一位 */
+    int32_t c1 = x1 - xm1;
+    int32_t c2 = 2 * xm1 - 5 * x0 + 4 * x1 - x2;
+    int32_t c3 = (x2 - xm1) + 3 * (x0 - x1);
+    int64_t t = ((int64_t)c3 * mu) >> 15;
+    t = ((t + c2) * mu) >> 15;
+    t = ((t + c1) * mu) >> 15;
+    int32_t y = x0 + (int32_t)(t >> 1);
+
+    return y > INT16_MAX ? INT16_MAX : (y < INT16_MIN ? INT16_MIN : (int16_t)y);
+}
+
+/**
+ * @brief       按当前速率偏差把一路输入重采样为 frames 帧, 写入 s_rs
+ * @note        调用前保证缓冲中至少有 frames + RS_LOOKAHEAD 帧
+ * @retval      消耗的输入帧数
+ */
+static uint32_t resample_input(mixer_in_t *in, size_t frames)
+{
+    const int16_t *ring = in->ring;
+    uint32_t tail = in->tail;
+    uint64_t step = (1ULL << 32) + (int64_t)in->stats.drift_ppm * RS_PPM_TO_Q32;
+    uint64_t pos = in->phase;
+
+    for (size_t i = 0; i < frames; i++) {
+        uint32_t k = (uint32_t)(pos >> 32);
+        int32_t mu = (int32_t)((uint32_t)pos >> 17);
+        const int16_t *p0 = ring + ((tail + k) & RING_MASK) * 2;
+        const int16_t *p1 = ring + ((tail + k + 1) & RING_MASK) * 2;
+        const int16_t *p2 = ring + ((tail + k + 2) & RING_MASK) * 2;
+        const int16_t *pm1 = k ? ring + ((tail + k - 1) & RING_MASK) * 2 : in->hist;
+
+        s_rs[i * 2]     = hermite(pm1[0], p0[0], p1[0], p2[0], mu);
+        s_rs[i * 2 + 1] = hermite(pm1[1], p0[1], p1[1], p2[1], mu);
+        pos += step;
+    }
+
+    uint32_t used = (uint32_t)(pos >> 32);
+    if (used > 0) {
+        const int16_t *last = ring + ((tail + used - 1) & RING_MASK) * 2;
+        in->hist[0] = last[0];
+        in->hist[1] = last[1];
+    }
+    in->phase = (uint32_t)pos;
+    return used;
+}
+
+/**
+ * @brief       按缓冲深度更新时钟偏差估计 (每块一次)
+ * @note        写入方按自己的时钟平均送入数据, 深度的长期趋势就是两个时钟之差;
+ *              平滑掉按包到达的锯齿后做 PI 控制, 积分项收敛到实际偏差。
+ *              大幅偏离 (链路卡顿/突发) 交给时长伸缩, 此时积分项不累积, 避免把抖动当成偏差
+ * @retval      快速平滑深度相对目标的偏差 (%)
+ */
+static float drift_update(mixer_in_t *in, uint32_t level)
+{
+    float target = (float)in->depth;
+
+    in->level_avg += ((float)level - in->level_avg) * DRIFT_SMOOTH;
+    in->level_fast += ((float)level - in->level_fast) * TSM_SMOOTH;
+    float err = (in->level_avg - target) / target;
+    float excursion = (in->level_fast - target) * 100 / target;
+
+    if (excursion < AUDIO_MIXER_TSM_THRESHOLD && excursion > -AUDIO_MIXER_TSM_THRESHOLD) {
+        in->integ += err * DRIFT_KI;
+    }
+    if (in->integ > AUDIO_MIXER_DRIFT_MAX_PPM) {
+        in->integ = AUDIO_MIXER_DRIFT_MAX_PPM;
+    } else if (in->integ < -AUDIO_MIXER_DRIFT_MAX_PPM) {
+        in->integ = -AUDIO_MIXER_DRIFT_MAX_PPM;
+    }
+
+    float ppm = err * DRIFT_KP + in->integ;
+    if (ppm > AUDIO_MIXER_DRIFT_MAX_PPM) {
+        ppm = AUDIO_MIXER_DRIFT_MAX_PPM;
+    } else if (ppm < -AUDIO_MIXER_DRIFT_MAX_PPM) {
+        ppm = -AUDIO_MIXER_DRIFT_MAX_PPM;
+    }
+    in->stats.drift_ppm = (int32_t)ppm;
+    return excursion;
+}
+
+/**
+ * @brief       在 [lo, hi] 内找与参考段最相似的拼接位移 (归一化互相关, 只看左声道)
+ * @note        计算量固定为 (hi - lo + 1) × TSM_OVERLAP 次乘加, 与内容无关
+ * @param       ref: 参考段 (原样继续播放时的波形)
+ * @param       base: 候选段在 shift = 0 时的位置
+ */
+static int tsm_search(const int16_t *ref, const int16_t *base, int lo, int hi)
+{
+    int best = lo;
+    float best_score = -1.0f;
+
+    for (int d = lo; d <= hi; d++) {
+        const int16_t *cand = base + d * 2;
+        int64_t corr = 0, energy = 1;
+        for (int i = 0; i < TSM_OVERLAP * 2; i += 2) {
+            corr += (int32_t)ref[i] * cand[i];
+            energy += (int32_t)cand[i] * cand[i];
+        }
+        /* corr / sqrt(energy), 比较平方避免开方; 负相关不取 */
+        float score = corr > 0 ? (float)corr * (float)corr / (float)energy : 0.0f;
+        if (score > best_score) {
+            best_score = score;
+            best = d;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief       WSOLA 时长伸缩: 输出一块, 消耗 BLOCK + shift 帧 (shift < 0 拉长, > 0 压缩)
+ * @note        前 TSM_SPLICE 帧原样输出, 之后从原位置交叉淡化到位移 shift 处继续;
+ *              shift 按与原位置波形的相似度选取, 拼接点落在同相位的基音周期上, 音高不变
+ * @param       stretch: true 拉长 (缓冲偏低), false 压缩 (缓冲偏高)
+ * @retval      消耗的输入帧数
+ */
+static uint32_t tsm_block(mixer_in_t *in, bool stretch)
+{
+    uint32_t start = esp_cpu_get_cycle_count();
+    size_t need = stretch ? AUDIO_MIXER_BLOCK_FRAMES : TSM_IN_MAX;
+
+    /* 线性化所需的输入 (跨环尾) */
+    uint32_t pos = in->tail & RING_MASK;
+    size_t first = s_ring_frames - pos < need ? s_ring_frames - pos : need;
+    memcpy(s_tsm, in->ring + pos * 2, first * 4);
+    memcpy(s_tsm + first * 2, in->ring, (need - first) * 4);
+
+    const int16_t *ref = s_tsm + TSM_SPLICE * 2;
+    int shift = stretch ? tsm_search(ref, ref, -TSM_SHIFT_MAX, -TSM_SHIFT_MIN)
+                        : tsm_search(ref, ref, TSM_SHIFT_MIN, TSM_SHIFT_MAX);
+    const int16_t *cand = ref + shift * 2;
+
+    memcpy(s_rs, s_tsm, TSM_SPLICE * 4);
+    for (int i = 0; i < TSM_OVERLAP; i++) {
+        for (int c = 0; c < 2; c++) {
+            int32_t a = ref[i * 2 + c], b = cand[i * 2 + c];
+            s_rs[(TSM_SPLICE + i) * 2 + c] = (int16_t)(a + (b - a) * i / TSM_OVERLAP);
+        }
+    }
+    size_t rest = AUDIO_MIXER_BLOCK_FRAMES - TSM_SPLICE - TSM_OVERLAP;
+    memcpy(s_rs + (TSM_SPLICE + TSM_OVERLAP) * 2, cand + TSM_OVERLAP * 2, rest * 4);
+
+    uint32_t used = AUDIO_MIXER_BLOCK_FRAMES + shift;
+    const int16_t *last = s_tsm + (used - 1) * 2;
+    in->hist[0] = last[0];
+    in->hist[1] = last[1];
+    in->phase = 0;
+    if (stretch) {
+        in->stats.stretches++;
+    } else {
+        in->stats.compressions++;
+    }
+
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+    if (cycles > s_tsm_cycles_max) {
+        s_tsm_cycles_max = cycles;
+    }
+    return used;
+}
+
+/**
+ * @brief       混入一路跟踪目标深度的输入
+ * @retval      true: 已处理; false: 数据不足, 按普通输入处理 (计欠载)
+ */
+static bool mix_tracked(mixer_in_t *in, uint32_t level)
+{
+    if (in->retarget) {
+        in->retarget = false;
+        in->level_avg = in->level_fast = (float)in->depth;
+        in->integ = 0;
+        in->stats.drift_ppm = 0;
+    }
+
+    /* 预缓冲: 攒够目标深度再输出, 写入方按实时节奏即可维持该深度 */
+    if (!in->primed) {
+        if (level < in->depth && !in->ended) {
+            return true;
+        }
+        in->primed = true;
+        in->stats.primes++;
+        in->level_avg = in->level_fast = (float)level;
+    }
+    if (level < AUDIO_MIXER_BLOCK_FRAMES) {
+        in->phase = 0;      /* 回到整帧读取 */
+        return false;
+    }
+
+    /* 大幅偏离目标: 拉长或压缩一块; 其余时间按时钟偏差微调. 偏低时也看瞬时深度, 尽早应对卡顿 */
+    float avg_pct = drift_update(in, level);
+    float now_pct = ((float)level - in->depth) * 100 / in->depth;
+    bool stretch = (avg_pct <= -AUDIO_MIXER_TSM_THRESHOLD || now_pct <= -AUDIO_MIXER_TSM_THRESHOLD) && !in->ended;
+    bool compress = avg_pct >= AUDIO_MIXER_TSM_THRESHOLD && level >= TSM_IN_MAX;
+    uint32_t used;
+
+    if (in->tsm_wait > 0) {
+        in->tsm_wait--;
+    }
+    if ((stretch || compress) && in->tsm_wait == 0) {
+        used = tsm_block(in, stretch);
+        in->tsm_wait = AUDIO_MIXER_TSM_INTERVAL - 1;
+    } else if (level >= AUDIO_MIXER_BLOCK_FRAMES + RS_LOOKAHEAD) {
+        used = resample_input(in, AUDIO_MIXER_BLOCK_FRAMES);
+    } else {
+        in->phase = 0;
+        return false;
+    }
+    mix_linear(in, s_acc, s_rs, AUDIO_MIXER_BLOCK_FRAMES);
+    in->tail += used;
+    in->stats.frames += used;
+    xSemaphoreGive(in->space);
+    return true;
+}
+
+/**
+ * @brief       生成一块输出
+ */
+static void mix_block(void)
+{
+    memset(s_acc, 0, sizeof(s_acc));
+
+    for (int i = 0; i < AUDIO_MIXER_MAX_INPUTS; i++) {
+        mixer_in_t *in = &s_inputs[i];
+        if (!in->open) {
+            continue;
+        }
+
+        uint32_t level = in->head - in->tail;
+        if (in->depth && (in->primed || !in->ended) && mix_tracked(in, level)) {
+            continue;
+        }
+
+        size_t frames = level < AUDIO_MIXER_BLOCK_FRAMES ? level : AUDIO_MIXER_BLOCK_FRAMES;
+        if (frames < AUDIO_MIXER_BLOCK_FRAMES && in->started && !in->ended) {
+            in->stats.underruns++;
+            in->primed = false;     /* 欠载后重新预缓冲 */
+        }
+
+        if (frames > 0) {
+            mix_input(in, s_acc, frames);
+            in->tail += frames;
+            in->stats.frames += frames;
+            xSemaphoreGive(in->space);
+        }
+
+        /* 已结束且播完: 自动关闭 */
+        if (in->ended && in->head == in->tail) {
+            in->open = false;
+        }
+    }
+
+    /* 饱和截断到 16 位 */
+    for (int i = 0; i < AUDIO_MIXER_BLOCK_FRAMES * 2; i++) {
+        int32_t v = s_acc[i];
+        s_out[i] = v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : (int16_t)v);
+    }
+}
+
+/**
+ * @brief       混音任务: 唯一的 I2S 写入方, 由 I2S 写入阻塞控制节奏
+ */
+static void mixer_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        while (s_running) {
+            uint32_t start = esp_cpu_get_cycle_count();
+            mix_block();
+            uint32_t cycles = esp_cpu_get_cycle_count() - start;
+
+            s_blocks++;
+            s_cycles_last = cycles;
+            s_cycles_total += cycles;
+            if (cycles > s_cycles_max) {
+                s_cycles_max = cycles;
+            }
+
+            audio_aec_push_ref(s_out, AUDIO_MIXER_BLOCK_FRAMES);    /* 全双工: 记下发出的采样作回声参考 */
+            i2s_tx_write((uint8_t *)s_out, sizeof(s_out));
+        }
+        xSemaphoreGive(s_idle);
+    }
+}
+
+/**
+ * @brief       初始化混音器
+ */
+esp_err_t audio_mixer_init(void)
+{
+    if (s_task) {
+        return ESP_OK;
+    }
+
+    /* 抖动缓冲: 有 PSRAM 时放大并放入 PSRAM, 混音任务按块顺序读取, 缓存命中率高 */
+    s_ring_frames = audio_mem_get_plan()->mixer_ring_frames;
+    for (int i = 0; i < AUDIO_MIXER_MAX_INPUTS; i++) {
+        mixer_in_t *in = &s_inputs[i];
+        size_t size = s_ring_frames * 2 * sizeof(int16_t);
+
+        in->ring = audio_mem_alloc("mixer_ring", AUDIO_MEM_PSRAM, size);
+        in->space = xSemaphoreCreateBinary();
+        if (!in->ring || !in->space) {
+            ESP_LOGE(TAG, "输入 %d 缓冲区分配失败", i);
+            return ESP_ERR_NO_MEM;
+        }
+        in->gain = AUDIO_MIXER_GAIN_UNITY;
+        in->target = AUDIO_MIXER_GAIN_UNITY;
+    }
+
+    s_idle = xSemaphoreCreateBinary();
+    if (!s_idle) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    /* 与录音任务同核: 两者都阻塞在 I2S 上, 交替运行 */
+    if (xTaskCreatePinnedToCore(mixer_task, "mixer", 3072, NULL, 10, &s_task, 1) != pdPASS) {
+        s_task = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "混音器初始化完成, %d 路输入, 块 %d 帧, 环形缓冲 %d 帧",
+             AUDIO_MIXER_MAX_INPUTS, AUDIO_MIXER_BLOCK_FRAMES, (int)s_ring_frames);
+    return ESP_OK;
+}
+
+/**
+ * @brief       开始输出
+ */
+void audio_mixer_start(void)
+{
+    if (!s_task || s_running) {
+        return;
+    }
+    xSemaphoreTake(s_idle, 0);
+    s_running = true;
+    xTaskNotifyGive(s_task);
+}
+
+/**
+ * @brief       停止输出并关闭所有输入
+ */
+void audio_mixer_stop(void)
+{
+    if (!s_task) {
+        return;
+    }
+
+    if (s_running) {
+        s_running = false;
+        xSemaphoreTake(s_idle, pdMS_TO_TICKS(200));
+    }
+    for (int i = 0; i < AUDIO_MIXER_MAX_INPUTS; i++) {
+        audio_mixer_close((mixer_input_t)i);
+    }
+}
+
+/**
+ * @brief       打开输入
+ */
+esp_err_t audio_mixer_open(mixer_input_t input, uint32_t gain)
+{
+    if ((unsigned)input >= AUDIO_MIXER_MAX_INPUTS || !s_task) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    mixer_in_t *in = &s_inputs[input];
+    in->open = false;
+    in->head = in->tail;
+    in->started = false;
+    in->ended = false;
+    in->gain = gain > GAIN_MAX ? GAIN_MAX : (int32_t)gain;
+    in->target = in->gain;
+    in->ramp_left = 0;
+    in->depth = 0;
+    in->primed = false;
+    in->phase = 0;
+    in->hist[0] = in->hist[1] = 0;
+    in->tsm_wait = 0;
+    memset(&in->stats, 0, sizeof(in->stats));
+    xSemaphoreTake(in->space, 0);
+    in->open = true;
+    return ESP_OK;
+}
+
+/**
+ * @brief       设置输入的目标缓冲深度
+ */
+void audio_mixer_set_target(mixer_input_t input, uint32_t frames)
+{
+    if ((unsigned)input >= AUDIO_MIXER_MAX_INPUTS) {
+        return;
+    }
+    mixer_in_t *in = &s_inputs[input];
+    uint32_t limit = s_ring_frames - AUDIO_MIXER_BLOCK_FRAMES;
+
+    in->depth = frames > limit ? limit : frames;
+    in->retarget = true;
+}
+
+/**
+ * @brief       标记输入结束
+ */
+void audio_mixer_end(mixer_input_t input)
+{
+    if ((unsigned)input < AUDIO_MIXER_MAX_INPUTS) {
+        s_inputs[input].ended = true;
+    }
+}
+
+/**
+ * @brief       立即关闭输入
+ */
+void audio_mixer_close(mixer_input_t input)
+{
+    if ((unsigned)input >= AUDIO_MIXER_MAX_INPUTS || !s_task) {
+        return;
+    }
+    s_inputs[input].open = false;
+    xSemaphoreGive(s_inputs[input].space);     /* 唤醒阻塞的写入方 */
+}
+
+/**
+ * @brief       设置输入增益
+ */
+void audio_mixer_set_gain(mixer_input_t input, uint32_t gain)
+{
+    if ((unsigned)input >= AUDIO_MIXER_MAX_INPUTS) {
+        return;
+    }
+    mixer_in_t *in = &s_inputs[input];
+    in->target = gain > GAIN_MAX ? GAIN_MAX : (int32_t)gain;
+    in->ramp_left = AUDIO_MIXER_RAMP_FRAMES;
+}
+
+/**
+ * @brief       写入立体声 PCM
+ */
+size_t audio_mixer_write(mixer_input_t input, const int16_t *pcm, size_t frames, TickType_t timeout)
+{
+    if ((unsigned)input >= AUDIO_MIXER_MAX_INPUTS || !s_task) {
+        return 0;
+    }
+
+    mixer_in_t *in = &s_inputs[input];
+    TickType_t start = xTaskGetTickCount();
+    size_t written = 0;
+
+    while (written < frames && in->open) {
+        uint32_t space = s_ring_frames - (in->head - in->tail);
+        if (space == 0) {
+            TickType_t waited = xTaskGetTickCount() - start;
+            if (waited >= timeout || xSemaphoreTake(in->space, timeout - waited) != pdTRUE) {
+                break;
+            }
+            continue;
+        }
+
+        uint32_t pos = in->head & RING_MASK;
+        size_t seg = s_ring_frames - pos;
+        if (seg > space) {
+            seg = space;
+        }
+        if (seg > frames - written) {
+            seg = frames - written;
+        }
+        memcpy(in->ring + pos * 2, pcm + written * 2, seg * 2 * sizeof(int16_t));
+        in->head += seg;
+        written += seg;
+        in->started = true;
+    }
+
+    if (written < frames && in->open) {
+        in->stats.overruns += frames - written;
+    }
+    return written;
+}
+
+/**
+ * @brief       写入单声道 PCM
+ */
+size_t audio_mixer_write_mono(mixer_input_t input, const uint8_t *pcm, size_t samples, TickType_t timeout)
+{
+    int16_t stereo[128 * 2];
+    size_t done = 0;
+
+    while (done < samples) {
+        size_t n = samples - done > 128 ? 128 : samples - done;
+        for (size_t i = 0; i < n; i++) {
+            const uint8_t *p = pcm + (done + i) * 2;
+            int16_t sample = (int16_t)(p[0] | (p[1] << 8));
+            stereo[i * 2] = sample;
+            stereo[i * 2 + 1] = sample;
+        }
+        size_t written = audio_mixer_write(input, stereo, n, timeout);
+        done += written;
+        if (written < n) {
+            break;
+        }
+    }
+    return done;
+}
+
+/**
+ * @brief       读取混音统计
+ */
+void audio_mixer_get_stats(mixer_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->blocks = s_blocks;
+    stats->cycles_last = s_cycles_last;
+    stats->cycles_max = s_cycles_max;
+    stats->cycles_avg = s_blocks ? (uint32_t)(s_cycles_total / s_blocks) : 0;
+    stats->tsm_cycles_max = s_tsm_cycles_max;
+
+    for (int i = 0; i < AUDIO_MIXER_MAX_INPUTS; i++) {
+        stats->inputs[i] = s_inputs[i].stats;
+        stats->inputs[i].level = s_inputs[i].head - s_inputs[i].tail;
+    }
+}
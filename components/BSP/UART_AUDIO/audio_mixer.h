@@ -0,0 +1,147 @@
+/**
+ ****************************************************************************************************
+ * @file        audio_mixer.h
+ * @author      Audio Serial Transfer
+ * @version     V1.0
+ * @date        2026-10-17
+ * @brief       软件混音器 - 多路输入环形缓冲, 单一 I2S 写入任务
+ *
+ *              各输入为 16bit 立体声交错 PCM, 采样率与当前 I2S 时钟一致;
+ *              每块按输入增益 (Q15, 线性渐变) 累加到 32 位, 饱和截断后写入 I2S。
+ *              每块的计算量只与打开的输入数有关, 与内容无关。
+ *              设置了目标深度的输入 (写入方与 I2S 时钟不同源, 如主机按墙钟发送的 PCM) 按缓冲深度趋势
+ *              估计时钟偏差, 经四点三次插值的分数重采样微调消耗速率, 使深度长期停在目标附近;
+ *              链路抖动造成的大幅偏离由 WSOLA 时长伸缩 (按波形相似度选拼接点, 不改音高) 拉回。
+ ****************************************************************************************************
+ */
+
+#ifndef __AUDIO_MIXER_H__
+#define __AUDIO_MIXER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+/* 混音器配置 */
+#define AUDIO_MIXER_MAX_INPUTS      4       /* 输入路数 */
+#define AUDIO_MIXER_BLOCK_FRAMES    256     /* 每块帧数 (立体声帧), 8kHz 下 32ms */
+#define AUDIO_MIXER_RING_FRAMES     2048    /* 每路环形缓冲帧数 (默认值, 实际按 audio_mem 计划) */
+#define AUDIO_MIXER_GAIN_UNITY      32768   /* Q15 增益 1.0 */
+#define AUDIO_MIXER_RAMP_FRAMES     256     /* 增益渐变时长 (帧), 避免切换时的爆音 */
+#define AUDIO_MIXER_DRIFT_MAX_PPM   1000    /* 自适应重采样最大速率偏差 (ppm) */
+#define AUDIO_MIXER_TSM_THRESHOLD   25      /* 深度偏离目标超过该百分比时启用时长伸缩 */
+#define AUDIO_MIXER_TSM_INTERVAL    8       /* 时长伸缩最多每 N 块一次 (限制平均速率变化在几个百分点内) */
+
+/* 输入编号 */
+typedef enum {
+    MIXER_INPUT_STREAM = 0,         /* 主机音频流 (播放/全双工) */
+    MIXER_INPUT_PROMPT,             /* 提示音 */
+    MIXER_INPUT_AUX0,               /* 其他来源 */
+    MIXER_INPUT_AUX1,
+} mixer_input_t;
+
+/* 单路统计 */
+typedef struct {
+    uint32_t frames;                /* 已混入的帧数 */
+    uint32_t underruns;             /* 欠载次数 (打开且未结束时本块数据不足) */
+    uint32_t overruns;              /* 写入超时丢弃的帧数 */
+    uint32_t level;                 /* 当前缓冲帧数 */
+    int32_t drift_ppm;              /* 自适应重采样当前速率偏差 (ppm, 正值为加快消耗) */
+    uint32_t primes;                /* 预缓冲到目标深度的次数 (开始一次, 之后每次欠载一次) */
+    uint32_t stretches;             /* 时长伸缩: 拉长的块数 (缓冲偏低) */
+    uint32_t compressions;          /* 时长伸缩: 压缩的块数 (缓冲偏高) */
+} mixer_input_stats_t;
+
+/* 混音器统计 */
+typedef struct {
+    uint32_t blocks;                /* 已输出块数 */
+    uint32_t cycles_last;           /* 最近一块的混音 CPU 周期 (不含 I2S 写入) */
+    uint32_t cycles_max;            /* 每块最大混音周期 */
+    uint32_t cycles_avg;            /* 每块平均混音周期 */
+    uint32_t tsm_cycles_max;        /* 时长伸缩单块最大周期 (含相似度搜索, 搜索范围固定, 有上界) */
+    mixer_input_stats_t inputs[AUDIO_MIXER_MAX_INPUTS];
+} mixer_stats_t;
+
+/**
+ * @brief       初始化混音器 (分配环形缓冲, 创建混音任务, 初始为停止状态)
+ * @retval      ESP_OK: 成功; ESP_ERR_NO_MEM: 内存不足
+ */
+esp_err_t audio_mixer_init(void);
+
+/**
+ * @brief       开始输出 (I2S 已启动后调用)
+ * @note        无输入数据时输出静音, 保持 I2S 连续
+ */
+void audio_mixer_start(void);
+
+/**
+ * @brief       停止输出并关闭所有输入 (在 I2S 停止前调用, 等待当前块写完)
+ */
+void audio_mixer_stop(void);
+
+/**
+ * @brief       打开输入 (清空缓冲, 统计清零)
+ * @param       input: 输入编号
+ * @param       gain: 初始增益 (Q15, AUDIO_MIXER_GAIN_UNITY 为 1.0)
+ * @retval      ESP_OK: 成功; ESP_ERR_INVALID_ARG: 编号无效
+ */
+esp_err_t audio_mixer_open(mixer_input_t input, uint32_t gain);
+
+/**
+ * @brief       设置输入的目标缓冲深度 (开启自适应重采样)
+ * @note        开始输出前及每次欠载后先预缓冲到目标深度; 之后按深度偏差 (平滑后, PI 控制)
+ *              在 ±AUDIO_MIXER_DRIFT_MAX_PPM 内调整消耗速率, 补偿写入方与 I2S 的时钟偏差;
+ *              偏差超过 AUDIO_MIXER_TSM_THRESHOLD% 时按块拉长或压缩语音, 较快回到目标
+ * @param       input: 输入编号
+ * @param       frames: 目标帧数, 0 关闭 (按 I2S 速率直接消耗, 由写入阻塞控制节奏)
+ */
+void audio_mixer_set_target(mixer_input_t input, uint32_t frames);
+
+/**
+ * @brief       标记输入结束: 缓冲播完后自动关闭, 不再计为欠载
+ * @param       input: 输入编号
+ */
+void audio_mixer_end(mixer_input_t input);
+
+/**
+ * @brief       立即关闭输入 (丢弃未播放的数据)
+ * @param       input: 输入编号
+ */
+void audio_mixer_close(mixer_input_t input);
+
+/**
+ * @brief       设置输入增益 (在 AUDIO_MIXER_RAMP_FRAMES 帧内线性渐变到目标值)
+ * @param       input: 输入编号
+ * @param       gain: 目标增益 (Q15)
+ */
+void audio_mixer_set_gain(mixer_input_t input, uint32_t gain);
+
+/**
+ * @brief       写入立体声 PCM (缓冲满时阻塞等待)
+ * @param       input: 输入编号
+ * @param       pcm: 16bit 立体声交错数据
+ * @param       frames: 帧数
+ * @param       timeout: 最长等待时间
+ * @retval      实际写入的帧数 (输入未打开或超时时小于 frames)
+ */
+size_t audio_mixer_write(mixer_input_t input, const int16_t *pcm, size_t frames, TickType_t timeout);
+
+/**
+ * @brief       写入单声道 PCM (复制为左右声道)
+ * @param       input: 输入编号
+ * @param       pcm: 16bit 单声道数据, 小端字节序, 可不对齐
+ * @param       samples: 采样数
+ * @param       timeout: 最长等待时间
+ * @retval      实际写入的采样数
+ */
+size_t audio_mixer_write_mono(mixer_input_t input, const uint8_t *pcm, size_t samples, TickType_t timeout);
+
+/**
+ * @brief       读取混音统计
+ * @param       stats: 输出
+ */
+void audio_mixer_get_stats(mixer_stats_t *stats);
+
+#endif /* __AUDIO_MIXER_H__ */
@@ -0,0 +1,121 @@
+/**
+ ****************************************************************************************************
+ * @file        audio_plc.c
+ * @author      Audio Serial Transfer
+ * @version     V1.0
+ * @date        2026-10-17
+ * @brief       丢包隐藏 - 按基音周期重复最近的波形并逐渐衰减, 补上丢失的 PCM 帧
+ ****************************************************************************************************
+ */
+
+#include "audio_plc.h"
+#include <string.h>
+
+#define GAIN_UNITY      32768
+
+/**
+ * @brief       周期延拓的第 pos 个合成采样 (未加增益)
+ */
+static inline int32_t synth_at(const audio_plc_t *plc, uint32_t pos)
+{
+    return plc->hist[AUDIO_PLC_HISTORY - plc->pitch + pos % plc->pitch];
+}
+
+/**
+ * @brief       在历史末尾搜索基音周期 (归一化自相关最大的延迟)
+ * @note        计算量不超过 (最长周期 - 最短周期) × AUDIO_PLC_WINDOW 次乘加, 每次丢包只算一次
+ * @retval      周期 (采样), 0 表示历史不足
+ */
+static uint32_t find_pitch(const audio_plc_t *plc, uint32_t rate)
+{
+    uint32_t min_lag = rate / AUDIO_PLC_PITCH_MAX_HZ;
+    uint32_t max_lag = rate / AUDIO_PLC_PITCH_MIN_HZ;
+
+    if (plc->hist_len < min_lag + AUDIO_PLC_WINDOW) {
+        return plc->hist_len >= min_lag ? plc->hist_len : 0;    /* 历史太短: 重复全部历史 */
+    }
+    if (max_lag + AUDIO_PLC_WINDOW > plc->hist_len) {
+        max_lag = plc->hist_len - AUDIO_PLC_WINDOW;
+    }
+
+    const int16_t *ref = plc->hist + AUDIO_PLC_HISTORY - AUDIO_PLC_WINDOW;
+    uint32_t best = max_lag;
+    float best_score = 0.0f;
+
+    for (uint32_t lag = min_lag; lag <= max_lag; lag++) {
+        const int16_t *cand = ref - lag;
+        int64_t corr = 0, energy = 1;
+        for (int i = 0; i < AUDIO_PLC_WINDOW; i++) {
+            corr += (int32_t)ref[i] * cand[i];
+            energy += (int32_t)cand[i] * cand[i];
+        }
+        float score = corr > 0 ? (float)corr * (float)corr / (float)energy : 0.0f;
+        if (score > best_score) {
+            best_score = score;
+            best = lag;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief       复位
+ */
+void audio_plc_reset(audio_plc_t *plc)
+{
+    memset(plc, 0, sizeof(*plc));
+}
+
+/**
+ * @brief       收到一帧正常数据
+ */
+size_t audio_plc_receive(audio_plc_t *plc, const uint8_t *data, size_t samples, int16_t *merged)
+{
+    size_t n = 0;
+
+    /* 紧接隐藏之后: 从 (继续衰减的) 合成信号淡入真实信号 */
+    if (plc->pitch) {
+        n = samples < AUDIO_PLC_MERGE ? samples : AUDIO_PLC_MERGE;
+        for (size_t i = 0; i < n; i++) {
+            int32_t s = synth_at(plc, plc->pos++) * plc->gain >> 15;
+            int32_t r = (int16_t)(data[i * 2] | (data[i * 2 + 1] << 8));
+            merged[i] = (int16_t)(s + (r - s) * (int32_t)(i + 1) / (int32_t)(n + 1));
+            plc->gain = plc->gain > plc->gain_step ? plc->gain - plc->gain_step : 0;
+        }
+        plc->pitch = 0;
+    }
+
+    /* 记入历史 (保留最近 AUDIO_PLC_HISTORY 个采样) */
+    size_t keep = samples < AUDIO_PLC_HISTORY ? samples : AUDIO_PLC_HISTORY;
+    const uint8_t *src = data + (samples - keep) * 2;
+    memmove(plc->hist, plc->hist + keep, (AUDIO_PLC_HISTORY - keep) * sizeof(int16_t));
+    for (size_t i = 0; i < keep; i++) {
+        plc->hist[AUDIO_PLC_HISTORY - keep + i] = (int16_t)(src[i * 2] | (src[i * 2 + 1] << 8));
+    }
+    plc->hist_len = plc->hist_len + keep > AUDIO_PLC_HISTORY ? AUDIO_PLC_HISTORY : plc->hist_len + keep;
+    return n;
+}
+
+/**
+ * @brief       合成丢失的采样
+ */
+size_t audio_plc_conceal(audio_plc_t *plc, int16_t *out, size_t samples, uint32_t rate)
+{
+    /* 一次丢包 (可能连续多帧) 开始时搜索一次周期 */
+    if (!plc->pitch) {
+        plc->pitch = find_pitch(plc, rate);
+        if (!plc->pitch) {
+            return 0;
+        }
+        plc->pos = 0;
+        plc->gain = GAIN_UNITY;
+        plc->gain_step = GAIN_UNITY / (int32_t)(rate * AUDIO_PLC_FADE_MS / 1000 + 1) + 1;
+    }
+
+    for (size_t i = 0; i < samples; i++) {
+        out[i] = (int16_t)(synth_at(plc, plc->pos++) * plc->gain >> 15);
+        plc->gain = plc->gain > plc->gain_step ? plc->gain - plc->gain_step : 0;
+    }
+    plc->pos %= plc->pitch;
+    return samples;
+}
@@ -0,0 +1,66 @@
+/**
+ ****************************************************************************************************
+ * @file        audio_plc.h
+ * @author      Audio Serial Transfer
+ * @version     V1.0
+ * @date        2026-10-17
+ * @brief       丢包隐藏 - 按基音周期重复最近的波形并逐渐衰减, 补上丢失的 PCM 帧
+ *
+ *              正常帧经 audio_plc_receive 记入历史; 检测到丢帧时 audio_plc_conceal 在历史上
+ *              搜索基音周期 (归一化自相关), 周期延拓合成缺失的采样, 增益在 AUDIO_PLC_FADE_MS 内
+ *              线性降到静音; 恢复后的第一帧与合成信号交叉淡化, 避免接缝处的爆音。
+ *              单声道 16bit, 状态由调用方持有, 不分配内存。
+ ****************************************************************************************************
+ */
+
+#ifndef __AUDIO_PLC_H__
+#define __AUDIO_PLC_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define AUDIO_PLC_HISTORY       1024        /* 历史采样数 (基音搜索窗口 + 最长周期) */
+#define AUDIO_PLC_WINDOW        256         /* 自相关窗口 (采样) */
+#define AUDIO_PLC_MERGE         64          /* 恢复时交叉淡化的采样数 */
+#define AUDIO_PLC_FADE_MS       40          /* 连续隐藏时衰减到静音的时长 */
+#define AUDIO_PLC_PITCH_MIN_HZ  70          /* 搜索的最低基频 */
+#define AUDIO_PLC_PITCH_MAX_HZ  400         /* 搜索的最高基频 */
+
+/* 丢包隐藏状态 */
+typedef struct {
+    int16_t hist[AUDIO_PLC_HISTORY];        /* 最近收到的采样, 新的在后 */
+    uint32_t hist_len;                      /* 有效历史采样数 */
+    uint32_t pitch;                         /* 当前合成的周期 (采样), 0 表示未在隐藏 */
+    uint32_t pos;                           /* 周期内的合成位置 */
+    int32_t gain;                           /* 合成增益 (Q15) */
+    int32_t gain_step;                      /* 每采样的增益衰减 */
+} audio_plc_t;
+
+/**
+ * @brief       复位 (新会话/曲目切换时调用, 清空历史)
+ * @param       plc: 状态
+ */
+void audio_plc_reset(audio_plc_t *plc);
+
+/**
+ * @brief       收到一帧正常数据: 记入历史; 紧接隐藏之后时与合成信号交叉淡化
+ * @param       plc: 状态
+ * @param       data: 16bit 小端 PCM (可不对齐)
+ * @param       samples: 采样数
+ * @param       merged: 输出, 交叉淡化后的帧头 (至少 AUDIO_PLC_MERGE 个采样)
+ * @retval      merged 中的采样数, 0 表示无需替换帧头; 调用方先播放 merged, 再播放 data 的其余部分
+ */
+size_t audio_plc_receive(audio_plc_t *plc, const uint8_t *data, size_t samples, int16_t *merged);
+
+/**
+ * @brief       合成丢失的采样
+ * @param       plc: 状态
+ * @param       out: 输出
+ * @param       samples: 需要的采样数 (可分多次调用, 衰减连续)
+ * @param       rate: 采样率 (确定基音搜索范围和衰减速度)
+ * @retval      合成的采样数 (无历史时为 0, 调用方按静音处理)
+ */
+size_t audio_plc_conceal(audio_plc_t *plc, int16_t *out, size_t samples, uint32_t rate);
+
+#endif /* __AUDIO_PLC_H__ */
@@ -0,0 +1,302 @@
+/**
+ ****************************************************************************************************
+ * @file        audio_pm.c
+ * @author      Audio Serial Transfer
+ * @version     V1.0
+ * @date        2026-10-17
+ * @brief       音频电源管理 - 按流状态持有 PM 锁, 空闲时降频并自动浅睡眠, 统计各状态时间与 CPU 余量
+ ****************************************************************************************************
+ */
+
+#include "audio_pm.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "AUDIO_PM";
+
+static esp_pm_lock_handle_t s_cpu_lock = NULL;      /* 解码: CPU 最高频 */
+static esp_pm_lock_handle_t s_apb_lock = NULL;      /* 会话: APB 最高频 (UART/I2S 时钟) */
+static esp_pm_lock_handle_t s_session_lock = NULL;  /* 会话: 禁止浅睡眠 */
+static esp_pm_lock_handle_t s_link_lock = NULL;     /* 链路活跃: 禁止浅睡眠 */
+static esp_timer_handle_t s_link_timer = NULL;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool s_decoding = false;
+static bool s_session = false;
+static bool s_link_held = false;
+static volatile int64_t s_last_activity_us = 0;
+
+/* 状态时间统计 */
+static audio_pm_state_t s_state = AUDIO_PM_SLEEP;
+static int64_t s_state_since_us = 0;
+static uint64_t s_state_us[AUDIO_PM_STATE_COUNT];
+
+/* CPU 空闲率采样 */
+static uint32_t s_idle_prev[2];
+static int64_t s_idle_wall_prev = 0;
+
+static const uint32_t s_state_ua[AUDIO_PM_STATE_COUNT] = {
+    AUDIO_PM_DECODE_UA, AUDIO_PM_SESSION_UA, AUDIO_PM_LINK_UA, AUDIO_PM_SLEEP_UA,
+};
+static const char *s_state_names[AUDIO_PM_STATE_COUNT] = {"解码", "会话", "链路", "睡眠"};
+
+/**
+ * @brief       由锁状态推出当前电源状态并累计上一状态的时间 (调用方持有 s_lock)
+ */
+static void state_update_locked(void)
+{
+    audio_pm_state_t state;
+    int64_t now = esp_timer_get_time();
+
+    if (s_decoding) {
+        state = AUDIO_PM_DECODE;
+    } else if (s_session) {
+        state = AUDIO_PM_SESSION;
+    } else if (s_link_held) {
+        state = AUDIO_PM_LINK;
+    } else {
+        state = AUDIO_PM_SLEEP;
+    }
+    s_state_us[s_state] += now - s_state_since_us;
+    s_state_since_us = now;
+    s_state = state;
+}
+
+/**
+ * @brief       获取/释放 PM 锁 (未启用 PM 时句柄为 NULL, 直接忽略)
+ */
+static void lock_set(esp_pm_lock_handle_t lock, bool hold)
+{
+    if (!lock) {
+        return;
+    }
+    if (hold) {
+        esp_pm_lock_acquire(lock);
+    } else {
+        esp_pm_lock_release(lock);
+    }
+}
+
+/**
+ * @brief       链路空闲定时器: 最后一帧后满 AUDIO_PM_LINK_IDLE_MS 才允许浅睡眠
+ */
+static void link_idle_cb(void *arg)
+{
+    int64_t idle_us = esp_timer_get_time() - s_last_activity_us;
+    int64_t limit_us = (int64_t)AUDIO_PM_LINK_IDLE_MS * 1000;
+
+    if (idle_us < limit_us) {
+        esp_timer_start_once(s_link_timer, limit_us - idle_us);
+        return;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    s_link_held = false;
+    state_update_locked();
+    portEXIT_CRITICAL(&s_lock);
+    lock_set(s_link_lock, false);
+}
+
+/**
+ * @brief       初始化电源管理
+ */
+esp_err_t audio_pm_init(void)
+{
+    esp_err_t ret = ESP_OK;
+
+    s_state_since_us = esp_timer_get_time();
+    s_idle_wall_prev = s_state_since_us;
+
+#if CONFIG_PM_ENABLE
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = AUDIO_PM_MAX_FREQ_MHZ,
+        .min_freq_mhz = AUDIO_PM_MIN_FREQ_MHZ,
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+        .light_sleep_enable = true,
+#endif
+    };
+    ret = esp_pm_configure(&pm_config);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "动态调频配置失败: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "audio_decode", &s_cpu_lock);
+    if (ret == ESP_OK) {
+        ret = esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "audio_session", &s_apb_lock);
+    }
+    if (ret == ESP_OK) {
+        ret = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "audio_session", &s_session_lock);
+    }
+    if (ret == ESP_OK) {
+        ret = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "audio_link", &s_link_lock);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "PM 锁创建失败: %s", esp_err_to_name(ret));
+        return ret;
+    }
+    ESP_LOGI(TAG, "动态调频 %d-%d MHz, 自动浅睡眠 %s", AUDIO_PM_MIN_FREQ_MHZ, AUDIO_PM_MAX_FREQ_MHZ,
+             pm_config.light_sleep_enable ? "开启" : "关闭");
+#else
+    ESP_LOGI(TAG, "未启用 CONFIG_PM_ENABLE, 固定频率运行");
+#endif
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = link_idle_cb,
+        .name = "pm_link_idle",
+    };
+    ret = esp_timer_create(&timer_args, &s_link_timer);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    /* 上电后先保持一个链路窗口, 主机的第一条命令不经过睡眠唤醒 */
+    audio_pm_link_activity();
+    return ESP_OK;
+}
+
+/**
+ * @brief       切换流状态
+ */
+void audio_pm_set_stream(bool decoding, bool session)
+{
+    session = session || decoding;
+
+    portENTER_CRITICAL(&s_lock);
+    bool was_decoding = s_decoding, was_session = s_session;
+    s_decoding = decoding;
+    s_session = session;
+    state_update_locked();
+    portEXIT_CRITICAL(&s_lock);
+
+    /* 先提频再开会话, 先关会话再降频 */
+    if (decoding && !was_decoding) {
+        lock_set(s_cpu_lock, true);
+    }
+    if (session != was_session) {
+        lock_set(s_apb_lock, session);
+        lock_set(s_session_lock, session);
+    }
+    if (!decoding && was_decoding) {
+        lock_set(s_cpu_lock, false);
+    }
+}
+
+/**
+ * @brief       链路活动
+ */
+void audio_pm_link_activity(void)
+{
+    s_last_activity_us = esp_timer_get_time();
+    if (s_link_held || !s_link_timer) {
+        return;
+    }
+
+    portENTER_CRITICAL(&s_lock);
+    bool acquire = !s_link_held;
+    s_link_held = true;
+    state_update_locked();
+    portEXIT_CRITICAL(&s_lock);
+
+    if (acquire) {
+        lock_set(s_link_lock, true);
+        esp_timer_start_once(s_link_timer, (uint64_t)AUDIO_PM_LINK_IDLE_MS * 1000);
+    }
+}
+
+/**
+ * @brief       允许 UART RX 唤醒浅睡眠
+ */
+void audio_pm_enable_uart_wakeup(uart_port_t uart_num)
+{
+#if CONFIG_PM_ENABLE && CONFIG_FREERTOS_USE_TICKLESS_IDLE
+    esp_err_t ret = uart_set_wakeup_threshold(uart_num, AUDIO_PM_UART_WAKE_EDGES);
+    if (ret == ESP_OK) {
+        ret = esp_sleep_enable_uart_wakeup(uart_num);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "UART%d 不能唤醒浅睡眠: %s", uart_num, esp_err_to_name(ret));
+    }
+#else
+    (void)uart_num;
+#endif
+}
+
+/**
+ * @brief       当前电源状态
+ */
+audio_pm_state_t audio_pm_get_state(void)
+{
+    return s_state;
+}
+
+/**
+ * @brief       采样各核空闲率 (空闲任务运行时间 / 墙钟时间, 浅睡眠计入空闲)
+ */
+static void sample_cpu_idle(uint32_t idle_pct[2])
+{
+    idle_pct[0] = idle_pct[1] = 0;
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    int64_t now = esp_timer_get_time();
+    uint32_t wall = (uint32_t)(now - s_idle_wall_prev);
+
+    for (int i = 0; i < portNUM_PROCESSORS && i < 2; i++) {
+        uint32_t idle = (uint32_t)ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(i));
+        uint32_t delta = idle - s_idle_prev[i];
+        s_idle_prev[i] = idle;
+        if (wall > 0) {
+            uint64_t pct = (uint64_t)delta * 100 / wall;
+            idle_pct[i] = pct > 100 ? 100 : (uint32_t)pct;
+        }
+    }
+    s_idle_wall_prev = now;
+#endif
+}
+
+/**
+ * @brief       读取电源统计
+ */
+void audio_pm_get_stats(audio_pm_stats_t *stats)
+{
+    uint64_t state_us[AUDIO_PM_STATE_COUNT];
+    uint64_t total_us = 0, charge = 0;
+
+    memset(stats, 0, sizeof(*stats));
+
+    portENTER_CRITICAL(&s_lock);
+    memcpy(state_us, s_state_us, sizeof(state_us));
+    state_us[s_state] += esp_timer_get_time() - s_state_since_us;
+    portEXIT_CRITICAL(&s_lock);
+
+    for (int i = 0; i < AUDIO_PM_STATE_COUNT; i++) {
+        stats->state_ms[i] = (uint32_t)(state_us[i] / 1000);
+        total_us += state_us[i];
+        charge += state_us[i] / 1000 * s_state_ua[i];
+    }
+    if (total_us >= 1000) {
+        stats->avg_current_ua = (uint32_t)(charge / (total_us / 1000));
+    }
+    sample_cpu_idle(stats->cpu_idle_pct);
+}
+
+/**
+ * @brief       打印电源统计
+ */
+void audio_pm_report(void)
+{
+    audio_pm_stats_t st;
+
+    audio_pm_get_stats(&st);
+    for (int i = 0; i < AUDIO_PM_STATE_COUNT; i++) {
+        ESP_LOGI(TAG, "%s: %8lu ms, 典型 %5.1f mA", s_state_names[i], (unsigned long)st.state_ms[i],
+                 s_state_ua[i] / 1000.0f);
+    }
+    ESP_LOGI(TAG, "当前状态 %s, 估算平均电流 %.1f mA, CPU 空闲 %lu%% / %lu%%",
+             s_state_names[s_state], st.avg_current_ua / 1000.0f,
+             (unsigned long)st.cpu_idle_pct[0], (unsigned long)st.cpu_idle_pct[1]);
+}
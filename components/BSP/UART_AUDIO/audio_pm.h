@@ -0,0 +1,93 @@
+/**
+ ****************************************************************************************************
+ * @file        audio_pm.h
+ * @author      Audio Serial Transfer
+ * @version     V1.0
+ * @date        2026-10-17
+ * @brief       音频电源管理 - 按流状态持有 PM 锁, 空闲时降频并自动浅睡眠, 统计各状态时间与 CPU 余量
+ *
+ *              解码 (播放/全双工): CPU 锁最高频;
+ *              会话 (录音/播放/全双工): APB 锁最高频 + 禁止浅睡眠, 保证 UART/I2S 时钟稳定;
+ *              链路活跃 (空闲但最近收到过帧): 禁止浅睡眠, 主机交互无唤醒延迟;
+ *              其余时间降到最低频率并允许自动浅睡眠, 由 UART/按键唤醒。
+ ****************************************************************************************************
+ */
+
+#ifndef __AUDIO_PM_H__
+#define __AUDIO_PM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "driver/uart.h"
+
+#define AUDIO_PM_MAX_FREQ_MHZ       240         /* 解码时 CPU 频率 */
+#define AUDIO_PM_MIN_FREQ_MHZ       40          /* 空闲时 CPU 频率 (XTAL) */
+#define AUDIO_PM_LINK_IDLE_MS       30000       /* 最后一帧后保持唤醒的时间 */
+#define AUDIO_PM_UART_WAKE_EDGES    3           /* 浅睡眠中 UART RX 唤醒所需的上升沿数 */
+
+/* 各状态的典型电流 (估算用, 按实测板级电流校准) */
+#define AUDIO_PM_DECODE_UA          68000       /* 240MHz 双核, I2S + 编解码 */
+#define AUDIO_PM_SESSION_UA         36000       /* 80MHz, I2S + UART 收发 */
+#define AUDIO_PM_LINK_UA            20000       /* 40MHz 唤醒等待 */
+#define AUDIO_PM_SLEEP_UA           1500        /* 自动浅睡眠 (含外设漏电) */
+
+/* 电源状态 */
+typedef enum {
+    AUDIO_PM_DECODE = 0,            /* 播放/全双工: CPU 最高频 */
+    AUDIO_PM_SESSION,               /* 录音: APB 最高频, 不睡眠 */
+    AUDIO_PM_LINK,                  /* 空闲, 链路活跃: 最低频, 不睡眠 */
+    AUDIO_PM_SLEEP,                 /* 空闲: 最低频, 允许浅睡眠 */
+    AUDIO_PM_STATE_COUNT,
+} audio_pm_state_t;
+
+/* 电源统计 */
+typedef struct {
+    uint32_t state_ms[AUDIO_PM_STATE_COUNT];    /* 各状态累计时间 (ms) */
+    uint32_t avg_current_ua;                    /* 按状态时间加权的估算平均电流 (uA) */
+    uint32_t cpu_idle_pct[2];                   /* 各核空闲率 (%, 自上次查询以来, 即 CPU 余量) */
+} audio_pm_stats_t;
+
+/**
+ * @brief       初始化电源管理 (配置动态调频与自动浅睡眠, 创建 PM 锁)
+ * @note        未启用 CONFIG_PM_ENABLE 时只做状态时间统计
+ * @retval      ESP_OK: 成功; 其他: 锁创建失败
+ */
+esp_err_t audio_pm_init(void);
+
+/**
+ * @brief       切换流状态 (模式切换时调用)
+ * @param       decoding: 正在播放/解码 (需要 CPU 最高频)
+ * @param       session: 有会话打开 (录音/播放/全双工)
+ */
+void audio_pm_set_stream(bool decoding, bool session);
+
+/**
+ * @brief       链路活动 (收到有效帧时调用): 在 AUDIO_PM_LINK_IDLE_MS 内保持唤醒
+ */
+void audio_pm_link_activity(void);
+
+/**
+ * @brief       允许指定 UART 的 RX 把芯片从浅睡眠中唤醒
+ * @note        唤醒所用的前几个字节会丢失, 帧解码器重新同步, 主机需重发该命令
+ * @param       uart_num: 串口号
+ */
+void audio_pm_enable_uart_wakeup(uart_port_t uart_num);
+
+/**
+ * @brief       当前电源状态
+ */
+audio_pm_state_t audio_pm_get_state(void);
+
+/**
+ * @brief       读取电源统计 (CPU 空闲率窗口从上次查询开始)
+ * @param       stats: 输出
+ */
+void audio_pm_get_stats(audio_pm_stats_t *stats);
+
+/**
+ * @brief       打印各状态时间、估算电流与 CPU 余量
+ */
+void audio_pm_report(void);
+
+#endif /* __AUDIO_PM_H__ */
@@ -0,0 +1,186 @@
+/**
+ ****************************************************************************************************
+ * @file        audio_pool.c
+ * @author      Audio Serial Transfer
+ * @version     V1.0
+ * @date        2026-10-17
+ * @brief       定长音频块缓冲池 - 引用计数, 按内存层级分配, 经队列在任务间传递指针
+ ****************************************************************************************************
+ */
+
+#include "audio_pool.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "AUDIO_POOL";
+
+struct audio_pool {
+    const char *name;
+    audio_mem_tier_t tier;          /* 实际所在层级 */
+    size_t block_size;
+    size_t blocks;
+    uint8_t *slab;                  /* 所有块的数据区, 一次分配 */
+    audio_block_t *headers;         /* 块描述 (内部 RAM) */
+    QueueHandle_t free_q;           /* 空闲块指针 */
+    uint32_t high_water;
+    uint32_t exhausted;
+    uint32_t allocs;
+};
+
+static struct audio_pool *s_pools[AUDIO_POOL_MAX_POOLS];
+
+/**
+ * @brief       创建缓冲池
+ */
+esp_err_t audio_pool_create(const char *name, audio_mem_tier_t tier, size_t block_size, size_t blocks,
+                            audio_pool_handle_t *out)
+{
+    int slot = -1;
+
+    if (!out || block_size == 0 || block_size > UINT16_MAX || blocks == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < AUDIO_POOL_MAX_POOLS; i++) {
+        if (!s_pools[i]) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    struct audio_pool *pool = calloc(1, sizeof(*pool));
+    if (!pool) {
+        return ESP_ERR_NO_MEM;
+    }
+    pool->name = name;
+    pool->block_size = (block_size + 3) & ~(size_t)3;     /* 块间 4 字节对齐 */
+    pool->blocks = blocks;
+    pool->slab = audio_mem_alloc(name, tier, pool->block_size * blocks);
+    pool->headers = calloc(blocks, sizeof(audio_block_t));
+    pool->free_q = xQueueCreate(blocks, sizeof(audio_block_t *));
+    if (!pool->slab || !pool->headers || !pool->free_q) {
+        ESP_LOGE(TAG, "%s: 分配 %u x %u 字节失败", name, (unsigned)blocks, (unsigned)block_size);
+        if (pool->free_q) {
+            vQueueDelete(pool->free_q);
+        }
+        free(pool->headers);
+        audio_mem_free(pool->slab);
+        free(pool);
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (size_t i = 0; i < blocks; i++) {
+        audio_block_t *blk = &pool->headers[i];
+        blk->pool = pool;
+        blk->data = pool->slab + i * pool->block_size;
+        xQueueSend(pool->free_q, &blk, 0);
+    }
+
+    pool->tier = (tier == AUDIO_MEM_DMA) ? tier : audio_mem_tier_of(pool->slab);
+    s_pools[slot] = pool;
+    *out = pool;
+    return ESP_OK;
+}
+
+/**
+ * @brief       分配一个块
+ */
+audio_block_t *audio_pool_alloc(audio_pool_handle_t pool, TickType_t timeout)
+{
+    audio_block_t *blk = NULL;
+
+    if (!pool) {
+        return NULL;
+    }
+    if (xQueueReceive(pool->free_q, &blk, timeout) != pdTRUE) {
+        pool->exhausted++;
+        return NULL;
+    }
+
+    blk->offset = 0;
+    blk->len = 0;
+    blk->refs = 1;
+    pool->allocs++;
+
+    uint32_t in_use = pool->blocks - uxQueueMessagesWaiting(pool->free_q);
+    if (in_use > pool->high_water) {
+        pool->high_water = in_use;
+    }
+    return blk;
+}
+
+/**
+ * @brief       增加引用
+ */
+void audio_block_ref(audio_block_t *blk)
+{
+    __atomic_fetch_add(&blk->refs, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief       释放引用
+ */
+void audio_block_unref(audio_block_t *blk)
+{
+    if (!blk) {
+        return;
+    }
+    if (__atomic_sub_fetch(&blk->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        xQueueSend(blk->pool->free_q, &blk, 0);
+    }
+}
+
+/**
+ * @brief       读取池统计
+ */
+void audio_pool_get_stats(audio_pool_handle_t pool, audio_pool_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (!pool) {
+        return;
+    }
+    stats->name = pool->name;
+    stats->tier = pool->tier;
+    stats->block_size = pool->block_size;
+    stats->blocks = pool->blocks;
+    stats->in_use = pool->blocks - uxQueueMessagesWaiting(pool->free_q);
+    stats->high_water = pool->high_water;
+    stats->exhausted = pool->exhausted;
+    stats->allocs = pool->allocs;
+}
+
+/**
+ * @brief       所有池的分配超时总次数
+ */
+uint32_t audio_pool_total_exhausted(void)
+{
+    uint32_t total = 0;
+    for (int i = 0; i < AUDIO_POOL_MAX_POOLS; i++) {
+        if (s_pools[i]) {
+            total += s_pools[i]->exhausted;
+        }
+    }
+    return total;
+}
+
+/**
+ * @brief       打印所有池的占用统计
+ */
+void audio_pool_log_stats(void)
+{
+    audio_pool_stats_t st;
+
+    for (int i = 0; i < AUDIO_POOL_MAX_POOLS; i++) {
+        if (!s_pools[i]) {
+            continue;
+        }
+        audio_pool_get_stats(s_pools[i], &st);
+        ESP_LOGI(TAG, "%-8s %-5s %5lu B x %2lu, 占用 %lu, 最高 %lu, 耗尽 %lu",
+                 st.name, audio_mem_tier_name(st.tier), (unsigned long)st.block_size, (unsigned long)st.blocks,
+                 (unsigned long)st.in_use, (unsigned long)st.high_water, (unsigned long)st.exhausted);
+    }
+}
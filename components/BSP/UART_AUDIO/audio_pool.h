@@ -0,0 +1,98 @@
+/**
+ ****************************************************************************************************
+ * @file        audio_pool.h
+ * @author      Audio Serial Transfer
+ * @version     V1.0
+ * @date        2026-10-17
+ * @brief       定长音频块缓冲池 - 引用计数, 按内存层级分配, 经队列在任务间传递指针
+ *
+ *              每个池一次性分配连续内存, 运行中不再 malloc/free, 不产生碎片;
+ *              空闲块保存在 FreeRTOS 队列中, 分配即出队, 引用归零即入队。
+ ****************************************************************************************************
+ */
+
+#ifndef __AUDIO_POOL_H__
+#define __AUDIO_POOL_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "audio_mem.h"
+
+#define AUDIO_POOL_MAX_POOLS    6       /* 可注册的池数量 (用于统计汇总) */
+
+typedef struct audio_pool *audio_pool_handle_t;
+
+/* 音频块: data[offset, offset + len) 为有效数据 */
+typedef struct {
+    audio_pool_handle_t pool;       /* 所属池 */
+    uint8_t *data;                  /* 数据区 (池的块大小) */
+    uint16_t offset;                /* 有效数据起始 */
+    uint16_t len;                   /* 有效数据长度 */
+    volatile uint32_t refs;         /* 引用计数 */
+} audio_block_t;
+
+/* 池统计 */
+typedef struct {
+    const char *name;               /* 池名称 */
+    audio_mem_tier_t tier;          /* 实际所在层级 (PSRAM 不可用时为 INTERNAL) */
+    uint32_t block_size;            /* 块大小 (字节) */
+    uint32_t blocks;                /* 块数 */
+    uint32_t in_use;                /* 当前占用块数 */
+    uint32_t high_water;            /* 最高占用块数 */
+    uint32_t exhausted;             /* 分配超时次数 (池耗尽) */
+    uint32_t allocs;                /* 成功分配次数 */
+} audio_pool_stats_t;
+
+/**
+ * @brief       创建缓冲池
+ * @param       name: 名称 (统计/日志用, 需长期有效)
+ * @param       tier: 内存层级 (数据区经 audio_mem 分配, 计入占用表)
+ * @param       block_size: 块大小 (字节, 最大 65535)
+ * @param       blocks: 块数
+ * @param       out: 返回的池句柄
+ * @retval      ESP_OK: 成功; ESP_ERR_INVALID_ARG: 参数错误; ESP_ERR_NO_MEM: 内存不足
+ */
+esp_err_t audio_pool_create(const char *name, audio_mem_tier_t tier, size_t block_size, size_t blocks,
+                            audio_pool_handle_t *out);
+
+/**
+ * @brief       分配一个块 (引用计数为 1, offset/len 清零)
+ * @param       pool: 池句柄
+ * @param       timeout: 池空时的最长等待
+ * @retval      块指针, 超时返回 NULL (计入 exhausted)
+ */
+audio_block_t *audio_pool_alloc(audio_pool_handle_t pool, TickType_t timeout);
+
+/**
+ * @brief       增加引用 (交给另一个消费者前调用)
+ * @param       blk: 块
+ */
+void audio_block_ref(audio_block_t *blk);
+
+/**
+ * @brief       释放引用, 归零时归还所属池
+ * @param       blk: 块 (NULL 时忽略)
+ */
+void audio_block_unref(audio_block_t *blk);
+
+/**
+ * @brief       读取池统计
+ * @param       pool: 池句柄
+ * @param       stats: 输出
+ */
+void audio_pool_get_stats(audio_pool_handle_t pool, audio_pool_stats_t *stats);
+
+/**
+ * @brief       所有池的分配超时总次数
+ * @retval      次数
+ */
+uint32_t audio_pool_total_exhausted(void);
+
+/**
+ * @brief       打印所有池的占用统计
+ */
+void audio_pool_log_stats(void);
+
+#endif /* __AUDIO_POOL_H__ */
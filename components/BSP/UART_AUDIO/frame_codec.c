@@ -0,0 +1,352 @@
+/**
+ ****************************************************************************************************
+ * @file        frame_codec.c
+ * @author      Audio Serial Transfer
+ * @version     V1.0
+ * @date        2026-10-17
+ * @brief       串口协议帧编解码 - 固件与 PC 工具共用 (纯 C, 不依赖 ESP-IDF)
+ ****************************************************************************************************
+ */
+
+#include "frame_codec.h"
+#include <string.h>
+
+/* 帧解析状态 */
+typedef enum {
+    PARSE_HEADER_0 = 0,
+    PARSE_HEADER_1,
+    PARSE_CMD,
+    PARSE_LEN_L,
+    PARSE_LEN_H,
+    PARSE_DATA,
+    PARSE_CHECKSUM,
+} parse_state_t;
+
+/**
+ * @brief       计算 XOR 校验和 (按 32 位字累加后折叠)
+ */
+uint8_t frame_checksum(uint8_t seed, const uint8_t *data, size_t len)
+{
+    uint32_t acc = 0;
+    size_t i = 0;
+
+    for (; i + 4 <= len; i += 4) {
+        uint32_t word;
+        memcpy(&word, data + i, 4);
+        acc ^= word;
+    }
+    acc ^= acc >> 16;
+    acc ^= acc >> 8;
+
+    uint8_t sum = seed ^ (uint8_t)acc;
+    for (; i < len; i++) {
+        sum ^= data[i];
+    }
+    return sum;
+}
+
+/**
+ * @brief       生成帧头
+ */
+size_t frame_encode_header(uint8_t *out, uint8_t cmd, uint16_t len)
+{
+    out[0] = FRAME_HEADER_0;
+    out[1] = FRAME_HEADER_1;
+    out[2] = cmd;
+    out[3] = len & 0xFF;
+    out[4] = (len >> 8) & 0xFF;
+    return FRAME_HEAD_SIZE;
+}
+
+/**
+ * @brief       计算整帧校验和
+ */
+uint8_t frame_encode_checksum(const uint8_t *header, const uint8_t *data, uint16_t len)
+{
+    uint8_t sum = frame_checksum(0, header + 2, FRAME_HEAD_SIZE - 2);
+    if (data && len > 0) {
+        sum = frame_checksum(sum, data, len);
+    }
+    return sum;
+}
+
+/**
+ * @brief       编码完整帧
+ */
+size_t frame_encode(uint8_t *out, size_t out_size, uint8_t cmd, const uint8_t *data, uint16_t len)
+{
+    size_t total = (size_t)FRAME_OVERHEAD + len;
+    if (!out || out_size < total) {
+        return 0;
+    }
+
+    frame_encode_header(out, cmd, len);
+    if (data && len > 0) {
+        memcpy(out + FRAME_HEAD_SIZE, data, len);
+    }
+    out[FRAME_HEAD_SIZE + len] = frame_encode_checksum(out, data, len);
+
+    return total;
+}
+
+/**
+ * @brief       获取解码器结构体大小
+ */
+size_t frame_decoder_size(void)
+{
+    return sizeof(frame_decoder_t);
+}
+
+/**
+ * @brief       初始化解码器
+ */
+void frame_decoder_init(frame_decoder_t *dec, uint8_t *buf, uint16_t buf_size)
+{
+    memset(dec, 0, sizeof(*dec));
+    dec->buf = buf;
+    dec->buf_size = buf_size;
+    dec->state = PARSE_HEADER_0;
+}
+
+/**
+ * @brief       复位解析状态
+ */
+void frame_decoder_reset(frame_decoder_t *dec)
+{
+    dec->state = PARSE_HEADER_0;
+    dec->idx = 0;
+    dec->len = 0;
+    dec->replay_pos = 0;
+    dec->replay_len = 0;
+}
+
+/**
+ * @brief       查询解码器是否空闲
+ */
+int frame_decoder_idle(const frame_decoder_t *dec)
+{
+    return dec->state == PARSE_HEADER_0 && dec->replay_pos >= dec->replay_len;
+}
+
+/**
+ * @brief       快速路径: 帧头起始的整帧都在输入内时直接校验, 不复制数据
+ * @param       p: 指向 FRAME_HEADER_0
+ * @param       avail: p 之后 (含 p) 的可用字节数
+ * @retval      整帧长度, 0 表示不满足快速路径条件
+ */
+static size_t decode_inplace(frame_decoder_t *dec, const uint8_t *p, size_t avail,
+                             frame_decode_status_t *status, frame_view_t *frame)
+{
+    if (avail < FRAME_OVERHEAD || p[1] != FRAME_HEADER_1) {
+        return 0;
+    }
+
+    uint16_t len = p[3] | (p[4] << 8);
+    if (len > dec->buf_size || avail < (size_t)FRAME_OVERHEAD + len) {
+        return 0;
+    }
+
+    uint8_t sum = frame_checksum(0, p + 2, FRAME_HEAD_SIZE - 2 + len);
+    dec->rx_checksum = p[FRAME_HEAD_SIZE + len];
+    dec->checksum = sum;
+
+    if (sum == dec->rx_checksum) {
+        frame->cmd = p[2];
+        frame->len = len;
+        frame->data = p + FRAME_HEAD_SIZE;
+        dec->stats.frames++;
+        *status = FRAME_DECODE_OK;
+        return (size_t)FRAME_OVERHEAD + len;
+    }
+
+    /* 帧头可能是数据中的巧合或已损坏, 只丢弃第一字节, 从下一字节起重新搜索 */
+    dec->stats.checksum_errors++;
+    *status = FRAME_DECODE_BAD_CHECKSUM;
+    return 1;
+}
+
+/**
+ * @brief       解析 data[*pos..len), 遇到完整帧或错误即返回
+ * @param       rescan: 跨块的帧出错时置位, 由调用者重新解析该帧帧头之后的字节
+ */
+static frame_decode_status_t decode(frame_decoder_t *dec, const uint8_t *data, size_t len,
+                                    size_t *pos_io, frame_view_t *frame, int *rescan)
+{
+    frame_decode_status_t status = FRAME_DECODE_NEED_MORE;
+    size_t pos = *pos_io;
+
+    while (pos < len && status == FRAME_DECODE_NEED_MORE) {
+        switch (dec->state) {
+            case PARSE_HEADER_0: {
+                /* 直接跳到下一个帧头字节 */
+                const uint8_t *p = memchr(data + pos, FRAME_HEADER_0, len - pos);
+                if (!p) {
+                    pos = len;
+                    break;
+                }
+                pos = (size_t)(p - data);
+
+                size_t frame_len = decode_inplace(dec, p, len - pos, &status, frame);
+                if (frame_len > 0) {
+                    pos += frame_len;
+                } else {
+                    pos++;
+                    dec->state = PARSE_HEADER_1;
+                }
+                break;
+            }
+
+            case PARSE_HEADER_1: {
+                uint8_t byte = data[pos++];
+                if (byte == FRAME_HEADER_1) {
+                    dec->state = PARSE_CMD;
+                } else if (byte != FRAME_HEADER_0) {
+                    dec->state = PARSE_HEADER_0;
+                }
+                break;
+            }
+
+            case PARSE_CMD:
+                dec->cmd = data[pos++];
+                dec->checksum = dec->cmd;
+                dec->state = PARSE_LEN_L;
+                break;
+
+            case PARSE_LEN_L:
+                dec->len = data[pos];
+                dec->checksum ^= data[pos++];
+                dec->state = PARSE_LEN_H;
+                break;
+
+            case PARSE_LEN_H:
+                dec->len |= (uint16_t)(data[pos] << 8);
+                dec->checksum ^= data[pos++];
+                dec->idx = 0;
+                if (dec->len > dec->buf_size) {
+                    dec->stats.length_errors++;
+                    dec->state = PARSE_HEADER_0;
+                    status = FRAME_DECODE_BAD_LENGTH;
+                    *rescan = 1;
+                } else {
+                    dec->state = (dec->len > 0) ? PARSE_DATA : PARSE_CHECKSUM;
+                }
+                break;
+
+            case PARSE_DATA: {
+                size_t n = dec->len - dec->idx;
+                if (n > len - pos) {
+                    n = len - pos;
+                }
+                /* 重新解析时输入就在 buf 中 (总在写入位置之后), 先算校验再移动 */
+                dec->checksum = frame_checksum(dec->checksum, data + pos, n);
+                memmove(dec->buf + dec->idx, data + pos, n);
+                dec->idx += (uint16_t)n;
+                pos += n;
+                if (dec->idx >= dec->len) {
+                    dec->state = PARSE_CHECKSUM;
+                }
+                break;
+            }
+
+            case PARSE_CHECKSUM:
+                dec->rx_checksum = data[pos];
+                dec->state = PARSE_HEADER_0;
+                if (dec->rx_checksum == dec->checksum) {
+                    pos++;
+                    frame->cmd = dec->cmd;
+                    frame->len = dec->len;
+                    frame->data = dec->buf;
+                    dec->stats.frames++;
+                    status = FRAME_DECODE_OK;
+                } else {
+                    /* 校验字节不消耗: 它可能是下一帧的帧头 */
+                    dec->stats.checksum_errors++;
+                    status = FRAME_DECODE_BAD_CHECKSUM;
+                    *rescan = 1;
+                }
+                break;
+
+            default:
+                dec->state = PARSE_HEADER_0;
+                break;
+        }
+    }
+
+    *pos_io = pos;
+    return status;
+}
+
+/**
+ * @brief       跨块的帧出错后重新解析其帧头 0xAA 之后的字节 (0x55 不可能是帧头, 从命令字节开始)
+ * @note        只有 3 字节, 到不了数据段, 只推进解析状态
+ */
+static void rescan_head(frame_decoder_t *dec, uint8_t cmd, uint16_t len)
+{
+    uint8_t head[3] = {cmd, len & 0xFF, len >> 8};
+    frame_view_t unused;
+    size_t pos = 0;
+    int rescan = 0;
+
+    dec->state = PARSE_HEADER_0;
+    decode(dec, head, sizeof(head), &pos, &unused, &rescan);
+}
+
+/**
+ * @brief       喂入数据, 遇到完整帧或错误即返回
+ */
+frame_decode_status_t frame_decoder_feed(frame_decoder_t *dec, const uint8_t *data, size_t len,
+                                         size_t *consumed, frame_view_t *frame)
+{
+    frame_decode_status_t status;
+    size_t pos = 0;
+    int rescan = 0;
+
+    if (consumed) {
+        *consumed = 0;
+    }
+
+    /* 先解析出错帧留下的数据, 完成前不读新输入 */
+    if (dec->replay_pos < dec->replay_len) {
+        size_t rpos = dec->replay_pos;
+        status = decode(dec, dec->buf, dec->replay_len, &rpos, frame, &rescan);
+        dec->replay_pos = (uint16_t)rpos;
+        if (rescan && status == FRAME_DECODE_BAD_CHECKSUM) {
+            /* 出错帧的数据已移到 buf 开头, 未解析的部分 (从校验字节起) 接在其后, 一起重新解析 */
+            uint16_t data_len = dec->len;
+            size_t rest = dec->replay_len - rpos;
+            memmove(dec->buf + data_len, dec->buf + rpos, rest);
+            rescan_head(dec, dec->cmd, data_len);
+            dec->replay_pos = 0;
+            dec->replay_len = (uint16_t)(data_len + rest);
+        } else if (rescan) {
+            rescan_head(dec, dec->cmd, dec->len);
+        }
+        if (status != FRAME_DECODE_NEED_MORE) {
+            return status;
+        }
+        rescan = 0;
+    }
+
+    status = decode(dec, data, len, &pos, frame, &rescan);
+    if (rescan) {
+        uint16_t data_len = dec->len;
+        rescan_head(dec, dec->cmd, data_len);
+        if (status == FRAME_DECODE_BAD_CHECKSUM) {
+            dec->replay_pos = 0;
+            dec->replay_len = data_len;
+        }
+    }
+
+    if (consumed) {
+        *consumed = pos;
+    }
+    return status;
+}
+
+/**
+ * @brief       获取解码统计
+ */
+const frame_decoder_stats_t *frame_decoder_get_stats(const frame_decoder_t *dec)
+{
+    return &dec->stats;
+}
@@ -0,0 +1,161 @@
+/**
+ ****************************************************************************************************
+ * @file        frame_codec.h
+ * @author      Audio Serial Transfer
+ * @version     V1.0
+ * @date        2026-10-17
+ * @brief       串口协议帧编解码 - 固件与 PC 工具共用 (纯 C, 不依赖 ESP-IDF)
+ *
+ *              帧格式: 0xAA 0x55 | CMD(1B) | LEN(2B, 小端) | DATA(LEN B) | XOR(1B)
+ *              XOR 校验覆盖 CMD、LEN 和 DATA
+ *
+ *              PC 端编译共享库:
+ *              cc -O2 -shared -fPIC frame_codec.c -o ../../../tools/libframe_codec.so
+ ****************************************************************************************************
+ */
+
+#ifndef __FRAME_CODEC_H__
+#define __FRAME_CODEC_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 帧格式定义 */
+#define FRAME_HEADER_0          0xAA            /* 帧头第一字节 */
+#define FRAME_HEADER_1          0x55            /* 帧头第二字节 */
+#define FRAME_HEAD_SIZE         5               /* 帧头2 + 命令1 + 长度2 */
+#define FRAME_OVERHEAD          6               /* 帧头 + 校验1 */
+
+/* 解码结果 */
+typedef enum {
+    FRAME_DECODE_NEED_MORE = 0,     /* 输入已全部消耗, 尚无完整帧 */
+    FRAME_DECODE_OK,                /* 得到一个完整帧 */
+    FRAME_DECODE_BAD_CHECKSUM,      /* 校验错误, 只丢弃帧头第一字节, 其后的字节重新搜索帧头 */
+    FRAME_DECODE_BAD_LENGTH,        /* 长度超出缓冲区, 只丢弃帧头第一字节 */
+} frame_decode_status_t;
+
+/* 解码得到的帧 (data 指向解码器缓冲区或调用者输入, 下次 feed 前有效) */
+typedef struct {
+    uint8_t cmd;                    /* 命令 */
+    uint16_t len;                   /* 数据长度 */
+    const uint8_t *data;            /* 数据 */
+} frame_view_t;
+
+/* 解码统计 */
+typedef struct {
+    uint32_t frames;                /* 正确帧数 */
+    uint32_t checksum_errors;       /* 校验错误数 */
+    uint32_t length_errors;         /* 长度错误数 */
+} frame_decoder_stats_t;
+
+/* 增量解码器 (由调用者分配, 不使用堆) */
+typedef struct {
+    uint8_t state;                  /* 解析状态 */
+    uint8_t cmd;                    /* 当前帧命令 */
+    uint16_t len;                   /* 当前帧长度 */
+    uint16_t idx;                   /* 已接收数据长度 */
+    uint8_t checksum;               /* 当前计算的校验和 */
+    uint8_t rx_checksum;            /* 最近一次收到的校验和 (用于日志) */
+    uint8_t *buf;                   /* 跨 feed 拼帧的数据缓冲区 */
+    uint16_t buf_size;              /* 缓冲区大小, 即允许的最大数据长度 */
+    uint16_t replay_pos;            /* 校验失败的跨块帧数据留在 buf 中重新解析: 下一个待解析字节 */
+    uint16_t replay_len;            /* 待重新解析的字节数, 解析完之前不读新输入 */
+    frame_decoder_stats_t stats;    /* 统计 */
+} frame_decoder_t;
+
+/**
+ * @brief       计算 XOR 校验和
+ * @param       seed: 初始值 (用于分段累加)
+ * @param       data: 数据
+ * @param       len: 数据长度
+ * @retval      校验和
+ */
+uint8_t frame_checksum(uint8_t seed, const uint8_t *data, size_t len);
+
+/**
+ * @brief       生成帧头
+ * @param       out: 输出缓冲区 (至少 FRAME_HEAD_SIZE 字节)
+ * @param       cmd: 命令
+ * @param       len: 数据长度
+ * @retval      帧头字节数 (FRAME_HEAD_SIZE)
+ */
+size_t frame_encode_header(uint8_t *out, uint8_t cmd, uint16_t len);
+
+/**
+ * @brief       计算整帧校验和
+ * @param       header: frame_encode_header 生成的帧头
+ * @param       data: 数据 (可为 NULL)
+ * @param       len: 数据长度
+ * @retval      校验和
+ */
+uint8_t frame_encode_checksum(const uint8_t *header, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief       编码完整帧
+ * @param       out: 输出缓冲区
+ * @param       out_size: 输出缓冲区大小
+ * @param       cmd: 命令
+ * @param       data: 数据 (可为 NULL)
+ * @param       len: 数据长度
+ * @retval      帧长度, 0 表示缓冲区不足
+ */
+size_t frame_encode(uint8_t *out, size_t out_size, uint8_t cmd, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief       获取解码器结构体大小 (供 PC 端绑定分配内存)
+ * @retval      sizeof(frame_decoder_t)
+ */
+size_t frame_decoder_size(void);
+
+/**
+ * @brief       初始化解码器
+ * @param       dec: 解码器
+ * @param       buf: 数据缓冲区
+ * @param       buf_size: 缓冲区大小 (最大数据长度)
+ */
+void frame_decoder_init(frame_decoder_t *dec, uint8_t *buf, uint16_t buf_size);
+
+/**
+ * @brief       复位解析状态 (保留统计)
+ * @param       dec: 解码器
+ */
+void frame_decoder_reset(frame_decoder_t *dec);
+
+/**
+ * @brief       查询解码器是否空闲 (没有拼到一半的帧和待重新解析的数据)
+ * @note        返回 FRAME_DECODE_OK 后空闲时调用者可以取走 buf 并换新缓冲区
+ * @param       dec: 解码器
+ * @retval      非 0 表示空闲
+ */
+int frame_decoder_idle(const frame_decoder_t *dec);
+
+/**
+ * @brief       喂入数据, 遇到完整帧或错误即返回
+ * @note        整帧位于本次输入内时 frame->data 直接指向输入, 不复制数据;
+ *              有待重新解析的数据时先解析它, 此时可能返回结果但不消耗输入 (consumed 为 0)
+ * @param       dec: 解码器
+ * @param       data: 输入数据
+ * @param       len: 输入长度
+ * @param       consumed: 输出本次消耗的字节数
+ * @param       frame: 输出帧 (返回 FRAME_DECODE_OK 时有效)
+ * @retval      解码结果
+ */
+frame_decode_status_t frame_decoder_feed(frame_decoder_t *dec, const uint8_t *data, size_t len,
+                                         size_t *consumed, frame_view_t *frame);
+
+/**
+ * @brief       获取解码统计
+ * @param       dec: 解码器
+ * @retval      统计信息
+ */
+const frame_decoder_stats_t *frame_decoder_get_stats(const frame_decoder_t *dec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FRAME_CODEC_H__ */
@@ -12,42 +12,46 @@
 #include "esp_audio_dec.h"
 #include "esp_audio_dec_reg.h"
 #include "esp_audio_dec_default.h"
+#include "audio_mem.h"
 #include "esp_log.h"
-#include "esp_heap_caps.h"
+#include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "MP3_DEC";
 
-/* 内部输出缓冲区大小 - 必须足够大以容纳一个完整的解码帧 */
-/* MP3 帧: 1152 samples * 2 channels * 2 bytes = 4608 bytes, 再留一些余量 */
+/* 内部输出缓冲区大小 - 必须足够大以容纳一个完整的解码帧, 创建后不再扩容 */
+/* MP3 帧: 1152 samples * 2 channels * 2 bytes = 4608 bytes; HE-AAC 帧: 2048 * 2 * 2 = 8192 bytes */
 #define MP3_DECODE_OUTPUT_SIZE      8192
 
-/* 解码器句柄 */
-static esp_audio_dec_handle_t s_decoder = NULL;
+/* 解码器上下文: 每个压缩流独立, 互不共享状态 */
+struct mp3_decoder {
+    esp_audio_dec_handle_t handle;  /* esp_audio_dec 句柄 */
+    mp3_decoder_codec_t codec;      /* 压缩格式 */
+    
+    /* 输入缓冲区 */
+    uint8_t *input_buf;
+    size_t input_size;
+    size_t input_len;
+    size_t input_pos;
+    
+    /* 内部输出缓冲区 */
+    uint8_t *output_buf;
+    size_t output_size;
+    
+    /* ID3 标签跳过状态 */
+    bool id3_checked;
+    size_t id3_skip_bytes;
+    bool sync_found;
+    
+    /* 错误恢复计数器 */
+    int error_count;
+    uint32_t decode_calls;          /* 调试日志节流 */
+    
+    mp3_decoder_stats_t stats;      /* 统计, 含缓存的采样率/声道 */
+};
 
-/* 输入缓冲区 */
-static uint8_t *s_input_buf = NULL;
-static size_t s_input_buf_len = 0;
-static size_t s_input_buf_pos = 0;
-
-/* 内部输出缓冲区 */
-static uint8_t *s_output_buf = NULL;
-static size_t s_output_buf_size = MP3_DECODE_OUTPUT_SIZE;
-
-/* 解码器是否已初始化 */
-static bool s_initialized = false;
-
-/* ID3 标签跳过状态 */
-static bool s_id3_checked = false;
-static size_t s_id3_skip_bytes = 0;
-static bool s_sync_found = false;
-
-/* 错误恢复计数器 */
-static int s_error_count = 0;
-
-/* 缓存的音频信息 */
-static int s_sample_rate = 44100;
-static int s_channels = 2;
+/* 默认解码器只需注册一次, 所有上下文共用 */
+static bool s_registered = false;
 
 /**
  * @brief       检查并跳过 ID3v2 标签
@@ -85,115 +89,112 @@ static int find_mp3_sync(const uint8_t *data, size_t len)
 }
 
 /**
- * @brief       初始化 MP3 解码器
+ * @brief       清空流状态 (输入缓冲、ID3/同步检测、错误计数和统计)
+ */
+static void stream_reset(struct mp3_decoder *dec)
+{
+    dec->input_len = 0;
+    dec->input_pos = 0;
+    dec->id3_checked = false;
+    dec->id3_skip_bytes = 0;
+    dec->sync_found = false;
+    dec->error_count = 0;
+    dec->decode_calls = 0;
+    memset(&dec->stats, 0, sizeof(dec->stats));
+}
+
+/**
+ * @brief       创建解码器
  */
-esp_err_t mp3_decoder_init(void)
+esp_err_t mp3_decoder_create(const mp3_decoder_config_t *config, mp3_decoder_handle_t *out)
 {
-    if (s_initialized) {
-        ESP_LOGW(TAG, "解码器已初始化");
-        return ESP_OK;
+    mp3_decoder_config_t def = MP3_DECODER_DEFAULT_CONFIG();
+    
+    if (!out) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!config) {
+        config = &def;
+    }
+    if (config->codec != MP3_DECODER_CODEC_MP3 && config->codec != MP3_DECODER_CODEC_AAC) {
+        return ESP_ERR_INVALID_ARG;
     }
     
     /* 注册默认解码器 */
-    esp_audio_err_t ret = esp_audio_dec_register_default();
-    if (ret != ESP_AUDIO_ERR_OK) {
-        ESP_LOGW(TAG, "注册默认解码器返回: %d", ret);
+    if (!s_registered) {
+        esp_audio_err_t reg = esp_audio_dec_register_default();
+        if (reg != ESP_AUDIO_ERR_OK) {
+            ESP_LOGW(TAG, "注册默认解码器返回: %d", reg);
+        }
+        s_registered = true;
     }
     
-    /* 分配输入缓冲区 */
-    s_input_buf = heap_caps_malloc(MP3_INPUT_BUFFER_SIZE, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    if (!s_input_buf) {
-        s_input_buf = heap_caps_malloc(MP3_INPUT_BUFFER_SIZE, MALLOC_CAP_8BIT);
-    }
-    if (!s_input_buf) {
-        ESP_LOGE(TAG, "输入缓冲区分配失败");
+    struct mp3_decoder *dec = calloc(1, sizeof(*dec));
+    if (!dec) {
         return ESP_ERR_NO_MEM;
     }
-    
-    /* 分配内部输出缓冲区 */
-    s_output_buf = heap_caps_malloc(s_output_buf_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    if (!s_output_buf) {
-        s_output_buf = heap_caps_malloc(s_output_buf_size, MALLOC_CAP_8BIT);
-    }
-    if (!s_output_buf) {
-        ESP_LOGE(TAG, "输出缓冲区分配失败");
-        free(s_input_buf);
-        s_input_buf = NULL;
+    dec->codec = config->codec;
+    dec->input_size = config->input_size ? config->input_size : audio_mem_get_plan()->mp3_input_size;
+    dec->output_size = MP3_DECODE_OUTPUT_SIZE;
+    
+    /* 分配输入缓冲区和内部输出缓冲区 */
+    dec->input_buf = audio_mem_alloc("mp3_in", AUDIO_MEM_PSRAM, dec->input_size);
+    dec->output_buf = audio_mem_alloc("mp3_out", AUDIO_MEM_PSRAM, dec->output_size);
+    if (!dec->input_buf || !dec->output_buf) {
+        ESP_LOGE(TAG, "解码缓冲区分配失败");
+        mp3_decoder_destroy(dec);
         return ESP_ERR_NO_MEM;
     }
     
-    s_input_buf_len = 0;
-    s_input_buf_pos = 0;
-    
-    /* 打开 MP3 解码器 */
+    /* 打开解码器 */
     esp_audio_dec_cfg_t cfg = {
-        .type = ESP_AUDIO_TYPE_MP3,
+        .type = (dec->codec == MP3_DECODER_CODEC_AAC) ? ESP_AUDIO_TYPE_AAC : ESP_AUDIO_TYPE_MP3,
         .cfg = NULL,
         .cfg_sz = 0,
     };
     
-    ret = esp_audio_dec_open(&cfg, &s_decoder);
+    esp_audio_err_t ret = esp_audio_dec_open(&cfg, &dec->handle);
     if (ret != ESP_AUDIO_ERR_OK) {
-        ESP_LOGE(TAG, "打开 MP3 解码器失败: %d", ret);
-        free(s_input_buf);
-        free(s_output_buf);
-        s_input_buf = NULL;
-        s_output_buf = NULL;
+        ESP_LOGE(TAG, "打开解码器失败: %d", ret);
+        dec->handle = NULL;
+        mp3_decoder_destroy(dec);
         return ESP_FAIL;
     }
     
-    s_id3_checked = false;
-    s_id3_skip_bytes = 0;
-    s_sync_found = false;
-    s_error_count = 0;
-    
-    s_initialized = true;
-    ESP_LOGI(TAG, "MP3 解码器初始化完成 (输出缓冲区: %d 字节)", (int)s_output_buf_size);
+    stream_reset(dec);
+    *out = dec;
+    ESP_LOGI(TAG, "%s 解码器创建完成 (输入缓冲区: %d 字节, 输出缓冲区: %d 字节)",
+             dec->codec == MP3_DECODER_CODEC_AAC ? "AAC" : "MP3",
+             (int)dec->input_size, (int)dec->output_size);
     
     return ESP_OK;
 }
 
 /**
- * @brief       反初始化 MP3 解码器
+ * @brief       释放解码器
  */
-void mp3_decoder_deinit(void)
+void mp3_decoder_destroy(mp3_decoder_handle_t dec)
 {
-    if (!s_initialized) {
+    if (!dec) {
         return;
     }
     
-    if (s_decoder) {
-        esp_audio_dec_close(s_decoder);
-        s_decoder = NULL;
-    }
-    
-    if (s_input_buf) {
-        free(s_input_buf);
-        s_input_buf = NULL;
-    }
-    
-    if (s_output_buf) {
-        free(s_output_buf);
-        s_output_buf = NULL;
+    if (dec->handle) {
+        esp_audio_dec_close(dec->handle);
     }
+    audio_mem_free(dec->input_buf);
+    audio_mem_free(dec->output_buf);
+    free(dec);
     
-    s_input_buf_len = 0;
-    s_input_buf_pos = 0;
-    s_id3_checked = false;
-    s_id3_skip_bytes = 0;
-    s_sync_found = false;
-    s_error_count = 0;
-    s_initialized = false;
-    
-    ESP_LOGI(TAG, "MP3 解码器已释放");
+    ESP_LOGI(TAG, "解码器已释放");
 }
 
 /**
- * @brief       喂入 MP3 数据到解码器
+ * @brief       喂入压缩数据到解码器
  */
-int mp3_decoder_feed(const uint8_t *data, size_t len)
+int mp3_decoder_feed(mp3_decoder_handle_t dec, const uint8_t *data, size_t len)
 {
-    if (!s_initialized || !data || len == 0) {
+    if (!dec || !data || len == 0) {
         return 0;
     }
     
@@ -201,17 +202,18 @@ int mp3_decoder_feed(const uint8_t *data, size_t len)
     size_t src_len = len;
     
     /* 首次接收数据时检查 ID3 标签 */
-    if (!s_id3_checked && s_input_buf_len == 0) {
-        s_id3_skip_bytes = check_id3v2_tag(src, src_len);
-        s_id3_checked = true;
+    if (!dec->id3_checked && dec->input_len == 0) {
+        dec->id3_skip_bytes = check_id3v2_tag(src, src_len);
+        dec->stats.id3_bytes = dec->id3_skip_bytes;
+        dec->id3_checked = true;
     }
     
     /* 跳过 ID3 标签数据 */
-    if (s_id3_skip_bytes > 0) {
-        size_t skip = (src_len < s_id3_skip_bytes) ? src_len : s_id3_skip_bytes;
+    if (dec->id3_skip_bytes > 0) {
+        size_t skip = (src_len < dec->id3_skip_bytes) ? src_len : dec->id3_skip_bytes;
         src += skip;
         src_len -= skip;
-        s_id3_skip_bytes -= skip;
+        dec->id3_skip_bytes -= skip;
         
         if (src_len == 0) {
             return (int)len;
@@ -219,37 +221,35 @@ int mp3_decoder_feed(const uint8_t *data, size_t len)
     }
     
     /* 移动已消耗的数据 */
-    if (s_input_buf_pos > 0) {
-        size_t remaining = s_input_buf_len - s_input_buf_pos;
+    if (dec->input_pos > 0) {
+        size_t remaining = dec->input_len - dec->input_pos;
         if (remaining > 0) {
-            memmove(s_input_buf, s_input_buf + s_input_buf_pos, remaining);
+            memmove(dec->input_buf, dec->input_buf + dec->input_pos, remaining);
         }
-        s_input_buf_len = remaining;
-        s_input_buf_pos = 0;
+        dec->input_len = remaining;
+        dec->input_pos = 0;
     }
     
     /* 计算可接收的数据量 */
-    size_t space = MP3_INPUT_BUFFER_SIZE - s_input_buf_len;
+    size_t space = dec->input_size - dec->input_len;
     size_t to_copy = (src_len < space) ? src_len : space;
     
     if (to_copy > 0) {
-        memcpy(s_input_buf + s_input_buf_len, src, to_copy);
-        s_input_buf_len += to_copy;
+        memcpy(dec->input_buf + dec->input_len, src, to_copy);
+        dec->input_len += to_copy;
+        dec->stats.input_bytes += to_copy;
         
-        /* 如果是首批有效数据，尝试查找 MP3 同步字 */
-        if (!s_sync_found && s_input_buf_len >= 4) {
-            ESP_LOGI(TAG, "缓冲区前8字节: %02X %02X %02X %02X %02X %02X %02X %02X",
-                     s_input_buf[0], s_input_buf[1], s_input_buf[2], s_input_buf[3],
-                     s_input_buf[4], s_input_buf[5], s_input_buf[6], s_input_buf[7]);
-            
-            int sync_pos = find_mp3_sync(s_input_buf, s_input_buf_len);
+        /* 如果是首批有效数据，尝试查找同步字 */
+        if (!dec->sync_found && dec->input_len >= 4) {
+            int sync_pos = find_mp3_sync(dec->input_buf, dec->input_len);
             if (sync_pos > 0) {
-                ESP_LOGI(TAG, "找到 MP3 同步字位置: %d", sync_pos);
-                memmove(s_input_buf, s_input_buf + sync_pos, s_input_buf_len - sync_pos);
-                s_input_buf_len -= sync_pos;
+                ESP_LOGI(TAG, "找到同步字位置: %d", sync_pos);
+                memmove(dec->input_buf, dec->input_buf + sync_pos, dec->input_len - sync_pos);
+                dec->input_len -= sync_pos;
+                dec->stats.skipped_bytes += sync_pos;
             }
             if (sync_pos >= 0) {
-                s_sync_found = true;
+                dec->sync_found = true;
             }
         }
     }
@@ -260,98 +260,85 @@ int mp3_decoder_feed(const uint8_t *data, size_t len)
 /**
  * @brief       从解码器获取 PCM 数据
  */
-int mp3_decoder_get_pcm(int16_t *pcm_out, size_t max_samples, 
+int mp3_decoder_get_pcm(mp3_decoder_handle_t dec, int16_t *pcm_out, size_t max_samples,
                         int *sample_rate, int *channels)
 {
-    if (!s_initialized || !s_decoder || !pcm_out || !s_output_buf) {
+    if (!dec || !dec->handle || !pcm_out) {
         return 0;
     }
     
     /* 检查是否有足够数据 */
-    size_t available = s_input_buf_len - s_input_buf_pos;
+    size_t available = dec->input_len - dec->input_pos;
     if (available < 128) {
         return 0;
     }
     
     /* 准备解码输入 */
     esp_audio_dec_in_raw_t raw_in = {
-        .buffer = s_input_buf + s_input_buf_pos,
+        .buffer = dec->input_buf + dec->input_pos,
         .len = available,
     };
     
     /* 使用内部大缓冲区作为输出 */
     esp_audio_dec_out_frame_t frame_out = {
-        .buffer = s_output_buf,
-        .len = s_output_buf_size,
+        .buffer = dec->output_buf,
+        .len = dec->output_size,
         .decoded_size = 0,  /* 重要：初始化为0，避免残留值 */
     };
     
     /* 解码 */
-    esp_audio_err_t ret = esp_audio_dec_process(s_decoder, &raw_in, &frame_out);
+    esp_audio_err_t ret = esp_audio_dec_process(dec->handle, &raw_in, &frame_out);
     
     /* 调试：每10次打印一次 */
-    static uint32_t decode_call_count = 0;
-    decode_call_count++;
-    if (decode_call_count % 10 == 1) {
-        ESP_LOGI(TAG, "解码 #%lu: ret=%d, consumed=%lu, decoded=%lu, pos=%lu, len=%lu", 
-                 decode_call_count, ret, (unsigned long)raw_in.consumed, 
+    dec->decode_calls++;
+    if (dec->decode_calls % 10 == 1) {
+        ESP_LOGD(TAG, "解码 #%lu: ret=%d, consumed=%lu, decoded=%lu, pos=%lu, len=%lu", 
+                 (unsigned long)dec->decode_calls, ret, (unsigned long)raw_in.consumed, 
                  (unsigned long)frame_out.decoded_size,
-                 (unsigned long)s_input_buf_pos, (unsigned long)s_input_buf_len);
+                 (unsigned long)dec->input_pos, (unsigned long)dec->input_len);
     }
     
-    /* 处理 BUFF_NOT_ENOUGH - 尝试扩大缓冲区 */
-    if (ret == ESP_AUDIO_ERR_BUFF_NOT_ENOUGH && frame_out.needed_size > s_output_buf_size) {
-        ESP_LOGI(TAG, "输出缓冲区不足, 需要 %lu 字节", (unsigned long)frame_out.needed_size);
-        
-        /* 重新分配更大的缓冲区 */
-        uint8_t *new_buf = heap_caps_realloc(s_output_buf, frame_out.needed_size, MALLOC_CAP_8BIT);
-        if (new_buf) {
-            s_output_buf = new_buf;
-            s_output_buf_size = frame_out.needed_size;
-            
-            /* 重新初始化输入输出结构体后重试 */
-            raw_in.buffer = s_input_buf + s_input_buf_pos;
-            raw_in.len = available;
-            raw_in.consumed = 0;
-            
-            frame_out.buffer = s_output_buf;
-            frame_out.len = s_output_buf_size;
-            frame_out.decoded_size = 0;
-            
-            ret = esp_audio_dec_process(s_decoder, &raw_in, &frame_out);
-            ESP_LOGI(TAG, "重试解码: ret=%d, consumed=%lu, decoded=%lu", 
-                     ret, (unsigned long)raw_in.consumed, (unsigned long)frame_out.decoded_size);
-        }
+    /* 输出缓冲在创建时按最大帧一次分配, 解码中不再扩容 (流路径零分配);
+     * 仍不够时按坏帧处理, 直接进入重新同步 */
+    if (ret == ESP_AUDIO_ERR_BUFF_NOT_ENOUGH && frame_out.needed_size > dec->output_size) {
+        ESP_LOGW(TAG, "帧输出需要 %lu 字节, 超过缓冲区 %lu, 跳过", 
+                 (unsigned long)frame_out.needed_size, (unsigned long)dec->output_size);
+        ret = ESP_AUDIO_ERR_FAIL;
+        dec->error_count = 5;
     }
     
     /* 更新消耗位置 */
     if (raw_in.consumed > 0) {
-        s_input_buf_pos += raw_in.consumed;
-        s_error_count = 0;  /* 成功时重置错误计数 */
+        dec->input_pos += raw_in.consumed;
+        dec->error_count = 0;  /* 成功时重置错误计数 */
     }
     
     /* 错误恢复：当解码持续失败时，尝试重新同步 */
     if (ret != ESP_AUDIO_ERR_OK && ret != ESP_AUDIO_ERR_BUFF_NOT_ENOUGH) {
-        s_error_count++;
+        dec->error_count++;
+        dec->stats.errors++;
         
         /* 连续错误超过阈值，尝试跳过数据找下一个同步字 */
-        if (s_error_count > 5 && available > 4) {
+        if (dec->error_count > 5 && available > 4) {
             /* 跳过第一个字节，在剩余数据中查找同步字 */
-            int sync_pos = find_mp3_sync(s_input_buf + s_input_buf_pos + 1, available - 1);
+            int sync_pos = find_mp3_sync(dec->input_buf + dec->input_pos + 1, available - 1);
             if (sync_pos >= 0) {
                 int skip_bytes = sync_pos + 1;
                 ESP_LOGW(TAG, "错误恢复: 跳过 %d 字节, 重新同步", skip_bytes);
-                s_input_buf_pos += skip_bytes;
-                s_error_count = 0;
+                dec->input_pos += skip_bytes;
+                dec->error_count = 0;
+                dec->stats.resyncs++;
+                dec->stats.skipped_bytes += skip_bytes;
                 
                 /* 重置解码器状态 */
-                esp_audio_dec_reset(s_decoder);
+                esp_audio_dec_reset(dec->handle);
             } else {
                 /* 找不到同步字，跳过大块数据 */
                 int skip = available > 512 ? 512 : available / 2;
                 if (skip > 0) {
                     ESP_LOGW(TAG, "未找到同步字, 跳过 %d 字节", skip);
-                    s_input_buf_pos += skip;
+                    dec->input_pos += skip;
+                    dec->stats.skipped_bytes += skip;
                 }
             }
         }
@@ -361,31 +348,33 @@ int mp3_decoder_get_pcm(int16_t *pcm_out, size_t max_samples,
     /* 获取音频信息并复制到输出 */
     if (frame_out.decoded_size > 0) {
         esp_audio_dec_info_t info;
-        if (esp_audio_dec_get_info(s_decoder, &info) == ESP_AUDIO_ERR_OK) {
+        if (esp_audio_dec_get_info(dec->handle, &info) == ESP_AUDIO_ERR_OK) {
             if (info.sample_rate > 0) {
-                s_sample_rate = info.sample_rate;
+                dec->stats.sample_rate = info.sample_rate;
             }
             if (info.channel > 0) {
-                s_channels = info.channel;
+                dec->stats.channels = info.channel;
             }
         }
         
-        if (sample_rate) *sample_rate = s_sample_rate;
-        if (channels) *channels = s_channels;
-        
         /* 计算输出采样数 */
-        int ch = s_channels > 0 ? s_channels : 2;
+        int ch = dec->stats.channels > 0 ? dec->stats.channels : 2;
+        int rate = dec->stats.sample_rate > 0 ? dec->stats.sample_rate : 44100;
         int samples = frame_out.decoded_size / sizeof(int16_t) / ch;
         
+        if (sample_rate) *sample_rate = rate;
+        if (channels) *channels = ch;
+        
         /* 复制到调用者的缓冲区（限制大小） */
         size_t copy_samples = samples;
         if (copy_samples > max_samples) {
             copy_samples = max_samples;
         }
         size_t copy_bytes = copy_samples * ch * sizeof(int16_t);
-        memcpy(pcm_out, s_output_buf, copy_bytes);
+        memcpy(pcm_out, dec->output_buf, copy_bytes);
         
-        ESP_LOGI(TAG, "解码成功: %d采样, %dHz, %d声道", samples, s_sample_rate, s_channels);
+        dec->stats.frames++;
+        dec->stats.samples += copy_samples;
         return (int)copy_samples;
     }
     
@@ -395,27 +384,28 @@ int mp3_decoder_get_pcm(int16_t *pcm_out, size_t max_samples,
 /**
  * @brief       重置解码器状态
  */
-void mp3_decoder_reset(void)
+void mp3_decoder_reset(mp3_decoder_handle_t dec)
 {
-    if (!s_initialized) {
+    if (!dec) {
         return;
     }
     
-    s_input_buf_len = 0;
-    s_input_buf_pos = 0;
-    s_sync_found = false;
-    
-    if (s_decoder) {
-        esp_audio_dec_reset(s_decoder);
+    stream_reset(dec);
+    if (dec->handle) {
+        esp_audio_dec_reset(dec->handle);
     }
     
     ESP_LOGI(TAG, "解码器已重置");
 }
 
 /**
- * @brief       检查解码器是否已初始化
+ * @brief       读取解码统计
  */
-bool mp3_decoder_is_initialized(void)
+void mp3_decoder_get_stats(mp3_decoder_handle_t dec, mp3_decoder_stats_t *stats)
 {
-    return s_initialized;
+    if (dec) {
+        *stats = dec->stats;
+    } else {
+        memset(stats, 0, sizeof(*stats));
+    }
 }
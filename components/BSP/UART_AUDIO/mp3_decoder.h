@@ -13,51 +13,92 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "esp_err.h"
 
 /* MP3 解码器配置 */
-#define MP3_INPUT_BUFFER_SIZE       4096    /* MP3 输入缓冲区大小 */
+#define MP3_INPUT_BUFFER_SIZE       4096    /* MP3 输入缓冲区大小 (最小值, 实际按 audio_mem 计划) */
 #define MP3_OUTPUT_BUFFER_SIZE      4608    /* PCM 输出缓冲区大小 (1152 samples * 2 channels * 2 bytes) */
 
+/* 压缩格式 */
+typedef enum {
+    MP3_DECODER_CODEC_MP3 = 0,      /* MPEG-1/2 Layer III */
+    MP3_DECODER_CODEC_AAC,          /* AAC (ADTS 封装) */
+} mp3_decoder_codec_t;
+
+/* 解码器句柄 (每个压缩流一个, 各自持有缓冲区、同步/ID3 状态和统计) */
+typedef struct mp3_decoder *mp3_decoder_handle_t;
+
+/* 解码器配置 */
+typedef struct {
+    mp3_decoder_codec_t codec;      /* 压缩格式 */
+    size_t input_size;              /* 输入缓冲区大小 (字节), 0 表示按内存计划 */
+} mp3_decoder_config_t;
+
+#define MP3_DECODER_DEFAULT_CONFIG() {      \
+    .codec = MP3_DECODER_CODEC_MP3,         \
+    .input_size = 0,                        \
+}
+
+/* 解码统计 */
+typedef struct {
+    uint32_t frames;                /* 成功解码的帧数 */
+    uint32_t samples;               /* 输出的采样数 (每声道) */
+    uint32_t errors;                /* 解码错误次数 */
+    uint32_t resyncs;               /* 错误恢复重新同步次数 */
+    uint32_t skipped_bytes;         /* 同步/错误恢复丢弃的字节数 */
+    uint32_t id3_bytes;             /* 跳过的 ID3v2 标签字节数 */
+    uint32_t input_bytes;           /* 喂入的字节数 */
+    int sample_rate;                /* 最近一帧的采样率, 0 表示尚未解码 */
+    int channels;                   /* 最近一帧的声道数 */
+} mp3_decoder_stats_t;
+
 /**
- * @brief       初始化 MP3 解码器
- * @retval      ESP_OK: 成功; 其他: 失败
+ * @brief       创建解码器
+ * @param       config: 配置, NULL 使用 MP3_DECODER_DEFAULT_CONFIG
+ * @param       out: 返回的解码器句柄
+ * @retval      ESP_OK: 成功; ESP_ERR_INVALID_ARG: 参数错误; ESP_ERR_NO_MEM: 内存不足; ESP_FAIL: 打开解码器失败
  */
-esp_err_t mp3_decoder_init(void);
+esp_err_t mp3_decoder_create(const mp3_decoder_config_t *config, mp3_decoder_handle_t *out);
 
 /**
- * @brief       反初始化 MP3 解码器
+ * @brief       释放解码器
+ * @param       dec: 解码器句柄 (NULL 时忽略)
  */
-void mp3_decoder_deinit(void);
+void mp3_decoder_destroy(mp3_decoder_handle_t dec);
 
 /**
- * @brief       喂入 MP3 数据到解码器
- * @param       data: MP3 数据
+ * @brief       喂入压缩数据到解码器
+ * @param       dec: 解码器句柄
+ * @param       data: 压缩数据
  * @param       len: 数据长度
  * @retval      实际消耗的字节数
  */
-int mp3_decoder_feed(const uint8_t *data, size_t len);
+int mp3_decoder_feed(mp3_decoder_handle_t dec, const uint8_t *data, size_t len);
 
 /**
  * @brief       从解码器获取 PCM 数据
+ * @param       dec: 解码器句柄
  * @param       pcm_out: PCM 输出缓冲区
  * @param       max_samples: 最大采样数
  * @param       sample_rate: 输出采样率
  * @param       channels: 输出声道数
  * @retval      实际输出的采样数 (每声道), 0 表示数据不足
  */
-int mp3_decoder_get_pcm(int16_t *pcm_out, size_t max_samples, 
+int mp3_decoder_get_pcm(mp3_decoder_handle_t dec, int16_t *pcm_out, size_t max_samples,
                         int *sample_rate, int *channels);
 
 /**
- * @brief       重置解码器状态
+ * @brief       重置解码器状态 (新流开始: 清空输入, 重新检测 ID3/同步字, 统计清零)
+ * @param       dec: 解码器句柄
  */
-void mp3_decoder_reset(void);
+void mp3_decoder_reset(mp3_decoder_handle_t dec);
 
 /**
- * @brief       检查解码器是否已初始化
- * @retval      true: 已初始化; false: 未初始化
+ * @brief       读取解码统计
+ * @param       dec: 解码器句柄
+ * @param       stats: 输出
  */
-bool mp3_decoder_is_initialized(void);
+void mp3_decoder_get_stats(mp3_decoder_handle_t dec, mp3_decoder_stats_t *stats);
 
 #endif /* __MP3_DECODER_H__ */
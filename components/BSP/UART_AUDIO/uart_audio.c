@@ -12,250 +12,1491 @@
 #include "i2s.h"
 #include "es8388.h"
 #include "mp3_decoder.h"
+#include "audio_mixer.h"
+#include "audio_pool.h"
+#include "audio_mem.h"
+#include "audio_pm.h"
+#include "audio_plc.h"
+#include "audio_fec.h"
+#include "audio_aec.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/event_groups.h"
 #include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
 #include "xl9555.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "UART_AUDIO";
 
-/* 全局变量 */
-static uart_port_t g_uart_num = UART_NUM_0;
-static audio_mode_t g_mode = MODE_IDLE;
-static TaskHandle_t g_rx_task_handle = NULL;
+/* 串口音频实例: 每个实例一条独立的协议会话 */
+struct uart_audio {
+    uart_audio_config_t config;     /* 创建时的配置 */
+    TaskHandle_t rx_task;           /* 接收任务, 未运行为 NULL */
+    volatile bool running;          /* 接收任务运行标志 */
+    
+    /* 串口链路 */
+    uint32_t baud_rate;             /* 当前波特率 */
+    uint32_t prev_baud_rate;        /* 切换前波特率 (试用期回退用) */
+    bool link_probation;            /* 切换后尚未收到有效帧 */
+    TickType_t link_deadline;
+    
+    link_stats_t stats;             /* 链路统计 */
+    QueueHandle_t uart_events;      /* 驱动事件队列, 接收缓冲为空时接收任务在此阻塞 */
+    frame_decoder_t decoder;        /* 帧解码器, 仅接收任务使用 */
+    audio_block_t *frame_blk;       /* 解码器当前拼帧的块, 音频帧整块交给播放任务后换新块 */
+    uint16_t play_seq;              /* 下一个期望的音频帧序号 (CMD_AUDIO_SEQ) */
+    bool play_seq_valid;            /* 本会话已收到过带序号的帧 */
+    
+    /* 发送通道: 发送任务是串口唯一的写入方 */
+    QueueHandle_t tx_queue[TX_LANE_COUNT];
+    TaskHandle_t tx_task;
+    uint64_t tx_delay_total[TX_LANE_COUNT];   /* 排队延迟累计 (us), 查询时求平均 */
+    uint8_t fec_group;              /* 发出的音频每组帧数 (CMD_SET_FEC), 0 不加校验帧 */
+};
+
+/* 实例表, 第一个创建的实例为默认实例 */
+static struct uart_audio *s_instances[UART_AUDIO_MAX_INSTANCES];
+static struct uart_audio *s_default = NULL;
+static struct uart_audio *volatile s_owner = NULL;      /* 当前占用编解码器的实例, 仅控制任务写入 */
+
+/* 全局变量 (编解码器和工作模式为所有实例共享) */
+static volatile audio_mode_t g_mode = MODE_IDLE;        /* 仅控制任务写入 */
+static TaskHandle_t g_ctrl_task_handle = NULL;
 static TaskHandle_t g_record_task_handle = NULL;
 static TaskHandle_t g_play_task_handle = NULL;
 static volatile bool g_running = false;
 static audio_format_t g_audio_format = AUDIO_FORMAT_PCM;  /* 当前音频格式 */
+static uint32_t g_sample_rate = AUDIO_SAMPLE_RATE;        /* 协商的 PCM 采样率 */
+static int g_i2s_rate = SAMPLE_RATE;                      /* I2S 当前时钟 */
+static mp3_decoder_handle_t g_decoder = NULL;             /* 播放流的 MP3 解码器, 启动时创建, 会话间复用 */
 
-/* 音频缓冲区 */
-static uint8_t *g_audio_buf = NULL;
-static QueueHandle_t g_play_queue = NULL;
+/* 控制任务: 按键和主机命令经队列串行处理, 模式变化经事件组通知 */
+typedef struct {
+    audio_event_t event;
+    struct uart_audio *source;      /* 发起实例, NULL 表示本地 (按键) 即默认实例 */
+    TaskHandle_t waiter;            /* 非 NULL 时切换完成后以 seq 为通知值通知该任务 */
+    uint32_t seq;                   /* 请求序号, 等待方据此丢弃已超时请求的迟到通知 */
+    int64_t post_us;                /* 投递时刻, 用于统计切换延迟 */
+} ctrl_request_t;
+
+static QueueHandle_t g_ctrl_queue = NULL;
+static uint32_t s_ctrl_seq = 0;
+static EventGroupHandle_t g_mode_events = NULL;
 
-/* 帧解析状态 */
+/* 缓冲池: 接收帧 (接收任务 → 播放任务按指针传递), 解码输出, I2S 录音块, 已编码的发送帧 */
+static audio_pool_handle_t g_rx_pool = NULL;
+static audio_pool_handle_t g_pcm_pool = NULL;
+static audio_pool_handle_t g_dma_pool = NULL;
+static audio_pool_handle_t g_tx_ctrl_pool = NULL;
+static audio_pool_handle_t g_tx_bulk_pool = NULL;
+
+/* 发送通道项: 已编码的完整帧, 或按顺序执行的波特率切换 / 任务退出 */
+typedef struct {
+    audio_block_t *block;           /* 帧数据; NULL 表示控制项 */
+    int64_t queued_us;              /* 入队时刻 */
+    uint32_t baud;                  /* block 为 NULL 时: 非 0 切换波特率, 0 退出发送任务 */
+} tx_item_t;
+
+/* 播放任务消息: 音频块和曲目切换按接收顺序排队 */
 typedef enum {
-    PARSE_HEADER_0,
-    PARSE_HEADER_1,
-    PARSE_CMD,
-    PARSE_LEN_L,
-    PARSE_LEN_H,
-    PARSE_DATA,
-    PARSE_CHECKSUM,
-} parse_state_t;
+    PLAY_MSG_DATA = 0,              /* 音频数据 (block) */
+    PLAY_MSG_NEXT_TRACK,            /* 切换曲目 (format, rate) */
+    PLAY_MSG_CONCEAL,               /* 丢帧隐藏 (lost_frames, frame_samples) */
+    PLAY_MSG_SHUTDOWN,              /* 播放任务退出 */
+} play_msg_type_t;
+
+typedef struct {
+    play_msg_type_t type;
+    audio_format_t format;
+    uint32_t rate;
+    audio_block_t *block;
+    struct uart_audio *inst;        /* 数据来源实例 (统计) */
+    uint16_t lost_frames;           /* 丢失的帧数 */
+    uint16_t frame_samples;         /* 每帧采样数 (按丢失处之后的帧估计) */
+} play_msg_t;
+
+static QueueHandle_t g_play_queue = NULL;
+static SemaphoreHandle_t g_play_lock = NULL;              /* 播放任务处理消息时持有, 退出播放时由控制任务持有 */
+
+/* 播放统计与录音配置 (属于编解码器, 统计计入当前占用实例) */
+static int64_t g_play_deadline_us = 0;                    /* 预计播放缓冲耗尽时刻 */
+static audio_plc_t g_plc;                                 /* 播放流丢包隐藏, 仅播放任务使用 (空闲时控制任务复位) */
+
+/* 播放流前向纠错: 仅占用实例的接收任务使用, 开始/停止播放时复位。
+ * 发现缺帧后暂扣随后的帧, 校验帧到达时重建缺失的帧再按顺序交给播放任务 */
+static struct {
+    audio_fec_t fec;
+    bool active;                    /* 本会话收到过校验帧 (主机开启了前向纠错) */
+    bool hold;                      /* 正在等待校验帧重建 lost_seq */
+    uint16_t lost_seq;
+    uint16_t lost_samples;          /* 重建失败时按此长度隐藏 */
+    uint8_t held_count;
+    audio_block_t *held[AUDIO_FEC_MAX_GROUP];
+} g_fec_rx;
+
+/* 录音/麦克风流前向纠错: 仅录音任务使用, 进入新会话时重新计数 */
+static audio_fec_t g_fec_tx;
+static uint16_t g_tx_seq = 0;
+static volatile bool g_fec_tx_restart = false;
+static uint16_t g_record_frame = AUDIO_FRAME_SIZE;        /* 录音每帧字节数 */
+
+/* 支持的 PCM 采样率与波特率 (CMD_GET_CAPS 上报) */
+static const uint32_t s_sample_rates[] = {8000, 16000, 22050, 32000, 44100, 48000};
+static const uint32_t s_baud_rates[] = {115200, 230400, 460800, 921600, 1500000, 2000000};
+
+/**
+ * @brief       编码一帧放入发送通道
+ * @param       prefix: 数据前的附加字节 (流 ID), 可为 NULL
+ * @param       timeout: 无空闲块或通道满时的最长等待
+ * @retval      帧总字节数, 丢弃时为 0
+ */
+static int tx_enqueue(struct uart_audio *inst, tx_lane_t lane, uint8_t cmd, const uint8_t *prefix, uint16_t prefix_len,
+                      const uint8_t *data, uint16_t len, TickType_t timeout)
+{
+    uint16_t payload = prefix_len + len;
+    size_t total = FRAME_OVERHEAD + payload;
+    audio_block_t *blk = NULL;
+    
+    if (payload <= FRAME_MAX_DATA_SIZE) {
+        blk = audio_pool_alloc(total <= AUDIO_TX_CTRL_BLOCK ? g_tx_ctrl_pool : g_tx_bulk_pool, timeout);
+    }
+    if (!blk) {
+        inst->stats.tx_drops++;
+        return 0;
+    }
+    
+    uint8_t *frame = blk->data;
+    uint8_t *body = frame + FRAME_HEAD_SIZE;
+    frame_encode_header(frame, cmd, payload);
+    if (prefix_len > 0) {
+        memcpy(body, prefix, prefix_len);
+    }
+    if (len > 0) {
+        memcpy(body + prefix_len, data, len);
+    }
+    body[payload] = frame_encode_checksum(frame, body, payload);
+    blk->len = total;
+    
+    tx_item_t item = {
+        .block = blk,
+        .queued_us = esp_timer_get_time(),
+    };
+    if (xQueueSend(inst->tx_queue[lane], &item, timeout) != pdTRUE) {
+        audio_block_unref(blk);
+        inst->stats.tx_drops++;
+        return 0;
+    }
+    xTaskNotifyGive(inst->tx_task);
+    return total;
+}
+
+/**
+ * @brief       排入波特率切换 (在之前入队的帧以旧波特率发完后执行)
+ */
+static void tx_set_baud(struct uart_audio *inst, uint32_t baud)
+{
+    tx_item_t item = {
+        .baud = baud,
+    };
+    xQueueSend(inst->tx_queue[TX_LANE_CTRL], &item, pdMS_TO_TICKS(AUDIO_TX_TIMEOUT_MS));
+    xTaskNotifyGive(inst->tx_task);
+}
 
 /**
- * @brief       计算校验和
+ * @brief       把一项写入驱动并记录排队延迟
  */
-static uint8_t calc_checksum(const uint8_t *data, uint16_t len)
+static void tx_write(struct uart_audio *inst, tx_lane_t lane, const tx_item_t *item)
 {
-    uint8_t sum = 0;
-    for (uint16_t i = 0; i < len; i++) {
-        sum ^= data[i];
+    uart_port_t uart_num = inst->config.uart_num;
+    
+    if (!item->block) {
+        uart_wait_tx_done(uart_num, pdMS_TO_TICKS(100));
+        uart_set_baudrate(uart_num, item->baud);
+        return;
     }
-    return sum;
+    
+    uint32_t delay = (uint32_t)(esp_timer_get_time() - item->queued_us);
+    inst->stats.tx_frames[lane]++;
+    inst->tx_delay_total[lane] += delay;
+    if (delay > inst->stats.tx_delay_max_us[lane]) {
+        inst->stats.tx_delay_max_us[lane] = delay;
+    }
+    
+    audio_block_t *blk = item->block;
+    uart_write_bytes(uart_num, (const char *)blk->data + blk->offset, blk->len);
+    audio_block_unref(blk);
 }
 
 /**
- * @brief       发送音频帧
+ * @brief       发送任务: 控制通道严格优先, 在帧边界抢占批量通道
+ * @note        批量帧等驱动发完上一帧才写入, 驱动缓冲中至多一帧音频;
+ *              控制帧随到随写, 最多排在一帧音频之后
+ */
+static void tx_task(void *arg)
+{
+    struct uart_audio *inst = arg;
+    QueueHandle_t ctrl = inst->tx_queue[TX_LANE_CTRL];
+    QueueHandle_t bulk = inst->tx_queue[TX_LANE_BULK];
+    tx_item_t item;
+    
+    while (1) {
+        if (xQueueReceive(ctrl, &item, 0) == pdTRUE) {
+            if (!item.block && !item.baud) {
+                break;
+            }
+            tx_write(inst, TX_LANE_CTRL, &item);
+            continue;
+        }
+        if (uxQueueMessagesWaiting(bulk) == 0) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        
+        /* 等待期间到达的控制帧先写 */
+        if (uart_wait_tx_done(inst->config.uart_num, pdMS_TO_TICKS(AUDIO_TX_TIMEOUT_MS)) != ESP_OK ||
+            uxQueueMessagesWaiting(ctrl) > 0) {
+            continue;
+        }
+        if (xQueueReceive(bulk, &item, 0) == pdTRUE) {
+            tx_write(inst, TX_LANE_BULK, &item);
+        }
+    }
+    
+    /* 丢弃未发送的帧 */
+    for (int lane = 0; lane < TX_LANE_COUNT; lane++) {
+        while (xQueueReceive(inst->tx_queue[lane], &item, 0) == pdTRUE) {
+            audio_block_unref(item.block);
+        }
+    }
+    inst->tx_task = NULL;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief       向指定实例发送帧
+ */
+int uart_audio_send(uart_audio_handle_t inst, uint8_t cmd, const uint8_t *data, uint16_t len)
+{
+    if (!inst) {
+        return 0;
+    }
+    
+    tx_lane_t lane = (cmd == CMD_AUDIO_DATA) ? TX_LANE_BULK : TX_LANE_CTRL;
+    return tx_enqueue(inst, lane, cmd, NULL, 0, data, len, pdMS_TO_TICKS(AUDIO_TX_TIMEOUT_MS));
+}
+
+/**
+ * @brief       向默认实例发送帧
  */
 int uart_audio_send_frame(uint8_t cmd, const uint8_t *data, uint16_t len)
 {
-    uint8_t header[5];
-    header[0] = FRAME_HEADER_0;
-    header[1] = FRAME_HEADER_1;
-    header[2] = cmd;
-    header[3] = len & 0xFF;
-    header[4] = (len >> 8) & 0xFF;
+    return uart_audio_send(s_default, cmd, data, len);
+}
+
+/**
+ * @brief       发送一帧录音/麦克风音频 (仅录音任务调用)
+ * @note        实例开启前向纠错时改发带序号的 CMD_AUDIO_SEQ, 每 fec_group 帧后跟一个校验帧;
+ *              本地通道满而丢弃的帧仍计入校验, 主机可以重建
+ * @param       stream: 全双工流 ID, 非全双工为 NULL
+ * @param       timeout: 通道满时的最长等待 (麦克风流为 0, 不拖慢应答和播放)
+ * @retval      true: 已入队; false: 已丢弃
+ */
+static bool send_audio(struct uart_audio *inst, const uint8_t *stream, const uint8_t *data, uint16_t len,
+                       TickType_t timeout)
+{
+    uint16_t prefix_len = stream ? 1 : 0;
+    uint8_t group = inst->fec_group;
+    
+    /* 校验帧比数据帧多帧头, 放不下时退回不带序号的帧 */
+    if (group == 0 || AUDIO_FEC_HEADER + prefix_len + len > FRAME_MAX_DATA_SIZE) {
+        return tx_enqueue(inst, TX_LANE_BULK, CMD_AUDIO_DATA, stream, prefix_len, data, len, timeout) > 0;
+    }
+    
+    if (g_fec_tx_restart) {
+        g_fec_tx_restart = false;
+        audio_fec_reset(&g_fec_tx);
+        g_tx_seq = 0;
+    }
+    
+    uint8_t prefix[3] = {g_tx_seq & 0xFF, g_tx_seq >> 8, stream ? *stream : 0};
+    audio_fec_add(&g_fec_tx, g_tx_seq, prefix + 2, prefix_len, data, len);
+    g_tx_seq++;
+    bool sent = tx_enqueue(inst, TX_LANE_BULK, CMD_AUDIO_SEQ, prefix, 2 + prefix_len, data, len, timeout) > 0;
+    
+    if (audio_fec_count(&g_fec_tx) >= group) {
+        uint8_t header[AUDIO_FEC_HEADER];
+        uint16_t parity_len = audio_fec_parity(&g_fec_tx, header);
+        if (tx_enqueue(inst, TX_LANE_BULK, CMD_AUDIO_FEC, header, AUDIO_FEC_HEADER,
+                       g_fec_tx.acc, parity_len, timeout) > 0) {
+            inst->stats.fec_tx_parity++;
+        }
+        audio_fec_reset(&g_fec_tx);
+    }
+    return sent;
+}
+
+/**
+ * @brief       发送带状态的应答
+ */
+static void send_ack(struct uart_audio *inst, uint8_t cmd, uint8_t status)
+{
+    uint8_t ack[2] = {cmd, status};
+    uart_audio_send(inst, CMD_ACK, ack, sizeof(ack));
+}
+
+/**
+ * @brief       检查数值是否在支持列表中
+ */
+static bool value_supported(const uint32_t *list, size_t count, uint32_t value)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (list[i] == value) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief       按需切换 I2S 采样率
+ */
+static void set_i2s_rate(int rate)
+{
+    if (rate > 0 && rate != g_i2s_rate) {
+        ESP_LOGI(TAG, "设置 I2S 采样率: %d Hz", rate);
+        i2s_set_samplerate_bits_sample(rate, AUDIO_BITS_PER_SAMPLE);
+        g_i2s_rate = rate;
+    }
+}
+
+/**
+ * @brief       写入一个 TLV 项
+ * @retval      写入后的偏移
+ */
+static size_t tlv_put(uint8_t *out, size_t pos, size_t size, uint8_t tag, const void *value, uint8_t len)
+{
+    if (pos + 2 + len > size) {
+        return pos;
+    }
+    out[pos++] = tag;
+    out[pos++] = len;
+    memcpy(out + pos, value, len);
+    return pos + len;
+}
+
+/**
+ * @brief       写入 u32 列表 TLV 项 (小端)
+ */
+static size_t tlv_put_u32_list(uint8_t *out, size_t pos, size_t size, uint8_t tag,
+                               const uint32_t *list, size_t count)
+{
+    uint8_t value[64];
+    size_t len = 0;
+    for (size_t i = 0; i < count && len + 4 <= sizeof(value); i++) {
+        value[len++] = list[i] & 0xFF;
+        value[len++] = (list[i] >> 8) & 0xFF;
+        value[len++] = (list[i] >> 16) & 0xFF;
+        value[len++] = (list[i] >> 24) & 0xFF;
+    }
+    return tlv_put(out, pos, size, tag, value, (uint8_t)len);
+}
+
+/**
+ * @brief       生成设备能力描述
+ * @retval      描述长度
+ */
+static size_t build_capabilities(struct uart_audio *inst, uint8_t *out, size_t size)
+{
+    size_t pos = 0;
+    
+    uint8_t version[2] = {UART_AUDIO_PROTO_MAJOR, UART_AUDIO_PROTO_MINOR};
+    pos = tlv_put(out, pos, size, CAP_TAG_PROTO_VERSION, version, sizeof(version));
+    
+    pos = tlv_put_u32_list(out, pos, size, CAP_TAG_SAMPLE_RATES, s_sample_rates,
+                           sizeof(s_sample_rates) / sizeof(s_sample_rates[0]));
+    
+    uint8_t formats[] = {AUDIO_FORMAT_PCM, AUDIO_FORMAT_MP3};
+    pos = tlv_put(out, pos, size, CAP_TAG_FORMATS, formats, sizeof(formats));
+    
+    uint8_t pcm_format[2] = {AUDIO_BITS_PER_SAMPLE, AUDIO_CHANNELS};
+    pos = tlv_put(out, pos, size, CAP_TAG_PCM_FORMAT, pcm_format, sizeof(pcm_format));
+    
+    uint8_t max_frame[4] = {FRAME_MAX_DATA_SIZE & 0xFF, FRAME_MAX_DATA_SIZE >> 8,
+                            AUDIO_FRAME_SIZE_MAX & 0xFF, AUDIO_FRAME_SIZE_MAX >> 8};
+    pos = tlv_put(out, pos, size, CAP_TAG_MAX_FRAME, max_frame, sizeof(max_frame));
     
-    /* 计算校验和 */
-    uint8_t checksum = calc_checksum(header + 2, 3);
-    if (data && len > 0) {
-        checksum ^= calc_checksum(data, len);
+    uint16_t buffers[4] = {inst->config.rx_buf_size, inst->config.tx_buf_size, I2S_DMA_BUF_COUNT, I2S_DMA_BUF_LEN};
+    uint8_t buf_le[8];
+    for (int i = 0; i < 4; i++) {
+        buf_le[i * 2] = buffers[i] & 0xFF;
+        buf_le[i * 2 + 1] = buffers[i] >> 8;
     }
+    pos = tlv_put(out, pos, size, CAP_TAG_BUFFERS, buf_le, sizeof(buf_le));
     
-    /* 发送帧头 */
-    uart_write_bytes(g_uart_num, (const char *)header, 5);
+    static const char codecs[] = "mp3";
+    pos = tlv_put(out, pos, size, CAP_TAG_CODECS, codecs, sizeof(codecs) - 1);
     
-    /* 发送数据 */
-    if (data && len > 0) {
-        uart_write_bytes(g_uart_num, (const char *)data, len);
+    pos = tlv_put_u32_list(out, pos, size, CAP_TAG_BAUD_RATES, s_baud_rates,
+                           sizeof(s_baud_rates) / sizeof(s_baud_rates[0]));
+    
+    uint8_t current[10];
+    uint32_t cur[2] = {g_sample_rate, inst->baud_rate};
+    for (int i = 0; i < 2; i++) {
+        current[i * 4] = cur[i] & 0xFF;
+        current[i * 4 + 1] = (cur[i] >> 8) & 0xFF;
+        current[i * 4 + 2] = (cur[i] >> 16) & 0xFF;
+        current[i * 4 + 3] = (cur[i] >> 24) & 0xFF;
+    }
+    current[8] = g_record_frame & 0xFF;
+    current[9] = g_record_frame >> 8;
+    pos = tlv_put(out, pos, size, CAP_TAG_CURRENT, current, sizeof(current));
+    
+    uint8_t mac[6] = {0};
+    esp_efuse_mac_get_default(mac);
+    pos = tlv_put(out, pos, size, CAP_TAG_DEVICE_ID, mac, sizeof(mac));
+    
+    uint8_t fec_group = AUDIO_FEC_MAX_GROUP;
+    pos = tlv_put(out, pos, size, CAP_TAG_FEC, &fec_group, sizeof(fec_group));
+    
+    return pos;
+}
+
+/**
+ * @brief       切换串口波特率 (应答以旧波特率发出后再切换)
+ */
+static void set_link_baud(struct uart_audio *inst, uint32_t baud)
+{
+    tx_set_baud(inst, baud);
+    inst->prev_baud_rate = inst->baud_rate;
+    inst->baud_rate = baud;
+    inst->link_probation = true;
+    inst->link_deadline = xTaskGetTickCount() + pdMS_TO_TICKS(UART_LINK_PROBATION_MS);
+    ESP_LOGI(TAG, "UART%d 波特率切换为 %lu", inst->config.uart_num, (unsigned long)baud);
+}
+
+/**
+ * @brief       复位链路统计 (保留缓冲区大小)
+ */
+static void reset_link_stats(struct uart_audio *inst)
+{
+    memset(&inst->stats, 0, sizeof(inst->stats));
+    memset(inst->tx_delay_total, 0, sizeof(inst->tx_delay_total));
+    inst->stats.rx_buf_size = inst->config.rx_buf_size;
+    inst->stats.play_min_slack_ms = UINT32_MAX;
+}
+
+/**
+ * @brief       播放缓冲健康度统计
+ * @note        按写入 I2S 的时长推算缓冲耗尽时刻, 新数据到达时已耗尽记为一次欠载
+ * @param       inst: 播放数据来源实例 (统计计入该实例)
+ * @param       samples: 本次写入的采样数 (每声道)
+ * @param       rate: 采样率
+ */
+static void track_playback(struct uart_audio *inst, int samples, int rate)
+{
+    if (samples <= 0 || rate <= 0) {
+        return;
     }
     
-    /* 发送校验和 */
-    uart_write_bytes(g_uart_num, (const char *)&checksum, 1);
+    int64_t now = esp_timer_get_time();
+    if (g_play_deadline_us == 0 || now > g_play_deadline_us) {
+        if (g_play_deadline_us != 0) {
+            inst->stats.play_underruns++;
+        }
+        g_play_deadline_us = now;
+    } else {
+        uint32_t slack_ms = (uint32_t)((g_play_deadline_us - now) / 1000);
+        if (slack_ms < inst->stats.play_min_slack_ms) {
+            inst->stats.play_min_slack_ms = slack_ms;
+        }
+    }
+    g_play_deadline_us += (int64_t)samples * 1000000 / rate;
+}
+
+/**
+ * @brief       播放中切换曲目格式 (I2S 保持运行; 解码器启动时已创建, 这里只复位)
+ */
+static void switch_track_format(audio_format_t format)
+{
+    if (format == AUDIO_FORMAT_MP3) {
+        mp3_decoder_reset(g_decoder);   /* 丢弃上一曲残留的不完整帧 */
+    }
+    g_audio_format = format;
+}
+
+/**
+ * @brief       更新当前模式并通知等待者 (仅控制任务调用)
+ */
+static void set_mode(audio_mode_t mode)
+{
+    g_mode = mode;
+    audio_pm_set_stream(mode == MODE_PLAYING || mode == MODE_DUPLEX, mode != MODE_IDLE);
+    xEventGroupClearBits(g_mode_events, AUDIO_MODE_BITS_ALL & ~AUDIO_MODE_BIT(mode));
+    xEventGroupSetBits(g_mode_events, AUDIO_MODE_BIT(mode));
     
-    return 5 + len + 1;
+    /* 会话建立完成: 从这里到 enter_idle 不应再有堆操作 */
+    if (mode != MODE_IDLE) {
+        g_fec_tx_restart = true;
+        audio_mem_guard_begin();
+    }
+}
+
+/**
+ * @brief       进入录音模式
+ */
+static void enter_record(void)
+{
+    /* 配置ES8388为录音模式 (参考备份项目) */
+    es8388_adda_cfg(1, 1);      /* 打开DAC打开ADC */
+    es8388_input_cfg(0);        /* 打开输入通道0 */
+    es8388_mic_gain(8);         /* MIC增益设置为最大 (8 = 24dB) */
+    es8388_output_cfg(1, 1);    /* DAC选择通道输出 */
+    es8388_sai_cfg(0, 3);       /* 飞利浦标准,16位数据长度 */
+    set_i2s_rate(g_sample_rate);
+    i2s_trx_start();
+    set_mode(MODE_RECORDING);
+}
+
+/**
+ * @brief       设置播放输入的目标缓冲深度
+ * @note        PCM 由主机按墙钟发送, 混音器按深度趋势补偿两边的时钟偏差;
+ *              MP3 按解码背压送入, 不跟踪深度
+ * @param       pcm: 当前为 PCM 流
+ */
+static void update_stream_target(bool pcm)
+{
+    uint32_t frames = 0;
+
+    if (pcm) {
+        uint32_t limit = audio_mem_get_plan()->mixer_ring_frames / 2;
+        frames = g_sample_rate * AUDIO_PLAY_TARGET_MS / 1000;
+        if (frames > limit) {
+            frames = limit;
+        }
+        if (frames < AUDIO_MIXER_BLOCK_FRAMES * 2) {
+            frames = AUDIO_MIXER_BLOCK_FRAMES * 2;
+        }
+    }
+    audio_mixer_set_target(MIXER_INPUT_STREAM, frames);
+}
+
+/**
+ * @brief       复位播放流前向纠错, 丢弃暂扣的帧 (控制任务开始播放/全双工时调用)
+ */
+static void fec_rx_reset(void)
+{
+    for (uint8_t i = 0; i < g_fec_rx.held_count; i++) {
+        audio_block_unref(g_fec_rx.held[i]);
+    }
+    g_fec_rx.held_count = 0;
+    g_fec_rx.hold = false;
+    g_fec_rx.active = false;
+    audio_fec_reset(&g_fec_rx.fec);
+}
+
+/**
+ * @brief       进入播放模式
+ */
+static void enter_play(void)
+{
+    /* 开启喇叭功放 (低电平有效) */
+    xl9555_pin_write(SPK_EN_IO, 0);
+    /* 配置ES8388为播放模式 */
+    es8388_adda_cfg(1, 0);      /* DAC开启 */
+    es8388_output_cfg(1, 1);    /* 输出通道开启 */
+    es8388_sai_cfg(0, 3);       /* 设置I2S模式: 标准I2S, 16bit */
+    es8388_hpvol_set(30);       /* 设置耳机音量 */
+    es8388_spkvol_set(30);      /* 设置喇叭音量 */
+    set_i2s_rate(g_sample_rate); /* MP3 解码后按实际采样率再切换 */
+    i2s_trx_start();
+    audio_mixer_start();
+    audio_mixer_open(MIXER_INPUT_STREAM, AUDIO_MIXER_GAIN_UNITY);
+    update_stream_target(g_audio_format == AUDIO_FORMAT_PCM);
+    g_play_deadline_us = 0;
+    
+    /* MP3 格式: 复用启动时创建的解码器, 清掉上一会话的状态 */
+    if (g_audio_format == AUDIO_FORMAT_MP3) {
+        mp3_decoder_reset(g_decoder);
+    }
+    /* 新会话的序号与校验组从头开始; 此时没有实例在处理播放流, 发起实例正等待切换完成 */
+    s_owner->play_seq_valid = false;
+    fec_rx_reset();
+    set_mode(MODE_PLAYING);
+}
+
+/**
+ * @brief       进入全双工模式
+ * @note        录音和播放共用一套编解码配置: ADC/DAC 同时开启, 同一 I2S 时钟 (g_sample_rate), 仅 PCM
+ */
+static void enter_duplex(void)
+{
+    xl9555_pin_write(SPK_EN_IO, 0);
+    es8388_adda_cfg(1, 1);      /* DAC/ADC 同时开启 */
+    es8388_input_cfg(0);        /* 打开输入通道0 */
+    es8388_mic_gain(8);         /* MIC增益 24dB */
+    es8388_output_cfg(1, 1);    /* 输出通道开启 */
+    es8388_sai_cfg(0, 3);       /* 飞利浦标准,16位数据长度 */
+    es8388_hpvol_set(30);
+    es8388_spkvol_set(30);
+    set_i2s_rate(g_sample_rate);
+    audio_aec_start(g_sample_rate); /* 收发启动前清空参考, 发送与麦克风采样从同一时刻计数 */
+    i2s_trx_start();
+    audio_mixer_start();
+    audio_mixer_open(MIXER_INPUT_STREAM, AUDIO_MIXER_GAIN_UNITY);
+    update_stream_target(true);
+    g_play_deadline_us = 0;
+    s_owner->play_seq_valid = false;
+    fec_rx_reset();
+    set_mode(MODE_DUPLEX);
+}
+
+/**
+ * @brief       丢弃播放队列中尚未处理的消息 (调用者持有 g_play_lock)
+ */
+static void play_flush(void)
+{
+    play_msg_t msg;
+    
+    while (xQueueReceive(g_play_queue, &msg, 0) == pdTRUE) {
+        audio_block_unref(msg.block);
+    }
+}
+
+/**
+ * @brief       从录音/播放/全双工返回空闲
+ */
+static void enter_idle(void)
+{
+    bool playing = (g_mode == MODE_PLAYING || g_mode == MODE_DUPLEX);
+    
+    audio_mem_guard_end();
+    
+    if (playing) {
+        /* 先停混音 (唤醒阻塞在写入的播放任务), 再等播放任务放下当前块 */
+        audio_mixer_stop();
+        xSemaphoreTake(g_play_lock, portMAX_DELAY);
+        play_flush();
+        audio_plc_reset(&g_plc);
+        /* 前向纠错暂扣的帧留到下一会话开始时释放: 按键等本地事件切换时,
+         * 占用实例的接收任务可能还在处理校验组 (接收缓冲池为暂扣多留了块) */
+    }
+    
+    if (g_mode == MODE_RECORDING) {
+        i2s_trx_stop();
+    } else if (g_mode == MODE_DUPLEX) {
+        audio_aec_stop();
+        i2s_trx_stop();
+        xl9555_pin_write(SPK_EN_IO, 1);
+    } else if (g_mode == MODE_PLAYING) {
+        i2s_trx_stop();
+        /* 关闭喇叭功放 (低电平有效) */
+        xl9555_pin_write(SPK_EN_IO, 1);
+        
+        /* 重置为 PCM 格式 (解码器保留到下一会话) */
+        g_audio_format = AUDIO_FORMAT_PCM;
+    }
+    set_mode(MODE_IDLE);
+    s_owner = NULL;
+    
+    if (playing) {
+        xSemaphoreGive(g_play_lock);
+    }
+}
+
+/**
+ * @brief       执行一个控制事件 (状态机)
+ * @param       source: 发起实例; 开始录音/播放后该实例占用编解码器, 非音频实例不能开始
+ */
+static void ctrl_handle(struct uart_audio *source, audio_event_t event)
+{
+    audio_mode_t mode = g_mode;
+    bool can_start = (mode == MODE_IDLE && source && source->config.audio);
+    
+    switch (event) {
+        case AUDIO_EVT_START_RECORD:
+            if (can_start) {
+                s_owner = source;
+                enter_record();
+            }
+            break;
+            
+        case AUDIO_EVT_STOP_RECORD:
+            if (mode == MODE_RECORDING) {
+                enter_idle();
+            }
+            break;
+            
+        case AUDIO_EVT_START_PLAY:
+            if (can_start) {
+                s_owner = source;
+                enter_play();
+            }
+            break;
+            
+        case AUDIO_EVT_STOP_PLAY:
+            if (mode == MODE_PLAYING) {
+                enter_idle();
+            }
+            g_audio_format = AUDIO_FORMAT_PCM;
+            break;
+            
+        case AUDIO_EVT_START_DUPLEX:
+            if (can_start) {
+                s_owner = source;
+                enter_duplex();
+            }
+            break;
+            
+        case AUDIO_EVT_STOP_DUPLEX:
+            if (mode == MODE_DUPLEX) {
+                enter_idle();
+            }
+            break;
+            
+        case AUDIO_EVT_TOGGLE:
+            if (can_start) {
+                s_owner = source;
+                enter_record();
+            } else if (mode != MODE_IDLE) {
+                enter_idle();
+            }
+            break;
+            
+        case AUDIO_EVT_IDLE:
+        case AUDIO_EVT_SHUTDOWN:
+            if (mode != MODE_IDLE) {
+                enter_idle();
+            }
+            break;
+    }
+}
+
+/**
+ * @brief       控制任务: 唯一修改工作模式的任务
+ */
+static void ctrl_task(void *arg)
+{
+    static const char *mode_names[] = {"空闲", "录音", "播放", "全双工"};
+    ctrl_request_t req;
+    
+    ESP_LOGI(TAG, "控制任务启动");
+    
+    while (1) {
+        if (xQueueReceive(g_ctrl_queue, &req, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        
+        struct uart_audio *source = req.source ? req.source : s_default;
+        audio_mode_t before = g_mode;
+        ctrl_handle(source, req.event);
+        
+        if (g_mode != before && source) {
+            uint32_t latency_us = (uint32_t)(esp_timer_get_time() - req.post_us);
+            source->stats.mode_switches++;
+            if (latency_us > source->stats.mode_latency_max_us) {
+                source->stats.mode_latency_max_us = latency_us;
+            }
+            ESP_LOGI(TAG, "模式切换: %s → %s (UART%d), 延迟 %lu us",
+                     mode_names[before], mode_names[g_mode], source->config.uart_num,
+                     (unsigned long)latency_us);
+        }
+        
+        if (req.waiter) {
+            xTaskNotify(req.waiter, req.seq, eSetValueWithOverwrite);
+        }
+        if (req.event == AUDIO_EVT_SHUTDOWN) {
+            break;
+        }
+    }
+    
+    xEventGroupSetBits(g_mode_events, AUDIO_STOP_BIT);
+    ESP_LOGI(TAG, "控制任务退出");
+    g_ctrl_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief       向控制任务投递事件
+ * @param       source: 发起实例 (NULL 表示本地按键/接口, 归属默认实例)
+ * @param       event: 控制事件
+ * @param       wait: 是否等待切换完成 (主机命令需在应答前完成, 保证后续帧按新模式处理)
+ * @retval      ESP_OK: 成功; ESP_ERR_TIMEOUT: 队列满或等待超时
+ */
+static esp_err_t ctrl_request(struct uart_audio *source, audio_event_t event, bool wait)
+{
+    ctrl_request_t req = {
+        .event = event,
+        .source = source,
+        .waiter = wait ? xTaskGetCurrentTaskHandle() : NULL,
+        .seq = ++s_ctrl_seq,
+        .post_us = esp_timer_get_time(),
+    };
+    TickType_t timeout = pdMS_TO_TICKS(AUDIO_CTRL_TIMEOUT_MS);
+    
+    if (!g_ctrl_queue || xQueueSend(g_ctrl_queue, &req, timeout) != pdTRUE) {
+        ESP_LOGW(TAG, "控制队列已满, 丢弃事件 %d", event);
+        return ESP_ERR_TIMEOUT;
+    }
+    
+    /* 之前超时的请求完成后仍会通知本任务, 只认本次请求的序号 */
+    TickType_t start = xTaskGetTickCount();
+    while (wait) {
+        uint32_t done = 0;
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout ||
+            xTaskNotifyWait(0, UINT32_MAX, &done, timeout - elapsed) != pdTRUE) {
+            ESP_LOGW(TAG, "等待模式切换超时, 事件 %d", event);
+            return ESP_ERR_TIMEOUT;
+        }
+        if (done == req.seq) {
+            break;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief       播放单声道 16bit PCM (复制为立体声写入混音器主流输入)
+ */
+static void play_pcm(struct uart_audio *inst, const uint8_t *data, uint16_t len)
+{
+    /* data 可能直接指向接收缓冲区 (未对齐)，混音器按字节组装采样 */
+    uint16_t samples = len / 2;  /* 单声道采样数 */
+    int16_t merged[AUDIO_PLC_MERGE];
+    TickType_t timeout = pdMS_TO_TICKS(AUDIO_PLAY_WRITE_TIMEOUT_MS);
+    
+    track_playback(inst, samples, g_i2s_rate);
+    
+    /* 记入隐藏历史; 紧接隐藏之后的帧头换成与合成信号交叉淡化的版本 */
+    size_t head = audio_plc_receive(&g_plc, data, samples, merged);
+    size_t written = 0;
+    if (head > 0) {
+        written = audio_mixer_write_mono(MIXER_INPUT_STREAM, (const uint8_t *)merged, head, timeout);
+    }
+    written += audio_mixer_write_mono(MIXER_INPUT_STREAM, data + head * 2, samples - head, timeout);
+    
+    /* 调试：每100帧打印一次 */
+    static uint32_t frame_count = 0;
+    frame_count++;
+    if (frame_count % 100 == 1) {
+        ESP_LOGI(TAG, "PCM帧 #%lu: 输入%d字节, 混音写入%d采样", 
+                 frame_count, len, (int)written);
+    }
+}
+
+/**
+ * @brief       合成丢失的 PCM 帧 (基音周期重复 + 衰减) 写入混音器
+ * @param       pcm: 合成输出块 (播放任务独占)
+ */
+static void play_conceal(struct uart_audio *inst, uint16_t frames, uint16_t frame_samples, audio_block_t *pcm)
+{
+    const uint32_t chunk = FRAME_MAX_DATA_SIZE / sizeof(int16_t);
+    uint32_t samples = (uint32_t)frames * frame_samples;
+    
+    while (samples > 0) {
+        uint32_t n = samples < chunk ? samples : chunk;
+        if (audio_plc_conceal(&g_plc, (int16_t *)pcm->data, n, g_i2s_rate) == 0) {
+            return;     /* 尚无历史 (会话开头就丢帧): 交给混音器按欠载处理 */
+        }
+        track_playback(inst, n, g_i2s_rate);
+        audio_mixer_write_mono(MIXER_INPUT_STREAM, pcm->data, n, pdMS_TO_TICKS(AUDIO_PLAY_WRITE_TIMEOUT_MS));
+        samples -= n;
+    }
+    inst->stats.plc_frames += frames;
+}
+
+/**
+ * @brief       向播放任务补一条隐藏消息
+ */
+static void play_post_conceal(struct uart_audio *inst, uint16_t frames, uint16_t frame_samples)
+{
+    play_msg_t msg = {
+        .type = PLAY_MSG_CONCEAL,
+        .inst = inst,
+        .lost_frames = frames,
+        .frame_samples = frame_samples,
+    };
+    xQueueSend(g_play_queue, &msg, pdMS_TO_TICKS(AUDIO_PLAY_WRITE_TIMEOUT_MS));
+}
+
+/**
+ * @brief       取一个块装入一帧音频数据
+ * @note        数据在解码器拼帧块内时整块移交并给解码器换新块 (不复制);
+ *              块内还有待重新解析的数据 (校验出错后)、整帧位于本次读取内 (data 指向接收缓冲)
+ *              或来自校验重建时复制到新块
+ * @retval      装好数据的块, 缓冲池耗尽时为 NULL
+ */
+static audio_block_t *play_take_block(struct uart_audio *inst, const uint8_t *data, uint16_t len)
+{
+    audio_block_t *fresh = audio_pool_alloc(g_rx_pool, pdMS_TO_TICKS(AUDIO_PLAY_WRITE_TIMEOUT_MS));
+    audio_block_t *blk;
+    
+    if (!fresh) {
+        ESP_LOGW(TAG, "接收缓冲池耗尽, 丢弃 %u 字节音频", len);
+        inst->stats.play_drops++;
+        return NULL;
+    }
+    
+    uint8_t *base = inst->frame_blk->data;
+    if (data >= base && data + len <= base + FRAME_MAX_DATA_SIZE && frame_decoder_idle(&inst->decoder)) {
+        blk = inst->frame_blk;
+        blk->offset = (uint16_t)(data - base);
+        inst->frame_blk = fresh;
+        inst->decoder.buf = fresh->data;    /* 帧刚结束且没有待重新解析的数据, 可换缓冲 */
+    } else {
+        blk = fresh;
+        memcpy(blk->data, data, len);
+    }
+    blk->len = len;
+    return blk;
+}
+
+/**
+ * @brief       把装好数据的块交给播放任务
+ */
+static void play_post_block(struct uart_audio *inst, audio_block_t *blk)
+{
+    play_msg_t msg = {
+        .type = PLAY_MSG_DATA,
+        .block = blk,
+        .inst = inst,
+    };
+    if (xQueueSend(g_play_queue, &msg, pdMS_TO_TICKS(AUDIO_PLAY_WRITE_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "播放队列满, 丢弃 %u 字节音频", blk->len);
+        inst->stats.play_drops++;
+        audio_block_unref(blk);
+    }
+}
+
+/**
+ * @brief       把一帧音频数据交给播放任务
+ */
+static void play_post_data(struct uart_audio *inst, const uint8_t *data, uint16_t len)
+{
+    audio_block_t *blk = play_take_block(inst, data, len);
+    
+    if (blk) {
+        play_post_block(inst, blk);
+    }
+}
+
+/**
+ * @brief       结束等待校验帧: 先补上缺失的帧 (重建数据或隐藏), 再按顺序放出暂扣的帧
+ * @param       rebuilt: 重建的音频数据, NULL 表示重建失败改为隐藏
+ * @param       len: 重建数据长度, 0 表示缺失的不是播放数据 (全双工其他流) 无需补
+ */
+static void fec_release(struct uart_audio *inst, const uint8_t *rebuilt, uint16_t len)
+{
+    if (!g_fec_rx.hold) {
+        return;
+    }
+    if (!rebuilt) {
+        play_post_conceal(inst, 1, g_fec_rx.lost_samples);
+    } else if (len > 0) {
+        play_post_data(inst, rebuilt, len);
+    }
+    for (uint8_t i = 0; i < g_fec_rx.held_count; i++) {
+        play_post_block(inst, g_fec_rx.held[i]);
+    }
+    g_fec_rx.held_count = 0;
+    g_fec_rx.hold = false;
+}
+
+/**
+ * @brief       检查带序号音频帧的连续性
+ * @note        序号前跳 1..AUDIO_SEQ_MAX_GAP 帧时按本帧长度向播放任务补一条隐藏消息;
+ *              主机开启了前向纠错且只缺一帧时改为暂扣后续帧, 等校验帧重建;
+ *              更大的跳变 (主机重新计数或长时间中断) 只重新同步; 后跳 (重复/迟到) 的帧丢弃
+ * @param       bytes: 本帧音频字节数, 丢失的帧按同样长度估计
+ * @retval      true: 播放本帧; false: 丢弃
+ */
+static bool play_check_seq(struct uart_audio *inst, uint16_t seq, uint16_t bytes)
+{
+    uint16_t gap = seq - inst->play_seq;
+    
+    if (inst->play_seq_valid && gap > 0) {
+        if (gap >= 0x8000) {
+            inst->stats.seq_late++;
+            return false;
+        }
+        inst->stats.seq_lost += gap;
+        if (g_fec_rx.hold) {
+            fec_release(inst, NULL, 0);     /* 校验帧之前又丢帧: 前一帧已无法重建 */
+            inst->stats.fec_failed++;
+        }
+        if (gap == 1 && g_fec_rx.active) {
+            g_fec_rx.hold = true;
+            g_fec_rx.lost_seq = inst->play_seq;
+            g_fec_rx.lost_samples = bytes / 2;
+        } else if (gap <= AUDIO_SEQ_MAX_GAP) {
+            play_post_conceal(inst, gap, bytes / 2);
+        }
+    }
+    inst->play_seq = seq + 1;
+    inst->play_seq_valid = true;
+    return true;
+}
+
+/**
+ * @brief       接收一帧带序号的播放数据: 等待校验帧期间暂扣, 否则直接交给播放任务
+ * @note        暂扣满 AUDIO_FEC_MAX_GROUP 帧仍未等到校验帧时放弃重建, 改为隐藏
+ */
+static void play_accept(struct uart_audio *inst, const uint8_t *data, uint16_t len)
+{
+    if (!g_fec_rx.hold) {
+        play_post_data(inst, data, len);
+        return;
+    }
+    
+    audio_block_t *blk = play_take_block(inst, data, len);
+    if (blk) {
+        g_fec_rx.held[g_fec_rx.held_count++] = blk;
+    }
+    if (g_fec_rx.held_count >= AUDIO_FEC_MAX_GROUP) {
+        fec_release(inst, NULL, 0);
+        inst->stats.fec_failed++;
+    }
+}
+
+/**
+ * @brief       处理校验帧: 重建组内缺失的一帧
+ * @note        缺失的帧在组中间时后续帧已暂扣, 重建后补在它们前面; 缺失的是组内最后一帧时
+ *              (尚未被后续帧发现) 直接补上并前移期望序号
+ */
+static void play_recover(struct uart_audio *inst, const uint8_t *data, uint16_t len)
+{
+    uint16_t lost = 0, out_len = 0;
+    audio_fec_result_t result = audio_fec_recover(&g_fec_rx.fec, data, len, &lost, &out_len);
+    const uint8_t *rebuilt = g_fec_rx.fec.acc;
+    
+    g_fec_rx.active = true;
+    inst->stats.fec_parity++;
+    
+    if (result == AUDIO_FEC_REBUILT && g_mode == MODE_DUPLEX) {
+        /* 全双工重建的数据以流 ID 开头, 只补喇叭流 */
+        if (out_len > 1 && rebuilt[0] == STREAM_SPK) {
+            rebuilt++;
+            out_len--;
+        } else {
+            out_len = 0;
+        }
+    }
+    
+    if (result == AUDIO_FEC_REBUILT && g_fec_rx.hold && lost == g_fec_rx.lost_seq) {
+        fec_release(inst, rebuilt, out_len);
+        inst->stats.fec_recovered++;
+    } else if (result == AUDIO_FEC_REBUILT && !g_fec_rx.hold && inst->play_seq_valid && lost == inst->play_seq) {
+        inst->stats.seq_lost++;
+        inst->play_seq = lost + 1;
+        if (out_len > 0) {
+            play_post_data(inst, rebuilt, out_len);
+        }
+        inst->stats.fec_recovered++;
+    } else if (g_fec_rx.hold) {
+        fec_release(inst, NULL, 0);
+        inst->stats.fec_failed++;
+    }
+}
+
+/**
+ * @brief       解码一块 MP3 数据并写入混音器
+ * @param       pcm: 解码输出块 (播放任务独占)
+ */
+static void play_mp3(struct uart_audio *inst, const uint8_t *data, uint16_t len, audio_block_t *pcm)
+{
+    mp3_decoder_feed(g_decoder, data, len);
+    
+    /* 持续解码直到无法获取更多 PCM 数据 */
+    int decode_count = 0;
+    
+    while (decode_count < 3) {  /* 1024字节最多解码约2-3帧 */
+        int sample_rate = 0, channels = 0;
+        int samples = mp3_decoder_get_pcm(g_decoder, (int16_t *)pcm->data, 
+                                          FRAME_MAX_DATA_SIZE / sizeof(int16_t), 
+                                          &sample_rate, &channels);
+        
+        if (samples <= 0) {
+            break;  /* 没有更多解码数据 */
+        }
+        
+        decode_count++;
+        
+        /* 如果采样率变化，动态更新 I2S 配置 */
+        set_i2s_rate(sample_rate);
+        track_playback(inst, samples, sample_rate);
+        
+        /* 根据解码的声道数写入混音器 */
+        if (channels == 1) {
+            audio_mixer_write_mono(MIXER_INPUT_STREAM, pcm->data, samples,
+                                   pdMS_TO_TICKS(AUDIO_PLAY_WRITE_TIMEOUT_MS));
+        } else {
+            audio_mixer_write(MIXER_INPUT_STREAM, (const int16_t *)pcm->data, samples,
+                              pdMS_TO_TICKS(AUDIO_PLAY_WRITE_TIMEOUT_MS));
+        }
+    }
+    
+    /* 调试：每50帧打印一次 */
+    static uint32_t mp3_frame_count = 0;
+    mp3_frame_count++;
+    if (mp3_frame_count % 50 == 1) {
+        ESP_LOGI(TAG, "MP3数据包 #%lu: 输入%d字节", mp3_frame_count, len);
+    }
+}
+
+/**
+ * @brief       播放任务: 按顺序处理接收任务交来的音频块和曲目切换
+ * @note        解码和混音写入可能阻塞, 移出接收任务后命令帧不再排在音频后面等待
+ */
+static void play_task(void *arg)
+{
+    audio_block_t *pcm = audio_pool_alloc(g_pcm_pool, portMAX_DELAY);
+    play_msg_t msg;
+    
+    ESP_LOGI(TAG, "播放任务启动");
+    
+    while (1) {
+        if (xQueueReceive(g_play_queue, &msg, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if (msg.type == PLAY_MSG_SHUTDOWN) {
+            break;
+        }
+        
+        xSemaphoreTake(g_play_lock, portMAX_DELAY);
+        if (msg.type == PLAY_MSG_NEXT_TRACK && g_mode == MODE_PLAYING) {
+            switch_track_format(msg.format);
+            g_sample_rate = msg.rate;
+            if (g_audio_format == AUDIO_FORMAT_PCM) {
+                set_i2s_rate(msg.rate);
+            }
+            update_stream_target(g_audio_format == AUDIO_FORMAT_PCM);
+            audio_plc_reset(&g_plc);
+            ESP_LOGI(TAG, "下一曲目: %s, %lu Hz",
+                     g_audio_format == AUDIO_FORMAT_MP3 ? "MP3" : "PCM", (unsigned long)msg.rate);
+        } else if (msg.type == PLAY_MSG_CONCEAL) {
+            /* MP3 丢帧由解码器重新同步, 只隐藏 PCM */
+            if (g_mode == MODE_DUPLEX || (g_mode == MODE_PLAYING && g_audio_format == AUDIO_FORMAT_PCM)) {
+                play_conceal(msg.inst, msg.lost_frames, msg.frame_samples, pcm);
+            }
+        } else if (msg.type == PLAY_MSG_DATA) {
+            const uint8_t *data = msg.block->data + msg.block->offset;
+            if (g_mode == MODE_PLAYING && g_audio_format == AUDIO_FORMAT_MP3) {
+                play_mp3(msg.inst, data, msg.block->len, pcm);
+            } else if (g_mode == MODE_PLAYING || g_mode == MODE_DUPLEX) {
+                play_pcm(msg.inst, data, msg.block->len);
+            }
+        }
+        xSemaphoreGive(g_play_lock);
+        audio_block_unref(msg.block);
+    }
+    
+    audio_block_unref(pcm);
+    ESP_LOGI(TAG, "播放任务退出");
+    g_play_task_handle = NULL;
+    vTaskDelete(NULL);
 }
 
 /**
  * @brief       处理接收到的帧
+ * @note        模式和编解码器为所有实例共享: 任一实例可查询和停止,
+ *              音频数据和曲目切换只接受当前占用编解码器的实例
  */
-static void process_frame(uint8_t cmd, const uint8_t *data, uint16_t len)
+static void process_frame(struct uart_audio *inst, uint8_t cmd, const uint8_t *data, uint16_t len)
 {
+    bool owner = (inst == s_owner);
+    
     switch (cmd) {
         case CMD_START_RECORD:
             ESP_LOGI(TAG, "收到开始录音命令");
-            if (g_mode == MODE_IDLE) {
-                g_mode = MODE_RECORDING;
-                /* 配置ES8388为录音模式 (参考备份项目) */
-                es8388_adda_cfg(1, 1);      /* 打开DAC打开ADC */
-                es8388_input_cfg(0);        /* 打开输入通道0 */
-                es8388_mic_gain(8);         /* MIC增益设置为最大 (8 = 24dB) */
-                es8388_output_cfg(1, 1);    /* DAC选择通道输出 */
-                es8388_sai_cfg(0, 3);       /* 飞利浦标准,16位数据长度 */
-                i2s_trx_start();
-            }
-            /* 发送应答 */
-            uart_audio_send_frame(CMD_ACK, (uint8_t *)&cmd, 1);
+            /* 应答反映切换结果: 忙 (含其他链路占用编解码器)、非音频实例或等待超时时为 ACK_ERR_STATE */
+            if (ctrl_request(inst, AUDIO_EVT_START_RECORD, true) == ESP_OK &&
+                g_mode == MODE_RECORDING && s_owner == inst) {
+                send_ack(inst, cmd, ACK_OK);
+            } else {
+                send_ack(inst, cmd, ACK_ERR_STATE);
+            }
+            break;
+            
+        case CMD_STOP_RECORD:
+            ESP_LOGI(TAG, "收到停止录音命令");
+            if (ctrl_request(inst, AUDIO_EVT_STOP_RECORD, true) == ESP_OK && g_mode != MODE_RECORDING) {
+                send_ack(inst, cmd, ACK_OK);
+            } else {
+                send_ack(inst, cmd, ACK_ERR_STATE);
+            }
+            break;
+            
+        case CMD_START_PLAY:
+            ESP_LOGI(TAG, "收到开始播放命令, 格式: %s", 
+                     g_audio_format == AUDIO_FORMAT_MP3 ? "MP3" : "PCM");
+            if (ctrl_request(inst, AUDIO_EVT_START_PLAY, true) == ESP_OK &&
+                g_mode == MODE_PLAYING && s_owner == inst) {
+                send_ack(inst, cmd, ACK_OK);
+            } else {
+                send_ack(inst, cmd, ACK_ERR_STATE);
+            }
+            break;
+            
+        case CMD_STOP_PLAY:
+            ESP_LOGI(TAG, "收到停止播放命令");
+            if (ctrl_request(inst, AUDIO_EVT_STOP_PLAY, true) == ESP_OK && g_mode != MODE_PLAYING) {
+                send_ack(inst, cmd, ACK_OK);
+            } else {
+                send_ack(inst, cmd, ACK_ERR_STATE);
+            }
+            break;
+            
+        case CMD_START_DUPLEX:
+            /* 全双工共用一个采样率, 仅支持 PCM */
+            {
+                uint32_t rate = g_sample_rate;
+                if (len >= 4) {
+                    rate = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+                }
+                ESP_LOGI(TAG, "收到开始全双工命令, %lu Hz", (unsigned long)rate);
+                if (g_mode != MODE_IDLE || !inst->config.audio) {
+                    send_ack(inst, cmd, ACK_ERR_STATE);
+                } else if (!value_supported(s_sample_rates, sizeof(s_sample_rates) / sizeof(s_sample_rates[0]), rate)) {
+                    send_ack(inst, cmd, ACK_ERR_PARAM);
+                } else {
+                    g_sample_rate = rate;
+                    g_audio_format = AUDIO_FORMAT_PCM;
+                    ctrl_request(inst, AUDIO_EVT_START_DUPLEX, true);
+                    send_ack(inst, cmd, (g_mode == MODE_DUPLEX && s_owner == inst) ? ACK_OK : ACK_ERR_STATE);
+                }
+            }
+            break;
+            
+        case CMD_STOP_DUPLEX:
+            ESP_LOGI(TAG, "收到停止全双工命令");
+            if (ctrl_request(inst, AUDIO_EVT_STOP_DUPLEX, true) == ESP_OK && g_mode != MODE_DUPLEX) {
+                send_ack(inst, cmd, ACK_OK);
+            } else {
+                send_ack(inst, cmd, ACK_ERR_STATE);
+            }
+            break;
+            
+        case CMD_AUDIO_SEQ:
+            /* 带序号: 计入校验组, 检查连续性后交给播放任务 (等待校验帧期间暂扣) */
+            {
+                uint16_t head = (g_mode == MODE_DUPLEX) ? 3 : 2;      /* 序号 + 全双工流 ID */
+                if (len < head || !owner || (g_mode != MODE_PLAYING && g_mode != MODE_DUPLEX)) {
+                    break;
+                }
+                uint16_t seq = data[0] | (data[1] << 8);
+                data += 2;
+                len -= 2;
+                inst->stats.audio_bytes += len;
+                audio_fec_add(&g_fec_rx.fec, seq, NULL, 0, data, len);
+                if (g_mode == MODE_DUPLEX) {
+                    if (data[0] != STREAM_SPK) {
+                        break;
+                    }
+                    data++;
+                    len--;
+                }
+                if (len > 0 && play_check_seq(inst, seq, len)) {
+                    play_accept(inst, data, len);
+                }
+            }
+            break;
+            
+        case CMD_AUDIO_FEC:
+            if (owner && (g_mode == MODE_PLAYING || g_mode == MODE_DUPLEX)) {
+                play_recover(inst, data, len);
+            }
+            break;
+            
+        case CMD_SET_FEC:
+            if (len < 1 || data[0] == 1 || data[0] > AUDIO_FEC_MAX_GROUP) {
+                send_ack(inst, cmd, ACK_ERR_PARAM);
+            } else {
+                inst->fec_group = data[0];
+                ESP_LOGI(TAG, "发送前向纠错: %s%u 帧一组", data[0] ? "" : "关闭, ", data[0]);
+                send_ack(inst, cmd, ACK_OK);
+            }
             break;
             
-        case CMD_STOP_RECORD:
-            ESP_LOGI(TAG, "收到停止录音命令");
-            if (g_mode == MODE_RECORDING) {
-                g_mode = MODE_IDLE;
-                i2s_trx_stop();
+        case CMD_SET_AEC:
+            if (len < 1) {
+                send_ack(inst, cmd, ACK_ERR_PARAM);
+            } else if (g_mode != MODE_IDLE) {
+                send_ack(inst, cmd, ACK_ERR_STATE);
+            } else {
+                audio_aec_set_enabled(data[0] != 0);
+                ESP_LOGI(TAG, "回声消除: %s", data[0] ? "开启" : "关闭");
+                send_ack(inst, cmd, ACK_OK);
             }
-            uart_audio_send_frame(CMD_ACK, (uint8_t *)&cmd, 1);
             break;
             
-        case CMD_START_PLAY:
-            ESP_LOGI(TAG, "收到开始播放命令, 格式: %s", 
-                     g_audio_format == AUDIO_FORMAT_MP3 ? "MP3" : "PCM");
-            if (g_mode == MODE_IDLE) {
-                g_mode = MODE_PLAYING;
-                /* 开启喇叭功放 (低电平有效) */
-                xl9555_pin_write(SPK_EN_IO, 0);
-                /* 配置ES8388为播放模式 */
-                es8388_adda_cfg(1, 0);      /* DAC开启 */
-                es8388_output_cfg(1, 1);    /* 输出通道开启 */
-                es8388_sai_cfg(0, 3);       /* 设置I2S模式: 标准I2S, 16bit */
-                es8388_hpvol_set(30);       /* 设置耳机音量 */
-                es8388_spkvol_set(30);      /* 设置喇叭音量 */
-                i2s_trx_start();
-                
-                /* 如果是 MP3 格式，初始化解码器 */
-                if (g_audio_format == AUDIO_FORMAT_MP3) {
-                    mp3_decoder_init();
+        case CMD_AUDIO_DATA:
+            inst->stats.audio_bytes += len;
+            /* 播放模式下接收音频数据, 按指针交给播放任务 */
+            if (!owner) {
+                break;
+            }
+            if (g_mode == MODE_PLAYING && len > 0) {
+                play_post_data(inst, data, len);
+            } else if (g_mode == MODE_DUPLEX && len > 1 && data[0] == STREAM_SPK) {
+                /* 全双工: 只播放喇叭流, 其他流 ID 忽略 */
+                play_post_data(inst, data + 1, len - 1);
+            }
+            break;
+        
+        case CMD_SET_FORMAT:
+            /* 设置音频格式 [+ PCM 采样率] */
+            {
+                uint8_t status = ACK_OK;
+                if (len >= 1) {
+                    g_audio_format = (audio_format_t)data[0];
+                    ESP_LOGI(TAG, "设置音频格式: %s", 
+                             g_audio_format == AUDIO_FORMAT_MP3 ? "MP3" : "PCM");
+                }
+                if (len >= 5) {
+                    uint32_t rate = data[1] | (data[2] << 8) | (data[3] << 16) | ((uint32_t)data[4] << 24);
+                    if (g_mode != MODE_IDLE) {
+                        status = ACK_ERR_STATE;
+                    } else if (!value_supported(s_sample_rates, sizeof(s_sample_rates) / sizeof(s_sample_rates[0]), rate)) {
+                        ESP_LOGW(TAG, "不支持的采样率: %lu", (unsigned long)rate);
+                        status = ACK_ERR_PARAM;
+                    } else {
+                        g_sample_rate = rate;
+                        ESP_LOGI(TAG, "设置 PCM 采样率: %lu Hz", (unsigned long)rate);
+                    }
                 }
+                send_ack(inst, cmd, status);
             }
-            uart_audio_send_frame(CMD_ACK, (uint8_t *)&cmd, 1);
             break;
             
-        case CMD_STOP_PLAY:
-            ESP_LOGI(TAG, "收到停止播放命令");
-            if (g_mode == MODE_PLAYING) {
-                g_mode = MODE_IDLE;
-                i2s_trx_stop();
-                /* 关闭喇叭功放 (低电平有效) */
-                xl9555_pin_write(SPK_EN_IO, 1);
+        case CMD_NEXT_TRACK:
+            /* 无缝播放: 后续音频数据属于下一曲目 */
+            {
+                uint32_t rate = g_sample_rate;
+                if (len >= 5) {
+                    rate = data[1] | (data[2] << 8) | (data[3] << 16) | ((uint32_t)data[4] << 24);
+                }
+                if (g_mode != MODE_PLAYING || !owner) {
+                    send_ack(inst, cmd, ACK_ERR_STATE);
+                } else if (len < 1 || data[0] > AUDIO_FORMAT_MP3 ||
+                           !value_supported(s_sample_rates, sizeof(s_sample_rates) / sizeof(s_sample_rates[0]), rate)) {
+                    send_ack(inst, cmd, ACK_ERR_PARAM);
+                } else {
+                    /* 与音频块同一队列, 前一曲目的数据播完后才切换 */
+                    play_msg_t msg = {
+                        .type = PLAY_MSG_NEXT_TRACK,
+                        .format = (audio_format_t)data[0],
+                        .rate = rate,
+                        .inst = inst,
+                    };
+                    bool queued = xQueueSend(g_play_queue, &msg, pdMS_TO_TICKS(AUDIO_PLAY_WRITE_TIMEOUT_MS)) == pdTRUE;
+                    send_ack(inst, cmd, queued ? ACK_OK : ACK_ERR_STATE);
+                }
+            }
+            break;
+            
+        case CMD_GET_STATS:
+            {
+                mixer_stats_t mix;
+                audio_mixer_get_stats(&mix);
+                inst->stats.mix_blocks = mix.blocks;
+                inst->stats.mix_cycles_avg = mix.cycles_avg;
+                inst->stats.mix_cycles_max = mix.cycles_max;
+                for (int i = 0; i < AUDIO_MIXER_MAX_INPUTS; i++) {
+                    inst->stats.mix_underruns[i] = mix.inputs[i].underruns;
+                }
+                inst->stats.stream_drift_ppm = mix.inputs[MIXER_INPUT_STREAM].drift_ppm;
+                inst->stats.stream_level_ms = mix.inputs[MIXER_INPUT_STREAM].level * 1000 / g_i2s_rate;
+                inst->stats.stream_stretches = mix.inputs[MIXER_INPUT_STREAM].stretches;
+                inst->stats.stream_compressions = mix.inputs[MIXER_INPUT_STREAM].compressions;
+                inst->stats.tsm_cycles_max = mix.tsm_cycles_max;
+                inst->stats.pool_exhausted = audio_pool_total_exhausted();
+                inst->stats.heap_ops = audio_mem_guard_ops();
+                audio_aec_stats_t aec;
+                audio_aec_get_stats(&aec);
+                inst->stats.aec_taps = aec.taps;
+                inst->stats.aec_delay = aec.delay;
+                inst->stats.aec_erle_db = aec.erle_db;
+                inst->stats.aec_cycles_avg = aec.cycles_avg;
+                inst->stats.aec_cycles_max = aec.cycles_max;
+                inst->stats.aec_resets = aec.resets;
+                audio_pm_stats_t pm;
+                audio_pm_get_stats(&pm);
+                memcpy(inst->stats.pm_state_ms, pm.state_ms, sizeof(pm.state_ms));
+                inst->stats.pm_avg_current_ua = pm.avg_current_ua;
+                inst->stats.cpu_idle_pct[0] = pm.cpu_idle_pct[0];
+                inst->stats.cpu_idle_pct[1] = pm.cpu_idle_pct[1];
+                for (int i = 0; i < TX_LANE_COUNT; i++) {
+                    uint32_t n = inst->stats.tx_frames[i];
+                    inst->stats.tx_delay_avg_us[i] = n ? (uint32_t)(inst->tx_delay_total[i] / n) : 0;
+                }
                 
-                /* 释放 MP3 解码器 */
-                if (mp3_decoder_is_initialized()) {
-                    mp3_decoder_deinit();
+                uint8_t out[sizeof(link_stats_t)];
+                const uint32_t *fields = (const uint32_t *)&inst->stats;
+                for (size_t i = 0; i < sizeof(link_stats_t) / 4; i++) {
+                    out[i * 4] = fields[i] & 0xFF;
+                    out[i * 4 + 1] = (fields[i] >> 8) & 0xFF;
+                    out[i * 4 + 2] = (fields[i] >> 16) & 0xFF;
+                    out[i * 4 + 3] = (fields[i] >> 24) & 0xFF;
+                }
+                uart_audio_send(inst, CMD_STATS, out, sizeof(out));
+                if (len >= 1 && data[0]) {
+                    reset_link_stats(inst);
                 }
             }
-            /* 重置为 PCM 格式 */
-            g_audio_format = AUDIO_FORMAT_PCM;
-            uart_audio_send_frame(CMD_ACK, (uint8_t *)&cmd, 1);
             break;
             
-        case CMD_AUDIO_DATA:
-            /* 播放模式下接收音频数据 */
-            if (g_mode == MODE_PLAYING && len > 0 && g_audio_buf) {
-                if (g_audio_format == AUDIO_FORMAT_MP3) {
-                    /* MP3 格式：先解码再播放 */
-                    mp3_decoder_feed(data, len);
-                    
-                    /* 持续解码直到无法获取更多 PCM 数据 */
-                    static int last_sample_rate = 0;
-                    int decode_count = 0;
-                    
-                    while (decode_count < 3) {  /* 1024字节最多解码约2-3帧 */
-                        int sample_rate = 0, channels = 0;
-                        int samples = mp3_decoder_get_pcm((int16_t *)g_audio_buf, 
-                                                           FRAME_MAX_DATA_SIZE / sizeof(int16_t), 
-                                                           &sample_rate, &channels);
-                        
-                        if (samples <= 0) {
-                            break;  /* 没有更多解码数据 */
-                        }
-                        
-                        decode_count++;
-                        
-                        /* 如果采样率变化，动态更新 I2S 配置 */
-                        if (sample_rate > 0 && sample_rate != last_sample_rate) {
-                            ESP_LOGI(TAG, "设置 I2S 采样率: %d Hz", sample_rate);
-                            i2s_set_samplerate_bits_sample(sample_rate, 16);
-                            last_sample_rate = sample_rate;
-                        }
-                        
-                        /* 根据解码的声道数计算输出 */
-                        if (channels == 1) {
-                            /* 单声道转立体声 */
-                            int16_t *mono = (int16_t *)g_audio_buf;
-                            static int16_t stereo_buf[4096];
-                            for (int i = samples - 1; i >= 0; i--) {
-                                stereo_buf[i * 2] = mono[i];
-                                stereo_buf[i * 2 + 1] = mono[i];
-                            }
-                            i2s_tx_write((uint8_t *)stereo_buf, samples * 4);
-                        } else {
-                            /* 立体声直接输出 */
-                            size_t pcm_bytes = samples * channels * sizeof(int16_t);
-                            i2s_tx_write(g_audio_buf, pcm_bytes);
-                        }
-                    }
-                    
-                    /* 调试：每50帧打印一次 */
-                    static uint32_t mp3_frame_count = 0;
-                    mp3_frame_count++;
-                    if (mp3_frame_count % 50 == 1) {
-                        ESP_LOGI(TAG, "MP3数据包 #%lu: 输入%d字节", mp3_frame_count, len);
-                    }
+        case CMD_SET_TUNING:
+            {
+                uint16_t frame = (len >= 2) ? (uint16_t)(data[0] | (data[1] << 8)) : 0;
+                if (g_mode != MODE_IDLE) {
+                    send_ack(inst, cmd, ACK_ERR_STATE);
+                } else if (frame < AUDIO_FRAME_SIZE_MIN || frame > AUDIO_FRAME_SIZE_MAX || (frame & 1)) {
+                    send_ack(inst, cmd, ACK_ERR_PARAM);
                 } else {
-                    /* PCM 格式：直接播放 */
-                    /* 输入：单声道16bit PCM，每个采样2字节 */
-                    /* 输出：立体声16bit PCM，每个采样4字节（左右声道相同） */
-                    int16_t *mono_data = (int16_t *)data;
-                    int16_t *stereo_data = (int16_t *)g_audio_buf;
-                    uint16_t samples = len / 2;  /* 单声道采样数 */
-                    
-                    for (uint16_t i = 0; i < samples; i++) {
-                        stereo_data[i * 2] = mono_data[i];      /* 左声道 */
-                        stereo_data[i * 2 + 1] = mono_data[i];  /* 右声道 */
-                    }
-                    
-                    /* 写入I2S，立体声数据长度是单声道的2倍 */
-                    size_t written = i2s_tx_write(g_audio_buf, len * 2);
-                    
-                    /* 调试：每100帧打印一次 */
-                    static uint32_t frame_count = 0;
-                    frame_count++;
-                    if (frame_count % 100 == 1) {
-                        ESP_LOGI(TAG, "PCM帧 #%lu: 输入%d字节, I2S写入%d字节", 
-                                 frame_count, len, (int)written);
-                    }
+                    g_record_frame = frame;
+                    ESP_LOGI(TAG, "录音帧大小: %u 字节", frame);
+                    send_ack(inst, cmd, ACK_OK);
                 }
             }
             break;
-        
-        case CMD_SET_FORMAT:
-            /* 设置音频格式 */
-            if (len >= 1) {
-                g_audio_format = (audio_format_t)data[0];
-                ESP_LOGI(TAG, "设置音频格式: %s", 
-                         g_audio_format == AUDIO_FORMAT_MP3 ? "MP3" : "PCM");
+            
+        case CMD_GET_CAPS:
+            {
+                uint8_t caps[128];
+                size_t caps_len = build_capabilities(inst, caps, sizeof(caps));
+                uart_audio_send(inst, CMD_CAPS, caps, caps_len);
+            }
+            break;
+            
+        case CMD_SET_LINK:
+            {
+                uint32_t baud = 0;
+                if (len >= 4) {
+                    baud = data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+                }
+                if (g_mode != MODE_IDLE) {
+                    send_ack(inst, cmd, ACK_ERR_STATE);
+                } else if (!value_supported(s_baud_rates, sizeof(s_baud_rates) / sizeof(s_baud_rates[0]), baud)) {
+                    ESP_LOGW(TAG, "不支持的波特率: %lu", (unsigned long)baud);
+                    send_ack(inst, cmd, ACK_ERR_PARAM);
+                } else {
+                    send_ack(inst, cmd, ACK_OK);
+                    set_link_baud(inst, baud);
+                }
             }
-            uart_audio_send_frame(CMD_ACK, (uint8_t *)&cmd, 1);
             break;
             
         case CMD_HANDSHAKE:
             ESP_LOGI(TAG, "收到握手命令");
             {
                 uint8_t status = (uint8_t)g_mode;
-                uart_audio_send_frame(CMD_ACK, &status, 1);
+                uart_audio_send(inst, CMD_ACK, &status, 1);
             }
             break;
             
@@ -266,208 +1507,521 @@ static void process_frame(uint8_t cmd, const uint8_t *data, uint16_t len)
 }
 
 /**
- * @brief       串口接收任务 (优化版：批量读取)
+ * @brief       串口接收任务 (批量读取, 由 frame_codec 增量解码)
+ * @param       arg: 所属实例
  */
 static void uart_rx_task(void *arg)
 {
-    parse_state_t state = PARSE_HEADER_0;
-    uint8_t cmd = 0;
-    uint16_t data_len = 0;
-    uint16_t data_idx = 0;
-    static uint8_t frame_data[FRAME_MAX_DATA_SIZE];
-    uint8_t checksum_calc = 0;
+    struct uart_audio *inst = arg;
+    uart_port_t uart_num = inst->config.uart_num;
+    uint8_t rx_buf[256];
+    frame_decoder_t *decoder = &inst->decoder;
+    frame_view_t frame;
     
-    /* 批量读取缓冲区 */
-    static uint8_t rx_buf[256];
-    int buf_idx = 0;
-    int buf_len = 0;
+    /* 任务重启时丢弃未拼完的帧 */
+    frame_decoder_init(decoder, inst->frame_blk->data, FRAME_MAX_DATA_SIZE);
     
-    ESP_LOGI(TAG, "串口接收任务启动 (批量读取模式)");
+    ESP_LOGI(TAG, "UART%d 接收任务启动 (批量读取模式)", uart_num);
     
-    while (g_running) {
-        /* 如果缓冲区已处理完，读取新数据 */
-        if (buf_idx >= buf_len) {
-            buf_len = uart_read_bytes(g_uart_num, rx_buf, sizeof(rx_buf), pdMS_TO_TICKS(10));
-            buf_idx = 0;
-            if (buf_len <= 0) {
-                buf_len = 0;
-                continue;
+    while (inst->running) {
+        /* 切换波特率后主机未能以新波特率通信，回退到原波特率 */
+        if (inst->link_probation && (int32_t)(xTaskGetTickCount() - inst->link_deadline) >= 0) {
+            ESP_LOGW(TAG, "UART%d 新波特率无有效数据, 回退到 %lu", uart_num, (unsigned long)inst->prev_baud_rate);
+            tx_set_baud(inst, inst->prev_baud_rate);
+            inst->baud_rate = inst->prev_baud_rate;
+            inst->link_probation = false;
+        }
+        
+        /* 缓冲区为空时阻塞等待驱动事件, 不再定时轮询 (空闲时 CPU 可降频/睡眠);
+         * 试用期内最多等到回退期限 */
+        size_t pending = 0;
+        uart_get_buffered_data_len(uart_num, &pending);
+        if (pending == 0) {
+            TickType_t wait = portMAX_DELAY;
+            if (inst->link_probation) {
+                int32_t left = (int32_t)(inst->link_deadline - xTaskGetTickCount());
+                wait = left > 0 ? (TickType_t)left : 0;
             }
+            uart_event_t event;
+            xQueueReceive(inst->uart_events, &event, wait);
+            continue;
+        }
+        
+        int buf_len = uart_read_bytes(uart_num, rx_buf, sizeof(rx_buf), 0);
+        if (buf_len <= 0) {
+            continue;
+        }
+        
+        /* 记录接收缓冲区最高占用 (本次读出的 + 仍在缓冲区中的) */
+        size_t buffered = 0;
+        uart_get_buffered_data_len(uart_num, &buffered);
+        if (buffered + buf_len > inst->stats.rx_high_water) {
+            inst->stats.rx_high_water = buffered + buf_len;
         }
         
-        /* 处理缓冲区中的数据 */
-        while (buf_idx < buf_len) {
-            uint8_t byte = rx_buf[buf_idx++];
+        const uint8_t *p = rx_buf;
+        size_t remain = (size_t)buf_len;
+        
+        while (remain > 0) {
+            size_t consumed = 0;
+            frame_decode_status_t status = frame_decoder_feed(decoder, p, remain, &consumed, &frame);
+            p += consumed;
+            remain -= consumed;
             
-            switch (state) {
-                case PARSE_HEADER_0:
-                    if (byte == FRAME_HEADER_0) {
-                        state = PARSE_HEADER_1;
-                    }
-                    break;
-                    
-                case PARSE_HEADER_1:
-                    if (byte == FRAME_HEADER_1) {
-                        state = PARSE_CMD;
-                    } else {
-                        state = PARSE_HEADER_0;
-                    }
-                    break;
-                    
-                case PARSE_CMD:
-                    cmd = byte;
-                    checksum_calc = byte;
-                    state = PARSE_LEN_L;
-                    break;
-                    
-                case PARSE_LEN_L:
-                    data_len = byte;
-                    checksum_calc ^= byte;
-                    state = PARSE_LEN_H;
+            inst->stats.frames = decoder->stats.frames;
+            inst->stats.checksum_errors = decoder->stats.checksum_errors;
+            inst->stats.length_errors = decoder->stats.length_errors;
+            
+            switch (status) {
+                case FRAME_DECODE_OK:
+                    inst->link_probation = false;
+                    audio_pm_link_activity();
+                    process_frame(inst, frame.cmd, frame.data, frame.len);
                     break;
                     
-                case PARSE_LEN_H:
-                    data_len |= (byte << 8);
-                    checksum_calc ^= byte;
-                    data_idx = 0;
-                    if (data_len > 0 && data_len <= FRAME_MAX_DATA_SIZE) {
-                        state = PARSE_DATA;
-                    } else if (data_len == 0) {
-                        state = PARSE_CHECKSUM;
-                    } else {
-                        ESP_LOGW(TAG, "数据长度无效: %d", data_len);
-                        state = PARSE_HEADER_0;
-                    }
+                case FRAME_DECODE_BAD_CHECKSUM:
+                    ESP_LOGW(TAG, "UART%d 校验和错误: 期望0x%02X, 收到0x%02X", 
+                             uart_num, decoder->checksum, decoder->rx_checksum);
                     break;
                     
-                case PARSE_DATA:
-                    frame_data[data_idx++] = byte;
-                    checksum_calc ^= byte;
-                    if (data_idx >= data_len) {
-                        state = PARSE_CHECKSUM;
-                    }
+                case FRAME_DECODE_BAD_LENGTH:
+                    ESP_LOGW(TAG, "UART%d 数据长度无效: %d", uart_num, decoder->len);
                     break;
                     
-                case PARSE_CHECKSUM:
-                    if (byte == checksum_calc) {
-                        process_frame(cmd, frame_data, data_len);
-                    } else {
-                        ESP_LOGW(TAG, "校验和错误: 期望0x%02X, 收到0x%02X", checksum_calc, byte);
-                    }
-                    state = PARSE_HEADER_0;
+                default:
                     break;
             }
         }
     }
     
-    ESP_LOGI(TAG, "串口接收任务退出");
+    ESP_LOGI(TAG, "UART%d 接收任务退出", uart_num);
+    inst->rx_task = NULL;
     vTaskDelete(NULL);
 }
 
+/**
+ * @brief       启动实例的接收任务 (已运行则忽略)
+ */
+static esp_err_t rx_task_start(struct uart_audio *inst)
+{
+    char name[configMAX_TASK_NAME_LEN];
+    
+    if (inst->rx_task) {
+        return ESP_OK;
+    }
+    
+    snprintf(name, sizeof(name), "uart_rx%d", inst->config.uart_num);
+    inst->running = true;
+    if (xTaskCreatePinnedToCore(uart_rx_task, name, inst->config.rx_task_stack, inst,
+                                inst->config.rx_task_priority, &inst->rx_task,
+                                inst->config.rx_task_core) != pdPASS) {
+        inst->running = false;
+        inst->rx_task = NULL;
+        ESP_LOGE(TAG, "UART%d 接收任务创建失败", inst->config.uart_num);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+/**
+ * @brief       停止实例的接收任务并等待其退出
+ */
+static void rx_task_stop(struct uart_audio *inst)
+{
+    uart_event_t wake = {.type = UART_EVENT_MAX};
+    
+    inst->running = false;
+    if (inst->rx_task) {
+        xQueueSendToFront(inst->uart_events, &wake, 0);    /* 唤醒阻塞在事件队列上的接收任务 */
+    }
+    for (int i = 0; inst->rx_task && i < 50; i++) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
 /**
  * @brief       录音任务
  */
 static void record_task(void *arg)
 {
-    /* 增大缓冲区以减少串口发送次数，降低数据丢失 */
-    #define RECORD_BUF_SIZE  2048  /* 每次读取的立体声数据大小 */
-    
-    uint8_t *buf = heap_caps_malloc(RECORD_BUF_SIZE, MALLOC_CAP_DMA);
-    if (!buf) {
+    /* 每次读取一帧 (立体声 → 单声道后正好 g_record_frame)，默认采集延迟 32ms@8kHz */
+    /* I2S DMA 共 16x512 帧缓冲，小块读取不会丢数据 */
+    audio_block_t *blk = audio_pool_alloc(g_dma_pool, 0);
+    if (!blk) {
         ESP_LOGE(TAG, "录音缓冲区分配失败");
+        g_record_task_handle = NULL;
         vTaskDelete(NULL);
         return;
     }
+    uint8_t *buf = blk->data;
     
     ESP_LOGI(TAG, "录音任务启动");
     
     while (g_running) {
-        if (g_mode == MODE_RECORDING) {
-            /* 从I2S读取音频数据 (立体声: 左右声道交替) */
-            size_t bytes_read = i2s_rx_read(buf, RECORD_BUF_SIZE);
-            if (bytes_read > 0) {
-                /* 将立体声转换为单声道（取左右声道平均值） */
-                int16_t *stereo = (int16_t *)buf;
-                int16_t *mono = (int16_t *)buf;  /* 原地转换 */
-                size_t stereo_samples = bytes_read / sizeof(int16_t) / 2;
-                
-                for (size_t i = 0; i < stereo_samples; i++) {
-                    mono[i] = (stereo[i * 2] + stereo[i * 2 + 1]) / 2;
-                }
-                
-                size_t mono_bytes = stereo_samples * sizeof(int16_t);
-                
-                /* 分包发送以避免单包过大 */
-                size_t offset = 0;
-                while (offset < mono_bytes) {
-                    size_t chunk = (mono_bytes - offset > 512) ? 512 : (mono_bytes - offset);
-                    uart_audio_send_frame(CMD_AUDIO_DATA, buf + offset, chunk);
-                    offset += chunk;
+        /* 阻塞等待进入录音模式 (或模块停止), 不再轮询 */
+        EventBits_t bits = xEventGroupWaitBits(g_mode_events,
+                                               AUDIO_MODE_BIT(MODE_RECORDING) | AUDIO_MODE_BIT(MODE_DUPLEX) | AUDIO_STOP_BIT,
+                                               pdFALSE, pdFALSE, portMAX_DELAY);
+        if (bits & AUDIO_STOP_BIT) {
+            break;
+        }
+        
+        /* 从I2S读取音频数据 (立体声: 左右声道交替) */
+        uint16_t frame_size = g_record_frame;
+        size_t bytes_read = i2s_rx_read(buf, frame_size * 2);
+        if (bytes_read > 0) {
+            /* 将立体声转换为单声道（取左右声道平均值） */
+            int16_t *stereo = (int16_t *)buf;
+            int16_t *mono = (int16_t *)buf;  /* 原地转换 */
+            size_t stereo_samples = bytes_read / sizeof(int16_t) / 2;
+            
+            for (size_t i = 0; i < stereo_samples; i++) {
+                mono[i] = (stereo[i * 2] + stereo[i * 2 + 1]) / 2;
+            }
+            
+            /* 全双工: 减去喇叭回声 (本任务在核 1, 与混音任务交替运行) */
+            if (bits & AUDIO_MODE_BIT(MODE_DUPLEX)) {
+                audio_aec_process(mono, stereo_samples);
+            }
+            
+            size_t mono_bytes = stereo_samples * sizeof(int16_t);
+            
+            /* 分包发送以避免单包过大 */
+            size_t offset = 0;
+            struct uart_audio *owner = s_owner;    /* 录音数据发往开始录音的实例 */
+            const uint8_t mic = STREAM_MIC;
+            while (owner && offset < mono_bytes) {
+                size_t chunk = (mono_bytes - offset > frame_size) ? frame_size : (mono_bytes - offset);
+                if (!(bits & AUDIO_MODE_BIT(MODE_DUPLEX))) {
+                    send_audio(owner, NULL, buf + offset, chunk, pdMS_TO_TICKS(AUDIO_TX_TIMEOUT_MS));
+                } else if (send_audio(owner, &mic, buf + offset, chunk, 0)) {
+                    owner->stats.mic_frames++;
+                } else {
+                    owner->stats.mic_drops++;
                 }
+                offset += chunk;
             }
-        } else {
-            vTaskDelay(pdMS_TO_TICKS(10));
         }
     }
     
-    free(buf);
+    audio_block_unref(blk);
     ESP_LOGI(TAG, "录音任务退出");
     vTaskDelete(NULL);
 }
 
 /**
- * @brief       初始化串口音频模块
+ * @brief       初始化共享部分 (控制队列与模式事件组), 创建第一个实例时调用
+ */
+static esp_err_t audio_core_init(void)
+{
+    if (g_ctrl_queue) {
+        return ESP_OK;
+    }
+    
+    /* 控制事件队列与模式事件组 */
+    g_ctrl_queue = xQueueCreate(AUDIO_CTRL_QUEUE_LEN, sizeof(ctrl_request_t));
+    g_mode_events = xEventGroupCreate();
+    if (!g_ctrl_queue || !g_mode_events) {
+        ESP_LOGE(TAG, "控制队列创建失败");
+        return ESP_ERR_NO_MEM;
+    }
+    xEventGroupSetBits(g_mode_events, AUDIO_MODE_BIT(MODE_IDLE));
+    
+    /* 播放队列: 接收任务把音频块交给播放任务, 退出播放时控制任务持锁清空;
+     * 深度 (预取块数) 按内存计划, 有 PSRAM 时加深 */
+    const audio_mem_plan_t *plan = audio_mem_get_plan();
+    g_play_queue = xQueueCreate(plan->play_queue_len, sizeof(play_msg_t));
+    g_play_lock = xSemaphoreCreateMutex();
+    if (!g_play_queue || !g_play_lock) {
+        ESP_LOGE(TAG, "播放队列创建失败");
+        return ESP_ERR_NO_MEM;
+    }
+    
+    /* 缓冲池: 每个实例一个帧块, 播放队列中的块, 播放任务正在处理的块;
+     * 解码输出与录音各一块 (立体声, 2 倍帧长)。接收块只经 CPU 访问, 可放 PSRAM;
+     * 录音块由 I2S DMA 写入, 固定在内部 RAM */
+    esp_err_t ret = audio_pool_create("rx", AUDIO_MEM_PSRAM, FRAME_MAX_DATA_SIZE,
+                                      UART_AUDIO_MAX_INSTANCES + plan->play_queue_len + 1 + AUDIO_FEC_MAX_GROUP,
+                                      &g_rx_pool);
+    if (ret == ESP_OK) {
+        ret = audio_pool_create("pcm", AUDIO_MEM_INTERNAL, FRAME_MAX_DATA_SIZE * 2, 1, &g_pcm_pool);
+    }
+    if (ret == ESP_OK) {
+        ret = audio_pool_create("record", AUDIO_MEM_DMA, FRAME_MAX_DATA_SIZE * 2, 1, &g_dma_pool);
+    }
+    
+    /* 发送帧: 控制通道的小帧用内部 RAM 小块; 音频帧按完整帧分配, 每个实例多一块给正在写入的帧 */
+    if (ret == ESP_OK) {
+        ret = audio_pool_create("tx_ctrl", AUDIO_MEM_INTERNAL, AUDIO_TX_CTRL_BLOCK,
+                                UART_AUDIO_MAX_INSTANCES * (AUDIO_TX_CTRL_QUEUE_LEN + 1), &g_tx_ctrl_pool);
+    }
+    if (ret == ESP_OK) {
+        ret = audio_pool_create("tx_bulk", AUDIO_MEM_PSRAM, FRAME_OVERHEAD + 1 + FRAME_MAX_DATA_SIZE,
+                                UART_AUDIO_MAX_INSTANCES * (AUDIO_TX_BULK_QUEUE_LEN + 1), &g_tx_bulk_pool);
+    }
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    /* 前向纠错的异或累加 (接收/发送各一组, 容纳带流 ID 的最长帧) */
+    uint8_t *fec_rx_buf = audio_mem_alloc("fec_rx", AUDIO_MEM_PSRAM, FRAME_MAX_DATA_SIZE + 1);
+    uint8_t *fec_tx_buf = audio_mem_alloc("fec_tx", AUDIO_MEM_PSRAM, FRAME_MAX_DATA_SIZE + 1);
+    if (!fec_rx_buf || !fec_tx_buf) {
+        ESP_LOGE(TAG, "前向纠错缓冲分配失败");
+        return ESP_ERR_NO_MEM;
+    }
+    audio_fec_init(&g_fec_rx.fec, fec_rx_buf, FRAME_MAX_DATA_SIZE + 1);
+    audio_fec_init(&g_fec_tx, fec_tx_buf, FRAME_MAX_DATA_SIZE + 1);
+    
+    /* 回声消除的发送参考环形缓冲 */
+    ret = audio_aec_init();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    
+    /* MP3 解码器启动时创建一次, 各会话/曲目只复位, 流路径不再分配内存 */
+    if (mp3_decoder_create(NULL, &g_decoder) != ESP_OK) {
+        ESP_LOGW(TAG, "MP3 解码器创建失败, 仅支持 PCM 播放");
+        g_decoder = NULL;
+    }
+    
+    /* 播放输出经混音器, 由混音任务统一写入 I2S */
+    return audio_mixer_init();
+}
+
+/**
+ * @brief       释放实例资源 (驱动未安装时 installed 为 false)
+ */
+static void instance_free(struct uart_audio *inst, bool installed)
+{
+    /* 发送任务丢弃未发送的帧后退出, 再删除驱动 */
+    if (inst->tx_task) {
+        tx_item_t item = {0};
+        xQueueSend(inst->tx_queue[TX_LANE_CTRL], &item, portMAX_DELAY);
+        xTaskNotifyGive(inst->tx_task);
+        for (int i = 0; inst->tx_task && i < 50; i++) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+    }
+    for (int lane = 0; lane < TX_LANE_COUNT; lane++) {
+        if (inst->tx_queue[lane]) {
+            vQueueDelete(inst->tx_queue[lane]);
+        }
+    }
+    if (installed) {
+        uart_driver_delete(inst->config.uart_num);
+    }
+    audio_block_unref(inst->frame_blk);
+    free(inst);
+}
+
+/**
+ * @brief       初始化串口音频模块 (创建默认实例)
  */
 esp_err_t uart_audio_init(uart_port_t uart_num, int tx_pin, int rx_pin)
+{
+    uart_audio_config_t config = UART_AUDIO_DEFAULT_CONFIG(uart_num, tx_pin, rx_pin);
+    uart_audio_handle_t handle;
+    
+    return uart_audio_create(&config, &handle);
+}
+
+/**
+ * @brief       创建串口音频实例
+ */
+esp_err_t uart_audio_create(const uart_audio_config_t *config, uart_audio_handle_t *out)
 {
     esp_err_t ret = ESP_OK;
+    int slot = -1;
+    
+    if (!config || !out || config->uart_num >= UART_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    
+    for (int i = 0; i < UART_AUDIO_MAX_INSTANCES; i++) {
+        if (s_instances[i] && s_instances[i]->config.uart_num == config->uart_num) {
+            ESP_LOGE(TAG, "UART%d 已被实例占用", config->uart_num);
+            return ESP_ERR_INVALID_ARG;
+        }
+        if (!s_instances[i] && slot < 0) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        ESP_LOGE(TAG, "实例数已达上限 %d", UART_AUDIO_MAX_INSTANCES);
+        return ESP_ERR_NO_MEM;
+    }
+    
+    ret = audio_core_init();
+    if (ret != ESP_OK) {
+        return ret;
+    }
     
-    g_uart_num = uart_num;
+    struct uart_audio *inst = calloc(1, sizeof(*inst));
+    if (!inst) {
+        return ESP_ERR_NO_MEM;
+    }
+    inst->config = *config;
     
     /* 串口配置 */
     uart_config_t uart_config = {
-        .baud_rate = UART_AUDIO_BAUD_RATE,
+        .baud_rate = config->baud_rate,
         .data_bits = UART_DATA_8_BITS,
         .parity = UART_PARITY_DISABLE,
         .stop_bits = UART_STOP_BITS_1,
         .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
-        .source_clk = UART_SCLK_DEFAULT,
+        .source_clk = UART_SCLK_XTAL,   /* 不随 APB 动态调频变化, 浅睡眠唤醒后波特率不变 */
     };
     
-    ret = uart_param_config(uart_num, &uart_config);
+    ret = uart_param_config(config->uart_num, &uart_config);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "串口参数配置失败");
+        instance_free(inst, false);
         return ret;
     }
     
     /* 设置引脚 */
-    if (tx_pin >= 0 || rx_pin >= 0) {
-        ret = uart_set_pin(uart_num, tx_pin, rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    if (config->tx_pin >= 0 || config->rx_pin >= 0) {
+        ret = uart_set_pin(config->uart_num, config->tx_pin, config->rx_pin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
         if (ret != ESP_OK) {
             ESP_LOGE(TAG, "串口引脚配置失败");
+            instance_free(inst, false);
             return ret;
         }
     }
     
     /* 安装驱动 */
-    ret = uart_driver_install(uart_num, UART_BUF_SIZE * 2, UART_BUF_SIZE * 2, 0, NULL, 0);
+    ret = uart_driver_install(config->uart_num, config->rx_buf_size, config->tx_buf_size,
+                              AUDIO_UART_EVENT_QUEUE_LEN, &inst->uart_events, 0);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "串口驱动安装失败");
+        instance_free(inst, false);
         return ret;
     }
     
-    /* 分配音频缓冲区（2倍大小，用于单声道转立体声） */
-    g_audio_buf = heap_caps_malloc(FRAME_MAX_DATA_SIZE * 2, MALLOC_CAP_DMA);
-    if (!g_audio_buf) {
-        ESP_LOGE(TAG, "音频缓冲区分配失败");
+    /* 链路空闲进入浅睡眠后, 主机发来的数据可唤醒芯片 */
+    audio_pm_enable_uart_wakeup(config->uart_num);
+    
+    /* 帧解码缓冲取自接收缓冲池, 音频帧整块移交后再换新块 */
+    inst->frame_blk = audio_pool_alloc(g_rx_pool, 0);
+    if (!inst->frame_blk) {
+        ESP_LOGE(TAG, "接收缓冲池已空");
+        instance_free(inst, true);
+        return ESP_ERR_NO_MEM;
+    }
+    
+    inst->baud_rate = config->baud_rate;
+    inst->prev_baud_rate = config->baud_rate;
+    reset_link_stats(inst);
+    
+    /* 发送任务随实例存在 (未启动接收也可发送), 优先级高于接收任务, 应答不排在解析之后 */
+    char name[configMAX_TASK_NAME_LEN];
+    snprintf(name, sizeof(name), "uart_tx%d", config->uart_num);
+    inst->tx_queue[TX_LANE_CTRL] = xQueueCreate(AUDIO_TX_CTRL_QUEUE_LEN, sizeof(tx_item_t));
+    inst->tx_queue[TX_LANE_BULK] = xQueueCreate(AUDIO_TX_BULK_QUEUE_LEN, sizeof(tx_item_t));
+    if (!inst->tx_queue[TX_LANE_CTRL] || !inst->tx_queue[TX_LANE_BULK] ||
+        xTaskCreatePinnedToCore(tx_task, name, AUDIO_TX_TASK_STACK, inst, config->rx_task_priority + 1,
+                                &inst->tx_task, config->rx_task_core) != pdPASS) {
+        ESP_LOGE(TAG, "UART%d 发送任务创建失败", config->uart_num);
+        inst->tx_task = NULL;
+        instance_free(inst, true);
         return ESP_ERR_NO_MEM;
     }
     
-    ESP_LOGI(TAG, "串口音频模块初始化完成, UART%d, 波特率: %d", uart_num, UART_AUDIO_BAUD_RATE);
+    /* 模块已启动时立即开始接收 */
+    if (g_running) {
+        ret = rx_task_start(inst);
+        if (ret != ESP_OK) {
+            instance_free(inst, true);
+            return ret;
+        }
+    }
+    
+    s_instances[slot] = inst;
+    if (!s_default) {
+        s_default = inst;
+    }
+    *out = inst;
+    
+    ESP_LOGI(TAG, "串口音频实例创建完成, UART%d, 波特率: %lu%s", config->uart_num,
+             (unsigned long)config->baud_rate, config->audio ? "" : " (仅控制)");
+    
+    return ESP_OK;
+}
+
+/**
+ * @brief       删除串口音频实例
+ */
+esp_err_t uart_audio_delete(uart_audio_handle_t inst)
+{
+    if (!inst) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (inst == s_default) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    /* 占用编解码器时先返回空闲, 并等待录音任务发完当前帧 */
+    if (inst == s_owner) {
+        ctrl_request(inst, AUDIO_EVT_IDLE, true);
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    rx_task_stop(inst);
+    
+    for (int i = 0; i < UART_AUDIO_MAX_INSTANCES; i++) {
+        if (s_instances[i] == inst) {
+            s_instances[i] = NULL;
+        }
+    }
+    ESP_LOGI(TAG, "串口音频实例删除, UART%d", inst->config.uart_num);
+    instance_free(inst, true);
     
     return ESP_OK;
 }
 
+/**
+ * @brief       获取默认实例
+ */
+uart_audio_handle_t uart_audio_get_default(void)
+{
+    return s_default;
+}
+
+/**
+ * @brief       查询实例资源占用
+ */
+void uart_audio_get_info(uart_audio_handle_t inst, uart_audio_info_t *info)
+{
+    memset(info, 0, sizeof(*info));
+    if (!inst) {
+        return;
+    }
+    
+    info->uart_num = inst->config.uart_num;
+    info->baud_rate = inst->baud_rate;
+    info->mem_bytes = sizeof(*inst) + inst->config.rx_buf_size + inst->config.tx_buf_size +
+                      inst->config.rx_task_stack + AUDIO_TX_TASK_STACK;
+    
+    TaskHandle_t task = inst->rx_task;
+    if (task) {
+        info->rx_stack_free = uxTaskGetStackHighWaterMark(task);
+    }
+    info->rx_task_core = inst->config.rx_task_core;
+    info->audio_owner = (inst == s_owner);
+}
+
+/**
+ * @brief       读取实例链路统计
+ */
+void uart_audio_get_stats(uart_audio_handle_t inst, link_stats_t *stats)
+{
+    if (inst) {
+        *stats = inst->stats;
+    } else {
+        memset(stats, 0, sizeof(*stats));
+    }
+}
+
 /**
  * @brief       启动音频处理任务
  */
@@ -476,16 +2030,31 @@ esp_err_t uart_audio_start(void)
     if (g_running) {
         return ESP_OK;
     }
+    if (!g_mode_events) {
+        return ESP_ERR_INVALID_STATE;
+    }
     
     g_running = true;
+    xEventGroupClearBits(g_mode_events, AUDIO_STOP_BIT);
+    
+    /* 创建控制任务 (优先级高于收发任务, 切换延迟有界) */
+    xTaskCreatePinnedToCore(ctrl_task, "audio_ctrl", 3072, NULL, 11, &g_ctrl_task_handle, 0);
+    
+    /* 创建各实例的串口接收任务 (核与优先级按实例配置) */
+    for (int i = 0; i < UART_AUDIO_MAX_INSTANCES; i++) {
+        if (s_instances[i]) {
+            rx_task_start(s_instances[i]);
+        }
+    }
     
-    /* 创建串口接收任务 */
-    xTaskCreatePinnedToCore(uart_rx_task, "uart_rx", 4096, NULL, 10, &g_rx_task_handle, 0);
+    /* 创建播放任务 (解码/写混音器, 与接收任务分离, 接收不被解码阻塞) */
+    xTaskCreatePinnedToCore(play_task, "play", 6144, NULL, 9, &g_play_task_handle, 0);
     
     /* 创建录音任务 */
     xTaskCreatePinnedToCore(record_task, "record", 4096, NULL, 10, &g_record_task_handle, 1);
     
     ESP_LOGI(TAG, "音频处理任务启动");
+    audio_pool_log_stats();
     
     return ESP_OK;
 }
@@ -495,8 +2064,23 @@ esp_err_t uart_audio_start(void)
  */
 void uart_audio_stop(void)
 {
+    if (!g_running) {
+        return;
+    }
     g_running = false;
-    g_mode = MODE_IDLE;
+    /* 接收任务阻塞在事件队列上, 只清标志在空闲链路上永远不会退出, 需唤醒并等待 */
+    for (int i = 0; i < UART_AUDIO_MAX_INSTANCES; i++) {
+        if (s_instances[i]) {
+            rx_task_stop(s_instances[i]);
+        }
+    }
+    /* 控制任务返回空闲后置位 AUDIO_STOP_BIT, 唤醒录音任务退出 */
+    ctrl_request(NULL, AUDIO_EVT_SHUTDOWN, false);
+    xEventGroupWaitBits(g_mode_events, AUDIO_STOP_BIT, pdFALSE, pdFALSE, pdMS_TO_TICKS(AUDIO_CTRL_TIMEOUT_MS));
+    
+    /* 播放队列已在返回空闲时清空, 退出消息不会被数据阻塞 */
+    play_msg_t msg = { .type = PLAY_MSG_SHUTDOWN };
+    xQueueSend(g_play_queue, &msg, pdMS_TO_TICKS(AUDIO_CTRL_TIMEOUT_MS));
     vTaskDelay(pdMS_TO_TICKS(100));
 }
 
@@ -509,7 +2093,23 @@ audio_mode_t uart_audio_get_mode(void)
 }
 
 /**
- * @brief       手动开始录音
+ * @brief       获取模式事件组
+ */
+EventGroupHandle_t uart_audio_get_mode_events(void)
+{
+    return g_mode_events;
+}
+
+/**
+ * @brief       投递控制事件 (不等待切换完成)
+ */
+esp_err_t uart_audio_post_event(audio_event_t event)
+{
+    return ctrl_request(NULL, event, false);
+}
+
+/**
+ * @brief       手动开始录音 (等待控制任务完成切换)
  */
 esp_err_t uart_audio_start_record(void)
 {
@@ -517,24 +2117,17 @@ esp_err_t uart_audio_start_record(void)
         return ESP_ERR_INVALID_STATE;
     }
     
-    g_mode = MODE_RECORDING;
-    es8388_adda_cfg(0, 1);
-    es8388_input_cfg(0);
-    es8388_mic_gain(8);
-    i2s_trx_start();
-    
-    ESP_LOGI(TAG, "开始录音");
-    return ESP_OK;
+    esp_err_t ret = ctrl_request(NULL, AUDIO_EVT_START_RECORD, true);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    return g_mode == MODE_RECORDING ? ESP_OK : ESP_ERR_INVALID_STATE;
 }
 
 /**
- * @brief       手动停止录音
+ * @brief       手动停止录音 (等待控制任务完成切换)
  */
 void uart_audio_stop_record(void)
 {
-    if (g_mode == MODE_RECORDING) {
-        g_mode = MODE_IDLE;
-        i2s_trx_stop();
-        ESP_LOGI(TAG, "停止录音");
-    }
+    ctrl_request(NULL, AUDIO_EVT_STOP_RECORD, true);
 }
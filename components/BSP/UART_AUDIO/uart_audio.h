@@ -15,21 +15,51 @@
 #include <stdbool.h>
 #include "esp_err.h"
 #include "driver/uart.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "frame_codec.h"
+#include "audio_mixer.h"
+#include "audio_pm.h"
+#include "audio_fec.h"
 
 /* 音频配置 */
-#define AUDIO_SAMPLE_RATE       8000            /* 采样率: 8kHz (降低以适配230400波特率) */
+#define AUDIO_SAMPLE_RATE       8000            /* 默认采样率: 8kHz (适配230400波特率, 可经 CMD_SET_FORMAT 协商) */
 #define AUDIO_BITS_PER_SAMPLE   16              /* 位宽: 16bit */
 #define AUDIO_CHANNELS          1               /* 声道: 单声道 */
-#define AUDIO_FRAME_SIZE        512             /* 每帧大小(字节) */
+#define AUDIO_FRAME_SIZE        512             /* 录音每帧默认大小(字节), 可经 CMD_SET_TUNING 调整 */
+#define AUDIO_FRAME_SIZE_MIN    128             /* 录音帧下限 */
+#define AUDIO_PLAY_WRITE_TIMEOUT_MS 100         /* 播放数据写入混音器的最长等待 */
+#define AUDIO_PLAY_TARGET_MS    120             /* PCM 播放缓冲目标深度, 混音器按深度趋势补偿主机/I2S 时钟偏差 */
+#define AUDIO_SEQ_MAX_GAP       8               /* 序号前跳不超过该帧数时补隐藏帧, 更大的跳变只重新同步 */
 
 /* 串口配置 */
-#define UART_AUDIO_BAUD_RATE    230400          /* 波特率 */
+#define UART_AUDIO_BAUD_RATE    230400          /* 默认波特率 (可经 CMD_SET_LINK 协商) */
 #define UART_BUF_SIZE           4096            /* 串口缓冲区大小 */
+#define UART_LINK_PROBATION_MS  2000            /* 切换波特率后未收到有效帧则回退 */
+#define AUDIO_UART_EVENT_QUEUE_LEN 16           /* 串口驱动事件队列深度 (接收任务空闲时在此阻塞) */
 
-/* 协议帧定义 */
-#define FRAME_HEADER_0          0xAA            /* 帧头第一字节 */
-#define FRAME_HEADER_1          0x55            /* 帧头第二字节 */
+/* 发送通道: 控制帧 (应答/统计/能力) 严格优先于批量帧 (录音/麦克风), 在帧边界抢占 */
+#define AUDIO_TX_CTRL_QUEUE_LEN 8               /* 控制通道深度 (帧) */
+#define AUDIO_TX_BULK_QUEUE_LEN 4               /* 批量通道深度 (帧), 512 字节录音帧约 128ms */
+#define AUDIO_TX_CTRL_BLOCK     256             /* 控制帧块大小 (字节), 更长的帧取批量块 */
+#define AUDIO_TX_TIMEOUT_MS     100             /* 通道满时的最长等待 (全双工麦克风帧不等待) */
+#define AUDIO_TX_TASK_STACK     2560            /* 发送任务栈 (字节) */
+
+/* 多实例 */
+#define UART_AUDIO_MAX_INSTANCES    2           /* UART0 保留给日志, 最多 UART1 + UART2 */
+
+/* 控制任务配置 */
+#define AUDIO_CTRL_QUEUE_LEN    8               /* 控制事件队列深度 */
+#define AUDIO_CTRL_TIMEOUT_MS   200             /* 投递/等待状态切换完成的超时 */
+
+/* 协议版本 (CMD_GET_CAPS 返回) */
+#define UART_AUDIO_PROTO_MAJOR  1
+#define UART_AUDIO_PROTO_MINOR  8               /* 1.2: CMD_NEXT_TRACK, 1.3: 链路统计/调优, 1.4: 全双工, 1.5: 播放缓冲自适应重采样,
+                                                   1.6: 带序号音频帧/丢包隐藏, 1.7: 奇偶校验前向纠错, 1.8: 回声消除 */
+
+/* 协议帧定义 (帧头/校验见 frame_codec.h) */
 #define FRAME_MAX_DATA_SIZE     2048            /* 最大数据长度 (增大以支持MP3帧) */
+#define AUDIO_FRAME_SIZE_MAX    (FRAME_MAX_DATA_SIZE - 1 - AUDIO_FEC_HEADER) /* 录音帧上限: 全双工流标识与校验帧头加上后仍不超过单帧 */
 
 /* 音频格式定义 */
 typedef enum {
@@ -46,16 +76,172 @@ typedef enum {
     CMD_STOP_PLAY       = 0x05,     /* 停止播放 */
     CMD_HANDSHAKE       = 0x06,     /* 握手/状态查询 */
     CMD_ACK             = 0x07,     /* 应答 */
-    CMD_SET_FORMAT      = 0x08,     /* 设置音频格式 (PCM/MP3) */
+    CMD_SET_FORMAT      = 0x08,     /* 设置音频格式 (PCM/MP3) [+ 采样率 u32] */
+    CMD_GET_CAPS        = 0x09,     /* 查询设备能力 */
+    CMD_CAPS            = 0x0A,     /* 设备能力描述 (TLV) */
+    CMD_SET_LINK        = 0x0B,     /* 设置串口波特率 u32 */
+    CMD_NEXT_TRACK      = 0x0C,     /* 播放中切换到下一曲目 [格式][采样率 u32] */
+    CMD_GET_STATS       = 0x0D,     /* 查询链路统计 [复位标志] */
+    CMD_STATS           = 0x0E,     /* 链路统计 (link_stats_t, 小端) */
+    CMD_SET_TUNING      = 0x0F,     /* 设置录音帧大小 u16 (字节) */
+    CMD_START_DUPLEX    = 0x10,     /* 开始全双工 (同时录音和播放, 仅 PCM) [采样率 u32] */
+    CMD_STOP_DUPLEX     = 0x11,     /* 停止全双工 */
+    CMD_AUDIO_SEQ       = 0x12,     /* 带序号的音频数据 [序号 u16][同 CMD_AUDIO_DATA 的数据], 设备据此检测丢帧 */
+    CMD_AUDIO_FEC       = 0x13,     /* 一组 CMD_AUDIO_SEQ 的校验帧 [首帧序号 u16][帧数 u8][长度异或 u16][数据异或], 见 audio_fec.h */
+    CMD_SET_FEC         = 0x14,     /* 设置设备发出的音频每组帧数 u8 (0 关闭, 2..AUDIO_FEC_MAX_GROUP) */
+    CMD_SET_AEC         = 0x15,     /* 全双工麦克风流回声消除开关 u8 (默认开启, 仅空闲时) */
 } audio_cmd_t;
 
+/* 全双工模式下 CMD_AUDIO_DATA 数据首字节为流 ID, 其余模式无流 ID */
+typedef enum {
+    STREAM_MIC          = 0x01,     /* 麦克风 → 主机 */
+    STREAM_SPK          = 0x02,     /* 主机 → 喇叭 */
+} audio_stream_t;
+
+/* 应答状态 (ACK 第二字节) */
+typedef enum {
+    ACK_OK              = 0x00,     /* 成功 */
+    ACK_ERR_PARAM       = 0x01,     /* 参数不支持 */
+    ACK_ERR_STATE       = 0x02,     /* 当前状态不允许 */
+} ack_status_t;
+
+/* 能力描述 TLV 标签: tag(1B) | len(1B) | value */
+typedef enum {
+    CAP_TAG_PROTO_VERSION   = 0x01, /* u8 major, u8 minor */
+    CAP_TAG_SAMPLE_RATES    = 0x02, /* u32[] 支持的 PCM 采样率 */
+    CAP_TAG_FORMATS         = 0x03, /* u8[] 支持的播放格式 (audio_format_t) */
+    CAP_TAG_PCM_FORMAT      = 0x04, /* u8 位宽, u8 串口上的声道数 */
+    CAP_TAG_MAX_FRAME       = 0x05, /* u16 最大帧数据长度, u16 录音帧上限 */
+    CAP_TAG_BUFFERS         = 0x06, /* u16 串口RX, u16 串口TX, u16 DMA个数, u16 DMA长度(帧) */
+    CAP_TAG_CODECS          = 0x07, /* ASCII 解码器列表, 逗号分隔 */
+    CAP_TAG_BAUD_RATES      = 0x08, /* u32[] 支持的波特率 */
+    CAP_TAG_CURRENT         = 0x09, /* u32 采样率, u32 波特率, u16 录音帧长(字节) */
+    CAP_TAG_DEVICE_ID       = 0x0A, /* 6 字节 MAC, 用于区分设备 */
+    CAP_TAG_FEC             = 0x0B, /* u8 接收方向每组最多帧数 (AUDIO_FEC_MAX_GROUP) */
+} cap_tag_t;
+
+/* 发送通道 */
+typedef enum {
+    TX_LANE_CTRL = 0,               /* 控制: 应答、统计、能力, 随到随写 */
+    TX_LANE_BULK,                   /* 批量: 音频数据, 驱动发完上一帧才写 */
+    TX_LANE_COUNT,
+} tx_lane_t;
+
+/* 链路统计 (CMD_STATS 按字段顺序以 u32 小端发送) */
+typedef struct {
+    uint32_t frames;                /* 正确帧数 */
+    uint32_t checksum_errors;       /* 校验错误数 */
+    uint32_t length_errors;         /* 长度错误数 */
+    uint32_t audio_bytes;           /* 收到的音频数据字节数 (任何模式) */
+    uint32_t rx_high_water;         /* 串口接收缓冲区最高占用 (字节) */
+    uint32_t rx_buf_size;           /* 串口接收缓冲区大小 (字节) */
+    uint32_t play_underruns;        /* 播放欠载次数 (新数据到达时缓冲已播完) */
+    uint32_t play_min_slack_ms;     /* 播放缓冲最小余量 (ms), 0xFFFFFFFF 表示无数据 */
+    uint32_t mode_switches;         /* 模式切换次数 */
+    uint32_t mode_latency_max_us;   /* 事件投递到模式切换完成的最大延迟 (us) */
+    uint32_t mic_frames;            /* 全双工: 已发送麦克风帧数 */
+    uint32_t mic_drops;             /* 全双工: 批量发送通道满而丢弃的麦克风帧数 */
+    uint32_t mix_blocks;            /* 混音器已输出块数 (全局, 查询时填入) */
+    uint32_t mix_cycles_avg;        /* 每块平均混音 CPU 周期 */
+    uint32_t mix_cycles_max;        /* 每块最大混音 CPU 周期 */
+    uint32_t mix_underruns[AUDIO_MIXER_MAX_INPUTS]; /* 各混音输入欠载次数 */
+    uint32_t play_drops;            /* 缓冲池耗尽或播放队列满而丢弃的音频帧 */
+    uint32_t pool_exhausted;        /* 所有缓冲池分配超时总次数 (全局, 查询时填入) */
+    uint32_t tx_frames[TX_LANE_COUNT];       /* 各发送通道已发送帧数 (控制, 批量) */
+    uint32_t tx_delay_avg_us[TX_LANE_COUNT]; /* 各通道平均排队延迟 (us): 入队到写入驱动 */
+    uint32_t tx_delay_max_us[TX_LANE_COUNT]; /* 各通道最大排队延迟 (us) */
+    uint32_t tx_drops;              /* 发送通道满或无空闲块而丢弃的帧数 */
+    uint32_t pm_state_ms[AUDIO_PM_STATE_COUNT]; /* 各电源状态累计时间 (ms): 解码, 会话, 链路, 睡眠 (全局) */
+    uint32_t pm_avg_current_ua;     /* 按状态时间加权的估算平均电流 (uA) */
+    uint32_t cpu_idle_pct[2];       /* 各核空闲率 (%), 自上次查询以来 */
+    uint32_t heap_ops;              /* 当前或上一个会话期间的 malloc + free 次数, 0xFFFFFFFF 表示未开启检查 */
+    int32_t stream_drift_ppm;       /* 播放输入自适应重采样的速率偏差 (ppm, 有符号, 正值为 I2S 比主机慢) */
+    uint32_t stream_level_ms;       /* 播放输入当前缓冲深度 (ms) */
+    uint32_t stream_stretches;      /* 播放输入时长伸缩: 拉长块数 (缓冲偏低) */
+    uint32_t stream_compressions;   /* 播放输入时长伸缩: 压缩块数 (缓冲偏高) */
+    uint32_t tsm_cycles_max;        /* 时长伸缩单块最大 CPU 周期 (全局) */
+    uint32_t seq_lost;              /* 按序号检测到的丢失音频帧数 */
+    uint32_t seq_late;              /* 重复或乱序而丢弃的音频帧数 */
+    uint32_t plc_frames;            /* 经丢包隐藏合成的音频帧数 */
+    uint32_t fec_parity;            /* 收到的校验帧数 */
+    uint32_t fec_recovered;         /* 经校验帧重建的音频帧数 */
+    uint32_t fec_failed;            /* 缺帧后未能重建 (组内缺两帧以上或校验帧丢失) 的次数 */
+    uint32_t fec_tx_parity;         /* 发出的校验帧数 */
+    uint32_t aec_taps;              /* 回声消除滤波器阶数, 0 表示未启用 (全局, 查询时填入, 下同) */
+    uint32_t aec_delay;             /* 估计的回声参考延迟 (采样), 0 表示尚未锁定 */
+    int32_t aec_erle_db;            /* 回声损耗增强 (dB, 有符号) */
+    uint32_t aec_cycles_avg;        /* 每个麦克风帧平均回声消除 CPU 周期 */
+    uint32_t aec_cycles_max;        /* 每个麦克风帧最大回声消除 CPU 周期 */
+    uint32_t aec_resets;            /* 回声消除权重复位次数 (延迟变化或发散) */
+} link_stats_t;
+
 /* 工作模式 */
 typedef enum {
     MODE_IDLE = 0,                  /* 空闲模式 */
     MODE_RECORDING,                 /* 录音模式 */
     MODE_PLAYING,                   /* 播放模式 */
+    MODE_DUPLEX,                    /* 全双工: 同时录音和播放 */
 } audio_mode_t;
 
+/* 模式事件组位: 同一时刻只有当前模式对应的一位置位 */
+#define AUDIO_MODE_BIT(mode)    (1U << (mode))
+#define AUDIO_MODE_BITS_ALL     (AUDIO_MODE_BIT(MODE_IDLE) | AUDIO_MODE_BIT(MODE_RECORDING) | \
+                                 AUDIO_MODE_BIT(MODE_PLAYING) | AUDIO_MODE_BIT(MODE_DUPLEX))
+#define AUDIO_STOP_BIT          (1U << 7)       /* 模块停止, 唤醒所有等待者 */
+
+/* 控制事件 (按键和主机命令统一进入控制任务队列) */
+typedef enum {
+    AUDIO_EVT_START_RECORD = 0,     /* 开始录音 */
+    AUDIO_EVT_STOP_RECORD,          /* 停止录音 */
+    AUDIO_EVT_START_PLAY,           /* 开始播放 */
+    AUDIO_EVT_STOP_PLAY,            /* 停止播放 (格式复位为 PCM) */
+    AUDIO_EVT_START_DUPLEX,         /* 开始全双工 */
+    AUDIO_EVT_STOP_DUPLEX,          /* 停止全双工 */
+    AUDIO_EVT_TOGGLE,               /* 空闲→录音, 其他模式→空闲 (KEY0) */
+    AUDIO_EVT_IDLE,                 /* 返回空闲 (KEY1) */
+    AUDIO_EVT_SHUTDOWN,             /* 停止控制任务 */
+} audio_event_t;
+
+/* 串口音频实例句柄 (每个实例一条独立的协议会话) */
+typedef struct uart_audio *uart_audio_handle_t;
+
+/* 实例配置 */
+typedef struct {
+    uart_port_t uart_num;           /* 串口号 */
+    int tx_pin;                     /* TX引脚 (-1表示使用默认引脚) */
+    int rx_pin;                     /* RX引脚 (-1表示使用默认引脚) */
+    uint32_t baud_rate;             /* 初始波特率 */
+    uint16_t rx_buf_size;           /* 驱动接收缓冲区 (字节) */
+    uint16_t tx_buf_size;           /* 驱动发送缓冲区 (字节) */
+    int rx_task_core;               /* 接收任务所在核 */
+    uint8_t rx_task_priority;       /* 接收任务优先级 */
+    uint32_t rx_task_stack;         /* 接收任务栈 (字节) */
+    bool audio;                     /* 允许音频会话; false 时仅控制/遥测 (不分配音频缓冲) */
+} uart_audio_config_t;
+
+#define UART_AUDIO_DEFAULT_CONFIG(num, tx, rx) {    \
+    .uart_num = (num),                              \
+    .tx_pin = (tx),                                 \
+    .rx_pin = (rx),                                 \
+    .baud_rate = UART_AUDIO_BAUD_RATE,              \
+    .rx_buf_size = UART_BUF_SIZE * 2,               \
+    .tx_buf_size = UART_BUF_SIZE * 2,               \
+    .rx_task_core = 0,                              \
+    .rx_task_priority = 10,                         \
+    .rx_task_stack = 4096,                          \
+    .audio = true,                                  \
+}
+
+/* 实例资源占用 */
+typedef struct {
+    uart_port_t uart_num;           /* 串口号 */
+    uint32_t baud_rate;             /* 当前波特率 */
+    size_t mem_bytes;               /* 内存占用: 驱动缓冲 + 收发任务栈 (帧缓冲取自共享缓冲池) */
+    uint32_t rx_stack_free;         /* 接收任务栈历史最小剩余 (字节), 未运行为 0 */
+    int rx_task_core;               /* 接收任务所在核 */
+    bool audio_owner;               /* 当前占用音频编解码器 */
+} uart_audio_info_t;
+
 /* 协议帧结构 */
 typedef struct {
     uint8_t header[2];              /* 帧头: 0xAA 0x55 */
@@ -68,7 +254,7 @@ typedef struct {
 /* 函数声明 */
 
 /**
- * @brief       初始化串口音频模块
+ * @brief       初始化串口音频模块 (创建默认实例)
  * @param       uart_num: 使用的串口号 (UART_NUM_0, UART_NUM_1, UART_NUM_2)
  * @param       tx_pin: TX引脚 (-1表示使用默认引脚)
  * @param       rx_pin: RX引脚 (-1表示使用默认引脚)
@@ -77,7 +263,47 @@ typedef struct {
 esp_err_t uart_audio_init(uart_port_t uart_num, int tx_pin, int rx_pin);
 
 /**
- * @brief       启动音频处理任务
+ * @brief       创建串口音频实例
+ * @note        各实例的链路参数、统计、缓冲区和接收任务相互独立;
+ *              编解码器为共享资源, 同一时刻只属于一个发起录音/播放的实例。
+ *              第一个创建的实例为默认实例 (按键和 uart_audio_send_frame 使用)。
+ * @param       config: 实例配置 (可用 UART_AUDIO_DEFAULT_CONFIG 初始化)
+ * @param       out: 返回的实例句柄
+ * @retval      ESP_OK: 成功; ESP_ERR_INVALID_ARG: 参数错误或串口已被占用; ESP_ERR_NO_MEM: 内存不足
+ */
+esp_err_t uart_audio_create(const uart_audio_config_t *config, uart_audio_handle_t *out);
+
+/**
+ * @brief       删除串口音频实例 (停止其接收任务, 释放驱动和缓冲区)
+ * @param       handle: 实例句柄
+ * @retval      ESP_OK: 成功; ESP_ERR_INVALID_STATE: 不能删除默认实例
+ */
+esp_err_t uart_audio_delete(uart_audio_handle_t handle);
+
+/**
+ * @brief       获取默认实例
+ * @retval      实例句柄, 未创建时为 NULL
+ */
+uart_audio_handle_t uart_audio_get_default(void);
+
+/**
+ * @brief       查询实例资源占用
+ * @param       handle: 实例句柄
+ * @param       info: 输出
+ * @retval      无
+ */
+void uart_audio_get_info(uart_audio_handle_t handle, uart_audio_info_t *info);
+
+/**
+ * @brief       读取实例链路统计
+ * @param       handle: 实例句柄
+ * @param       stats: 输出
+ * @retval      无
+ */
+void uart_audio_get_stats(uart_audio_handle_t handle, link_stats_t *stats);
+
+/**
+ * @brief       启动音频处理任务 (控制/录音任务及所有实例的接收任务)
  * @retval      ESP_OK: 成功; 其他: 失败
  */
 esp_err_t uart_audio_start(void);
@@ -94,9 +320,23 @@ void uart_audio_stop(void);
  */
 audio_mode_t uart_audio_get_mode(void);
 
+/**
+ * @brief       获取模式事件组 (位定义见 AUDIO_MODE_BIT)
+ * @note        等待 AUDIO_MODE_BITS_ALL & ~AUDIO_MODE_BIT(当前模式) 即等待模式变化
+ * @retval      事件组句柄
+ */
+EventGroupHandle_t uart_audio_get_mode_events(void);
+
+/**
+ * @brief       投递控制事件 (不等待切换完成)
+ * @param       event: 控制事件
+ * @retval      ESP_OK: 成功; ESP_ERR_TIMEOUT: 队列满
+ */
+esp_err_t uart_audio_post_event(audio_event_t event);
+
 /**
  * @brief       手动开始录音
- * @retval      ESP_OK: 成功
+ * @retval      ESP_OK: 成功; ESP_ERR_INVALID_STATE: 非空闲模式
  */
 esp_err_t uart_audio_start_record(void);
 
@@ -107,7 +347,18 @@ esp_err_t uart_audio_start_record(void);
 void uart_audio_stop_record(void);
 
 /**
- * @brief       发送音频帧
+ * @brief       向指定实例发送帧
+ * @note        编码后放入发送通道即返回: CMD_AUDIO_DATA 走批量通道, 其他命令走控制通道
+ * @param       handle: 实例句柄
+ * @param       cmd: 命令
+ * @param       data: 数据
+ * @param       len: 数据长度
+ * @retval      入队的帧字节数, 通道满超时返回 0
+ */
+int uart_audio_send(uart_audio_handle_t handle, uint8_t cmd, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief       向默认实例发送帧
  * @param       cmd: 命令
  * @param       data: 数据
  * @param       len: 数据长度
@@ -18,7 +18,10 @@
 #include "es8388.h"
 #include "i2s.h"
 #include "uart_audio.h"
+#include "audio_mem.h"
+#include "audio_pm.h"
 #include "esp_log.h"
+#include "esp_sleep.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
@@ -27,75 +30,115 @@ static const char *TAG = "MAIN";
 /* I2C 主机句柄 */
 i2c_obj_t i2c0_master;
 
+#define KEY_SCAN_MS         50      /* 按键活动期间的扫描间隔 */
+#define KEY_QUIET_SCANS     10      /* 连续无按键事件的扫描次数, 之后回到等待中断 */
+
+static TaskHandle_t g_key_task = NULL;
+
+/**
+ * @brief       XL9555 中断 (任一输入变化时 INT 拉低)
+ * @note        低电平触发, 读端口前 INT 保持低电平, 先关中断再通知按键任务
+ */
+static void IRAM_ATTR xl9555_int_isr(void *arg)
+{
+    BaseType_t woken = pdFALSE;
+    
+    gpio_intr_disable(XL9555_INT_IO);
+    vTaskNotifyGiveFromISR(g_key_task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
 /**
  * @brief       按键处理任务
- * @note        KEY0: 开始/停止录音 (XL9555 IO扩展)
- *              BOOT: 备用控制
+ * @note        KEY0: 开始/停止录音, 播放中停止播放 (XL9555 IO扩展)
+ *              KEY1: 返回空闲
+ *              按键只投递事件, 模式切换由 uart_audio 控制任务完成;
+ *              空闲时阻塞等待 XL9555 中断, 不再定时读 I2C, 芯片可进入浅睡眠
  */
 static void key_task(void *arg)
 {
     uint8_t key;
     
     while (1) {
-        /* 扫描 XL9555 扩展按键 */
-        key = xl9555_key_scan(0);
-        switch (key) {
-            case KEY0_PRES:
-                /* KEY0: 切换录音状态 */
-                if (uart_audio_get_mode() == MODE_IDLE) {
-                    uart_audio_start_record();
-                    LED(1);
-                    ESP_LOGI(TAG, "按键触发: 开始录音");
-                } else if (uart_audio_get_mode() == MODE_RECORDING) {
-                    uart_audio_stop_record();
-                    LED(0);
-                    ESP_LOGI(TAG, "按键触发: 停止录音");
-                } else if (uart_audio_get_mode() == MODE_PLAYING) {
-                    uart_audio_stop();
-                    LED(0);
-                    ESP_LOGI(TAG, "按键触发: 停止播放");
-                }
-                break;
-                
-            case KEY1_PRES:
-                /* KEY1: 停止所有操作 */
-                uart_audio_stop_record();
-                LED(0);
-                ESP_LOGI(TAG, "按键触发: 返回空闲");
-                break;
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        
+        /* 按键活动期间按原间隔扫描去抖, 扫描读端口同时清除 INT */
+        for (int quiet = 0; quiet < KEY_QUIET_SCANS; quiet++) {
+            key = xl9555_key_scan(0);
+            switch (key) {
+                case KEY0_PRES:
+                    /* KEY0: 切换录音状态 */
+                    uart_audio_post_event(AUDIO_EVT_TOGGLE);
+                    ESP_LOGI(TAG, "按键触发: 切换录音/停止");
+                    quiet = 0;
+                    break;
+                    
+                case KEY1_PRES:
+                    /* KEY1: 停止所有操作 */
+                    uart_audio_post_event(AUDIO_EVT_IDLE);
+                    ESP_LOGI(TAG, "按键触发: 返回空闲");
+                    quiet = 0;
+                    break;
+            }
+            
+            vTaskDelay(pdMS_TO_TICKS(KEY_SCAN_MS));
         }
         
-        vTaskDelay(pdMS_TO_TICKS(50));
+        gpio_intr_enable(XL9555_INT_IO);
     }
 }
 
+/**
+ * @brief       按键中断与唤醒配置 (XL9555 INT 低电平触发, 同时作为浅睡眠唤醒源)
+ */
+static void key_irq_init(void)
+{
+    gpio_set_intr_type(XL9555_INT_IO, GPIO_INTR_LOW_LEVEL);
+    gpio_install_isr_service(0);
+    gpio_isr_handler_add(XL9555_INT_IO, xl9555_int_isr, NULL);
+    gpio_wakeup_enable(XL9555_INT_IO, GPIO_INTR_LOW_LEVEL);
+    esp_sleep_enable_gpio_wakeup();
+}
+
 /**
  * @brief       LED状态指示任务
+ * @note        阻塞等待模式事件组变化, 仅播放模式需要定时闪烁
  */
 static void led_status_task(void *arg)
 {
+    EventGroupHandle_t events = uart_audio_get_mode_events();
+    
     while (1) {
         audio_mode_t mode = uart_audio_get_mode();
+        EventBits_t others = AUDIO_MODE_BITS_ALL & ~AUDIO_MODE_BIT(mode);
+        TickType_t wait = portMAX_DELAY;
         
         switch (mode) {
             case MODE_IDLE:
                 /* 空闲: LED灭 */
                 LED(0);
-                vTaskDelay(pdMS_TO_TICKS(500));
                 break;
                 
             case MODE_RECORDING:
                 /* 录音: LED常亮 */
                 LED(1);
-                vTaskDelay(pdMS_TO_TICKS(100));
                 break;
                 
             case MODE_PLAYING:
                 /* 播放: LED闪烁 */
                 LED_TOGGLE();
-                vTaskDelay(pdMS_TO_TICKS(200));
+                wait = pdMS_TO_TICKS(200);
+                break;
+                
+            case MODE_DUPLEX:
+                /* 全双工: LED快闪 */
+                LED_TOGGLE();
+                wait = pdMS_TO_TICKS(100);
                 break;
         }
+        
+        /* 等待其他模式位置位 (即模式变化) */
+        xEventGroupWaitBits(events, others, pdFALSE, pdFALSE, wait);
     }
 }
 
@@ -108,7 +151,7 @@ void app_main(void)
     
     ESP_LOGI(TAG, "========================================");
     ESP_LOGI(TAG, "   ESP32-S3 音频串口传输系统");
-    ESP_LOGI(TAG, "   采样率: 16kHz, 16bit, 单声道");
+    ESP_LOGI(TAG, "   采样率: %dHz (可协商), 16bit, 单声道", AUDIO_SAMPLE_RATE);
     ESP_LOGI(TAG, "========================================");
     
     /* 初始化 NVS */
@@ -148,6 +191,12 @@ void app_main(void)
         ESP_LOGE(TAG, "I2S 初始化失败: %d", ret);
     }
     
+    /* 电源管理: 动态调频 + 自动浅睡眠, 音频模块按流状态持有 PM 锁 */
+    ret = audio_pm_init();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "电源管理初始化失败: %d, 固定频率运行", ret);
+    }
+    
     /* 初始化串口音频模块 (使用UART1, TX=GPIO17, RX=GPIO18) */
     /* 注意: UART0 保留给日志输出，不能用于音频传输 */
     ret = uart_audio_init(UART_NUM_1, 17, 18);
@@ -162,11 +211,15 @@ void app_main(void)
     ESP_LOGI(TAG, "音频处理任务已启动");
     
     /* 创建按键处理任务 */
-    xTaskCreate(key_task, "key_task", 2048, NULL, 5, NULL);
+    xTaskCreate(key_task, "key_task", 2048, NULL, 5, &g_key_task);
+    key_irq_init();
     
     /* 创建LED状态任务 */
     xTaskCreate(led_status_task, "led_status", 2048, NULL, 3, NULL);
     
+    /* 打印音频内存占用 (内部 RAM / PSRAM、最高占用与余量) */
+    audio_mem_report();
+    
     ESP_LOGI(TAG, "========================================");
     ESP_LOGI(TAG, "   系统启动完成!");
     ESP_LOGI(TAG, "   KEY0: 开始/停止录音");
@@ -0,0 +1,266 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+实时监听: 开发板麦克风 → 串口 → PC 声卡
+
+录音帧进入一个小的自适应抖动缓冲区，由输出端按固定块拉取:
+- 欠载时补静音并提高起播门限
+- 缓冲区长时间保持富余时丢弃多余数据以追回延迟
+
+输出端优先使用 sounddevice (pip install sounddevice)，没有声卡时可写入
+文件或管道，例如:
+    python tools/audio_tool.py COM9 monitor --sink - | aplay -f S16_LE -r 8000 -c 1
+"""
+
+import queue
+import sys
+import threading
+import time
+
+try:
+    import sounddevice
+    SOUNDDEVICE_AVAILABLE = True
+except (ImportError, OSError):
+    SOUNDDEVICE_AVAILABLE = False
+
+# 输出块时长 (ms)
+OUTPUT_BLOCK_MS = 10
+
+
+class JitterBuffer:
+    """自适应抖动缓冲区 (单声道 16bit PCM)"""
+
+    def __init__(self, sample_rate, prime_ms=30, min_prime_ms=10, max_prime_ms=80,
+                 safety_ms=10, window_s=1.0):
+        self.sample_rate = sample_rate
+        self.bytes_per_ms = sample_rate * 2 / 1000
+        self.prime_ms = prime_ms
+        self.min_prime_ms = min_prime_ms
+        self.max_prime_ms = max_prime_ms
+        self.safety_ms = safety_ms
+        self.window_s = window_s
+
+        self.lock = threading.Lock()
+        self.buf = bytearray()
+        self.primed = False
+
+        # 统计窗口
+        self.window_start = time.monotonic()
+        self.window_min_ms = None
+        self.last_underrun = 0.0
+        self.depth_sum = 0.0
+        self.depth_count = 0
+
+        self.underruns = 0
+        self.dropped_ms = 0.0
+        self.received_bytes = 0
+        self.played_bytes = 0
+        self.packet_ms = 0.0
+
+    def _depth_ms(self):
+        return len(self.buf) / self.bytes_per_ms
+
+    def push(self, pcm):
+        """写入接收到的 PCM"""
+        with self.lock:
+            self.buf.extend(pcm)
+            self.received_bytes += len(pcm)
+            self.packet_ms = len(pcm) / self.bytes_per_ms
+            # 硬上限: 超过最大门限两倍直接截断到门限
+            limit = self.max_prime_ms * 2 * self.bytes_per_ms
+            if len(self.buf) > limit:
+                self._drop(len(self.buf) - int(self.prime_ms * self.bytes_per_ms))
+
+    def _drop(self, nbytes):
+        nbytes = max(0, nbytes) & ~1
+        if nbytes:
+            del self.buf[:nbytes]
+            self.dropped_ms += nbytes / self.bytes_per_ms
+
+    def pull(self, nbytes):
+        """输出端拉取固定长度数据, 不足时补静音"""
+        with self.lock:
+            now = time.monotonic()
+            if not self.primed:
+                if self._depth_ms() < self.prime_ms:
+                    return bytes(nbytes)
+                self.primed = True
+
+            if len(self.buf) < nbytes:
+                out = bytes(self.buf) + bytes(nbytes - len(self.buf))
+                self.buf.clear()
+                self.primed = False
+                self.underruns += 1
+                self.last_underrun = now
+                self.prime_ms = min(self.max_prime_ms, self.prime_ms + 10)
+                return out
+
+            out = bytes(self.buf[:nbytes])
+            del self.buf[:nbytes]
+            self.played_bytes += nbytes
+
+            depth = self._depth_ms()
+            self.depth_sum += depth
+            self.depth_count += 1
+            if self.window_min_ms is None or depth < self.window_min_ms:
+                self.window_min_ms = depth
+
+            if now - self.window_start >= self.window_s:
+                # 整个窗口内缓冲都有富余: 丢掉富余部分以降低延迟
+                excess = self.window_min_ms - self.safety_ms
+                if excess > self.safety_ms / 2:
+                    self._drop(int(excess * self.bytes_per_ms))
+                # 一段时间无欠载则逐步降低起播门限
+                if now - self.last_underrun > 5 * self.window_s:
+                    self.prime_ms = max(self.min_prime_ms, self.prime_ms - 5)
+                self.window_start = now
+                self.window_min_ms = None
+            return out
+
+    def snapshot(self):
+        """返回并清零平均深度, 附带当前统计"""
+        with self.lock:
+            avg = self.depth_sum / self.depth_count if self.depth_count else self._depth_ms()
+            self.depth_sum = 0.0
+            self.depth_count = 0
+            return {
+                'depth_ms': avg,
+                'prime_ms': self.prime_ms,
+                'underruns': self.underruns,
+                'dropped_ms': self.dropped_ms,
+                'packet_ms': self.packet_ms,
+                'bytes_per_ms': self.bytes_per_ms,
+            }
+
+
+class SoundDeviceSink:
+    """本地声卡输出"""
+
+    def __init__(self, jitter_buffer, device=None):
+        if not SOUNDDEVICE_AVAILABLE:
+            raise RuntimeError("sounddevice 未安装, 请使用 --sink 输出到文件/管道")
+        self.jb = jitter_buffer
+        rate = jitter_buffer.sample_rate
+        self.stream = sounddevice.RawOutputStream(
+            samplerate=rate, channels=1, dtype='int16', device=device,
+            blocksize=int(rate * OUTPUT_BLOCK_MS / 1000), latency='low',
+            callback=self._callback)
+
+    def _callback(self, outdata, frames, time_info, status):
+        outdata[:] = self.jb.pull(frames * 2)
+
+    @property
+    def latency_ms(self):
+        return self.stream.latency * 1000
+
+    def start(self):
+        self.stream.start()
+
+    def stop(self):
+        self.stream.stop()
+        self.stream.close()
+
+
+class PipeSink:
+    """按实时速率写入文件或管道 ('-' 为标准输出)"""
+
+    def __init__(self, jitter_buffer, target):
+        self.jb = jitter_buffer
+        self.target = target
+        self.block = int(jitter_buffer.sample_rate * OUTPUT_BLOCK_MS / 1000) * 2
+        self.file = None
+        self.thread = None
+        self.running = False
+
+    @property
+    def latency_ms(self):
+        return OUTPUT_BLOCK_MS
+
+    def start(self):
+        # 用进程原始的标准输出: 输出到管道时 sys.stdout 已改指向标准错误
+        self.file = sys.__stdout__.buffer if self.target == '-' else open(self.target, 'wb')
+        self.running = True
+        self.thread = threading.Thread(target=self._run, name='monitor_sink', daemon=True)
+        self.thread.start()
+
+    def _run(self):
+        period = OUTPUT_BLOCK_MS / 1000
+        next_time = time.monotonic()
+        try:
+            while self.running:
+                self.file.write(self.jb.pull(self.block))
+                self.file.flush()
+                next_time += period
+                wait = next_time - time.monotonic()
+                if wait > 0:
+                    time.sleep(wait)
+                else:
+                    next_time = time.monotonic()
+        except (BrokenPipeError, OSError):
+            self.running = False
+
+    def stop(self):
+        self.running = False
+        if self.thread:
+            self.thread.join(timeout=1)
+        if self.file and self.file is not sys.__stdout__.buffer:
+            self.file.close()
+
+
+class SoundDeviceSource:
+    """本机麦克风输入 (全双工对讲), 按固定大小产出单声道 16bit PCM 块
+    
+    接口与 AudioStreamPipeline 的 start/chunks/stop 一致; 数据由声卡时钟驱动,
+    发送端不需要再按时间表等待。
+    """
+
+    live = True
+
+    def __init__(self, sample_rate, chunk_size, device=None):
+        if not SOUNDDEVICE_AVAILABLE:
+            raise RuntimeError("sounddevice 未安装, 无法使用本机麦克风")
+        self.queue = queue.Queue(maxsize=32)
+        self.stopped = False
+        self.overflows = 0
+        self.stream = sounddevice.RawInputStream(
+            samplerate=sample_rate, channels=1, dtype='int16', device=device,
+            blocksize=chunk_size // 2, latency='low', callback=self._callback)
+
+    def _callback(self, indata, frames, time_info, status):
+        try:
+            self.queue.put_nowait(bytes(indata))
+        except queue.Full:
+            self.overflows += 1     # 发送端跟不上时丢弃最新块, 不阻塞音频回调
+
+    def start(self):
+        self.stream.start()
+        return self
+
+    def chunks(self):
+        while not self.stopped:
+            try:
+                yield self.queue.get(timeout=0.5)
+            except queue.Empty:
+                continue
+
+    def stop(self):
+        if not self.stopped:
+            self.stopped = True
+            self.stream.stop()
+            self.stream.close()
+
+
+def open_sink(jitter_buffer, target=None, device=None):
+    """target 为 None 时使用声卡, 否则写入文件/管道"""
+    if target is None:
+        return SoundDeviceSink(jitter_buffer, device)
+    return PipeSink(jitter_buffer, target)
+
+
+def estimate_delay_ms(stats, sink_latency_ms, baudrate):
+    """估算端到端延迟: 采集分块 + 串口传输 + 抖动缓冲 + 输出设备"""
+    packet_ms = stats['packet_ms']
+    # 每字节 10 bit (8N1), 帧开销 6 字节
+    bytes_per_packet = packet_ms * stats['bytes_per_ms'] + 6
+    wire_ms = bytes_per_packet * 10 / baudrate * 1000
+    return packet_ms + wire_ms + stats['depth_ms'] + sink_latency_ms
@@ -0,0 +1,433 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+PC 端流式播放管线
+
+读取 → 格式转换 (采样率 / 声道 / 位宽) → 分包，全部在后台线程完成，
+发送线程只从一个小的预取队列里取包，内存占用与文件长度无关。
+
+- WAV: 分块读取，转换为设备 PCM 通路需要的单声道 16bit
+- MP3: 默认原样分块发送，由 ESP32 解码
+- 其他格式 (或 MP3 指定 host_decode): 通过 ffmpeg 管道流式解码为 PCM
+"""
+
+import array
+import queue
+import shutil
+import subprocess
+import sys
+import threading
+import time
+import wave
+from pathlib import Path
+
+from frame_codec import encode_frame
+
+try:
+    import audioop
+except ImportError:     # Python 3.13+ 且未安装 audioop-lts
+    audioop = None
+
+# 音频格式定义 (与固件 audio_format_t 一致)
+AUDIO_FORMAT_PCM = 0x00
+AUDIO_FORMAT_MP3 = 0x01
+
+CMD_AUDIO_DATA = 0x03
+
+# 每次从源文件读取的采样帧数
+READ_BLOCK_FRAMES = 4096
+# 原始文件 / 管道每次读取的字节数
+READ_BLOCK_BYTES = 16 * 1024
+
+
+# ---------------------------------------------------------------------------
+# 无 audioop 时的纯 Python 实现 (仅覆盖本模块用到的函数)
+# ---------------------------------------------------------------------------
+
+def _to_int16(data, width):
+    """任意位宽有符号小端 PCM 转 16bit"""
+    if width == 2:
+        return bytes(data)
+    if width == 1:
+        return array.array('h', ((b - 256 if b > 127 else b) << 8 for b in data)).tobytes()
+    out = array.array('h')
+    for i in range(0, len(data), width):
+        out.append(int.from_bytes(data[i:i + width], 'little', signed=True) >> ((width - 2) * 8))
+    return out.tobytes()
+
+
+def _downmix(data, channels):
+    samples = array.array('h', data)
+    return array.array('h', (sum(samples[i:i + channels]) // channels
+                             for i in range(0, len(samples), channels))).tobytes()
+
+
+def _upmix(data, channels):
+    samples = array.array('h', data)
+    return array.array('h', (s for s in samples for _ in range(channels))).tobytes()
+
+
+class _LinearResampler:
+    """线性插值重采样 (16bit, 交织多声道), 状态跨块保持"""
+
+    def __init__(self, src_rate, dst_rate, channels):
+        self.step = src_rate / dst_rate
+        self.channels = channels
+        self.pos = 0.0
+        self.prev = [0] * channels
+
+    def process(self, data):
+        ch = self.channels
+        samples = array.array('h', data)
+        frames = len(samples) // ch
+        out = array.array('h')
+        pos = self.pos
+        while pos < frames:
+            i = int(pos)
+            frac = pos - i
+            for c in range(ch):
+                a = self.prev[c] if i == 0 else samples[(i - 1) * ch + c]
+                b = samples[i * ch + c]
+                out.append(int(a + (b - a) * frac))
+            pos += self.step
+        self.pos = pos - frames
+        if frames:
+            self.prev = list(samples[(frames - 1) * ch:frames * ch])
+        return out.tobytes()
+
+
+class PcmConverter:
+    """将任意 PCM 转换为目标格式 (默认单声道 16bit)
+
+    处理顺序: 位宽 → 声道 → 采样率，重采样在声道合并之后进行以减少计算量。
+    """
+
+    def __init__(self, src_rate, src_channels, src_width,
+                 dst_rate, dst_channels=1, dst_width=2):
+        if dst_width != 2:
+            raise ValueError("仅支持输出 16bit PCM")
+        self.src_rate = src_rate
+        self.src_channels = src_channels
+        self.src_width = src_width
+        self.dst_rate = dst_rate
+        self.dst_channels = dst_channels
+        self.frame_bytes = src_channels * src_width
+        self.pending = b''
+        self.ratecv_state = None
+        self.resampler = None
+        if audioop is None and src_rate != dst_rate:
+            self.resampler = _LinearResampler(src_rate, dst_rate, dst_channels)
+
+    @property
+    def passthrough(self):
+        return (self.src_rate == self.dst_rate and self.src_channels == self.dst_channels
+                and self.src_width == 2)
+
+    def convert(self, data):
+        # 保证按整采样帧处理, 余下的字节留到下一块
+        if self.pending:
+            data = self.pending + data
+        usable = len(data) // self.frame_bytes * self.frame_bytes
+        self.pending = data[usable:]
+        data = data[:usable]
+        if not data or self.passthrough:
+            return bytes(data)
+
+        width = self.src_width
+        channels = self.src_channels
+
+        # 位宽 (WAV 8bit 为无符号)
+        if width != 2:
+            if audioop is not None:
+                if width == 1:
+                    data = audioop.bias(data, 1, -128)
+                data = audioop.lin2lin(data, width, 2)
+            else:
+                if width == 1:
+                    data = bytes((b - 128) & 0xFF for b in data)
+                data = _to_int16(data, width)
+
+        # 声道
+        if channels != self.dst_channels:
+            if self.dst_channels == 1:
+                if channels == 2 and audioop is not None:
+                    data = audioop.tomono(data, 2, 0.5, 0.5)
+                else:
+                    data = _downmix(data, channels)
+            elif channels == 1:
+                if self.dst_channels == 2 and audioop is not None:
+                    data = audioop.tostereo(data, 2, 1.0, 1.0)
+                else:
+                    data = _upmix(data, self.dst_channels)
+            else:
+                raise ValueError(f"不支持 {channels} → {self.dst_channels} 声道转换")
+
+        # 采样率
+        if self.src_rate != self.dst_rate:
+            if audioop is not None:
+                data, self.ratecv_state = audioop.ratecv(data, 2, self.dst_channels,
+                                                         self.src_rate, self.dst_rate,
+                                                         self.ratecv_state)
+            else:
+                data = self.resampler.process(data)
+
+        return data
+
+
+# ---------------------------------------------------------------------------
+# 数据源
+# ---------------------------------------------------------------------------
+
+class WavSource:
+    """分块读取 WAV"""
+
+    def __init__(self, filename):
+        self.wf = wave.open(str(filename), 'rb')
+        self.sample_rate = self.wf.getframerate()
+        self.channels = self.wf.getnchannels()
+        self.sample_width = self.wf.getsampwidth()
+        self.nframes = self.wf.getnframes()
+
+    def __iter__(self):
+        try:
+            while True:
+                block = self.wf.readframes(READ_BLOCK_FRAMES)
+                if not block:
+                    break
+                yield block
+        finally:
+            self.close()
+
+    def close(self):
+        if self.wf:
+            self.wf.close()
+            self.wf = None
+
+
+class RawFileSource:
+    """原样分块读取文件 (MP3 直通)"""
+
+    def __init__(self, filename):
+        self.filename = filename
+        self.size = Path(filename).stat().st_size
+        self.file = None
+
+    def __iter__(self):
+        with open(self.filename, 'rb') as f:
+            self.file = f
+            while True:
+                block = f.read(READ_BLOCK_BYTES)
+                if not block:
+                    break
+                yield block
+
+    def close(self):
+        if self.file:
+            self.file.close()
+
+
+class FfmpegSource:
+    """通过 ffmpeg 管道流式解码为 s16le PCM"""
+
+    def __init__(self, filename, sample_rate, channels=1):
+        ffmpeg = shutil.which('ffmpeg')
+        if not ffmpeg:
+            raise RuntimeError("未找到 ffmpeg, 无法在 PC 端解码该格式")
+        self.sample_rate = sample_rate
+        self.channels = channels
+        self.sample_width = 2
+        self.cmd = [ffmpeg, '-nostdin', '-loglevel', 'error', '-i', str(filename),
+                    '-f', 's16le', '-acodec', 'pcm_s16le',
+                    '-ac', str(channels), '-ar', str(sample_rate), '-']
+        self.proc = None
+
+    def __iter__(self):
+        self.proc = subprocess.Popen(self.cmd, stdout=subprocess.PIPE)
+        try:
+            while True:
+                block = self.proc.stdout.read(READ_BLOCK_BYTES)
+                if not block:
+                    break
+                yield block
+        finally:
+            self.close()
+
+    def close(self):
+        if self.proc:
+            if self.proc.poll() is None:
+                self.proc.kill()
+            self.proc.wait()
+            self.proc = None
+
+
+# ---------------------------------------------------------------------------
+# 管线
+# ---------------------------------------------------------------------------
+
+class AudioStreamPipeline:
+    """后台解码线程 + 预取队列
+
+    chunks() 按 chunk_size 产出待发送的数据包。队列有上限，解码线程最多
+    领先 prefetch 个包，内存占用有界。
+    """
+
+    _END = object()
+
+    def __init__(self, source, converter=None, chunk_size=512, prefetch=16):
+        self.source = source
+        self.converter = converter
+        self.chunk_size = chunk_size
+        self.queue = queue.Queue(maxsize=prefetch)
+        self.stop_event = threading.Event()
+        self.thread = None
+        self.produced_bytes = 0
+        self.sender_waits = 0       # 发送线程因队列为空而等待的次数
+        self.decode_time = 0.0      # 解码线程累计处理时间
+        self.cache_writer = None    # 转码缓存 (完整播放后生效)
+
+    def start(self):
+        self.thread = threading.Thread(target=self._run, name='audio_decode', daemon=True)
+        self.thread.start()
+        return self
+
+    def _put(self, item):
+        while not self.stop_event.is_set():
+            try:
+                self.queue.put(item, timeout=0.1)
+                return True
+            except queue.Full:
+                continue
+        return False
+
+    def _run(self):
+        buf = bytearray()
+        try:
+            it = iter(self.source)
+            while not self.stop_event.is_set():
+                t0 = time.perf_counter()
+                block = next(it, None)
+                if block is None:
+                    break
+                if self.converter:
+                    block = self.converter.convert(block)
+                buf.extend(block)
+                self.decode_time += time.perf_counter() - t0
+
+                n = len(buf) // self.chunk_size * self.chunk_size
+                for i in range(0, n, self.chunk_size):
+                    if not self._put(bytes(buf[i:i + self.chunk_size])):
+                        return
+                del buf[:n]
+                self.produced_bytes += n
+
+            if buf and not self.stop_event.is_set():
+                self._put(bytes(buf))
+                self.produced_bytes += len(buf)
+        except Exception as e:
+            self._put(e)
+        finally:
+            self.source.close()
+            self._put(self._END)
+
+    def chunks(self):
+        """逐包产出待发送数据"""
+        while True:
+            try:
+                item = self.queue.get_nowait()
+            except queue.Empty:
+                self.sender_waits += 1
+                item = self.queue.get()
+            if item is self._END:
+                return
+            if isinstance(item, Exception):
+                raise item
+            yield item
+
+    def frames(self):
+        """逐帧产出 (完整协议帧, 数据长度); 设置了缓存时同时写入缓存"""
+        writer = self.cache_writer
+        completed = False
+        try:
+            for chunk in self.chunks():
+                frame = encode_frame(CMD_AUDIO_DATA, chunk)
+                if writer:
+                    writer.add(frame)
+                yield frame, len(chunk)
+            completed = True
+        finally:
+            if writer:
+                if completed and not self.stop_event.is_set():
+                    writer.commit()
+                else:
+                    writer.discard()
+                self.cache_writer = None
+
+    def stop(self):
+        self.stop_event.set()
+        # 清空队列以唤醒阻塞的解码线程
+        try:
+            while True:
+                self.queue.get_nowait()
+        except queue.Empty:
+            pass
+        if self.thread:
+            self.thread.join(timeout=1)
+
+
+def open_playback_stream(filename, target_rate, chunk_size=512, prefetch=16, host_decode=False,
+                         cache=None):
+    """为播放打开流式管线
+
+    返回 (pipeline, audio_format, info)，info 为用于显示的参数字典，
+    其中 total_bytes 为预计发送的总字节数 (未知时为 None)。
+    指定 cache (TranscodeCache) 时命中则返回缓存流, 未命中则边播放边写缓存。
+    """
+    filepath = Path(filename)
+    if not filepath.exists():
+        raise FileNotFoundError(f"文件不存在: {filename}")
+
+    key = None
+    if cache is not None:
+        key = cache.key(filepath, target_rate, chunk_size, host_decode)
+        stream = cache.open(key)
+        if stream is not None:
+            info = dict(stream.info, cached=True)
+            return stream, stream.audio_format, info
+
+    ext = filepath.suffix.lower()
+    info = {}
+
+    if ext == '.wav':
+        source = WavSource(filepath)
+        converter = PcmConverter(source.sample_rate, source.channels, source.sample_width,
+                                 target_rate)
+        audio_format = AUDIO_FORMAT_PCM
+        info.update(src_rate=source.sample_rate, src_channels=source.channels,
+                    src_bits=source.sample_width * 8, rate=target_rate,
+                    duration=source.nframes / source.sample_rate if source.sample_rate else 0,
+                    total_bytes=int(source.nframes * target_rate / source.sample_rate) * 2
+                    if source.sample_rate else 0,
+                    converted=not converter.passthrough)
+    elif ext == '.mp3' and not host_decode:
+        source = RawFileSource(filepath)
+        converter = None
+        audio_format = AUDIO_FORMAT_MP3
+        info.update(total_bytes=source.size)
+    else:
+        source = FfmpegSource(filepath, target_rate)
+        converter = None
+        audio_format = AUDIO_FORMAT_PCM
+        info.update(rate=target_rate, total_bytes=None, converted=True)
+
+    pipeline = AudioStreamPipeline(source, converter, chunk_size, prefetch)
+    if key is not None:
+        pipeline.cache_writer = cache.writer(key, audio_format, info, chunk_size)
+    return pipeline, audio_format, info
+
+
+if __name__ == '__main__':
+    # 调试: 把转换结果写到 stdout, 例如 python audio_stream.py in.wav 8000 > out.raw
+    p, fmt, info = open_playback_stream(sys.argv[1], int(sys.argv[2]) if len(sys.argv) > 2 else 8000)
+    print(info, file=sys.stderr)
+    for chunk in p.start().chunks():
+        sys.stdout.buffer.write(chunk)
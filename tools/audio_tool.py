@@ -19,6 +19,16 @@ ESP32-S3 音频串口传输工具
 0x05: 停止播放
 0x06: 握手
 0x07: 应答
+0x08: 设置音频格式 [格式][采样率 u32]
+0x09: 查询设备能力
+0x0A: 能力描述 (TLV)
+0x0B: 切换波特率 [u32]
+0x0C: 下一曲目 [格式][采样率 u32] (无缝播放)
+0x0D: 查询链路统计 [复位标志]
+0x0E: 链路统计
+0x0F: 设置录音帧大小 [u16]
+0x10: 开始全双工 [采样率 u32] (音频数据首字节为流 ID)
+0x11: 停止全双工
 """
 
 import serial
@@ -26,16 +36,28 @@ import struct
 import wave
 import time
 import argparse
+import json
+import sys
 import threading
 from pathlib import Path
 
+from frame_codec import (FrameDecoder, encode_frame, FRAME_HEAD_SIZE,
+                         FRAME_DECODE_BAD_CHECKSUM, FRAME_DECODE_BAD_LENGTH)
+from audio_stream import open_playback_stream
+from audio_monitor import JitterBuffer, SoundDeviceSource, open_sink, estimate_delay_ms
+from transcode_cache import TranscodeCache
+from link_tuning import LinkCalibrator, LinkProfileStore, parse_stats
+from fec import FecEncoder, FecDecoder, FEC_HEADER, MAX_GROUP as FEC_MAX_GROUP
+from session_capture import (CaptureWriter, CaptureReader, SessionReplayer, DIR_TX, DIR_RX,
+                             analyze_capture, print_capture_summary, print_replay_report)
+
 # MP3 支持
 try:
     from pydub import AudioSegment
     PYDUB_AVAILABLE = True
 except ImportError:
     PYDUB_AVAILABLE = False
-    print("警告: pydub 未安装，MP3 支持不可用。安装方法: pip install pydub")
+    print("警告: pydub 未安装，MP3 支持不可用。安装方法: pip install pydub", file=sys.stderr)
 
 # 命令定义
 CMD_START_RECORD = 0x01
@@ -46,28 +68,324 @@ CMD_STOP_PLAY = 0x05
 CMD_HANDSHAKE = 0x06
 CMD_ACK = 0x07
 CMD_SET_FORMAT = 0x08  # 新增：设置音频格式
+CMD_GET_CAPS = 0x09
+CMD_CAPS = 0x0A
+CMD_SET_LINK = 0x0B
+CMD_NEXT_TRACK = 0x0C
+CMD_GET_STATS = 0x0D
+CMD_STATS = 0x0E
+CMD_SET_TUNING = 0x0F
+CMD_START_DUPLEX = 0x10
+CMD_STOP_DUPLEX = 0x11
+CMD_AUDIO_SEQ = 0x12  # 带序号的音频数据 [序号 u16][同 CMD_AUDIO_DATA]
+CMD_AUDIO_FEC = 0x13  # 一组带序号音频帧的校验帧 (见 fec.py)
+CMD_SET_FEC = 0x14    # 设置设备发出的音频每组帧数 u8 (0 关闭)
+CMD_SET_AEC = 0x15    # 全双工回声消除开关 u8
+
+# 全双工音频流 ID (CMD_AUDIO_DATA 数据首字节)
+STREAM_MIC = 0x01
+STREAM_SPK = 0x02
+
+# 应答状态 (ACK 第二字节)
+ACK_OK = 0
+ACK_ERR_PARAM = 1
+ACK_ERR_STATE = 2
+
+# 设备未开启零分配检查 (CONFIG_HEAP_USE_HOOKS) 时 STATS 中 heap_ops 的值
+HEAP_OPS_UNTRACKED = 0xFFFFFFFF
+
+# 能力描述 TLV 标签 (与固件 cap_tag_t 一致)
+CAP_TAG_PROTO_VERSION = 0x01
+CAP_TAG_SAMPLE_RATES = 0x02
+CAP_TAG_FORMATS = 0x03
+CAP_TAG_PCM_FORMAT = 0x04
+CAP_TAG_MAX_FRAME = 0x05
+CAP_TAG_BUFFERS = 0x06
+CAP_TAG_CODECS = 0x07
+CAP_TAG_BAUD_RATES = 0x08
+CAP_TAG_CURRENT = 0x09
+CAP_TAG_DEVICE_ID = 0x0A
+CAP_TAG_FEC = 0x0B
 
 # 音频格式定义
 AUDIO_FORMAT_PCM = 0x00
 AUDIO_FORMAT_MP3 = 0x01
 
-# 音频参数
-SAMPLE_RATE = 8000  # 与 ESP32 I2S 配置一致 (8kHz)
+# 音频参数 (未协商时的默认值, 与固件 AUDIO_SAMPLE_RATE 一致)
+SAMPLE_RATE = 8000
 BITS_PER_SAMPLE = 16
 CHANNELS = 1
+CHUNK_SIZE = 512
+
+# 自动协商的波特率上限 (常见 USB 转串口芯片均可稳定工作)
+DEFAULT_MAX_BAUD = 921600
+# 固件支持的波特率 (与 uart_audio.c s_baud_rates 一致), 设备停留在协商波特率时逐个探测
+LINK_BAUD_RATES = (115200, 230400, 460800, 921600, 1500000, 2000000)
+# 8N1 每字节 10 bit, 再预留 15% 余量给帧开销和命令
+LINK_HEADROOM = 1.15
+# PCM 发送间隔 = 包时长 × 系数 (未校准时的默认值)
+PACE_FACTOR = 0.94
+
+# 多线程日志输出锁
+_log_lock = threading.Lock()
+
+
+def parse_caps(data):
+    """解析 CMD_CAPS 的 TLV 描述, 未知标签忽略"""
+    caps = {}
+    pos = 0
+    while pos + 2 <= len(data):
+        tag, length = data[pos], data[pos + 1]
+        value = bytes(data[pos + 2:pos + 2 + length])
+        pos += 2 + length
+        if len(value) < length:
+            break
+        if tag == CAP_TAG_PROTO_VERSION and length >= 2:
+            caps['version'] = (value[0], value[1])
+        elif tag == CAP_TAG_SAMPLE_RATES:
+            caps['sample_rates'] = list(struct.unpack(f'<{length // 4}I', value[:length // 4 * 4]))
+        elif tag == CAP_TAG_FORMATS:
+            caps['formats'] = list(value)
+        elif tag == CAP_TAG_PCM_FORMAT and length >= 2:
+            caps['bits'], caps['channels'] = value[0], value[1]
+        elif tag == CAP_TAG_MAX_FRAME and length >= 2:
+            caps['max_frame'] = struct.unpack('<H', value[:2])[0]
+            if length >= 4:
+                caps['max_record_frame'] = struct.unpack('<H', value[2:4])[0]
+        elif tag == CAP_TAG_BUFFERS and length >= 8:
+            caps['uart_rx_buf'], caps['uart_tx_buf'], caps['dma_count'], caps['dma_len'] = \
+                struct.unpack('<4H', value[:8])
+        elif tag == CAP_TAG_CODECS:
+            caps['codecs'] = value.decode('ascii', 'replace').split(',')
+        elif tag == CAP_TAG_BAUD_RATES:
+            caps['baud_rates'] = list(struct.unpack(f'<{length // 4}I', value[:length // 4 * 4]))
+        elif tag == CAP_TAG_CURRENT and length >= 10:
+            caps['current_rate'], caps['current_baud'], caps['record_frame'] = \
+                struct.unpack('<IIH', value[:10])
+        elif tag == CAP_TAG_DEVICE_ID:
+            caps['device_id'] = value
+        elif tag == CAP_TAG_FEC and length >= 1:
+            caps['fec_group'] = value[0]
+    return caps
+
+
+def choose_link_params(caps, baudrate, max_baud=DEFAULT_MAX_BAUD, rate=None):
+    """根据设备能力选择波特率、PCM 采样率和包大小
+
+    波特率取设备支持且不超过 max_baud 的最大值; 采样率取链路能实时承载的
+    最大值 (rate × 2 字节 × 10 bit × 余量 ≤ 波特率)。
+    返回 (baud, sample_rate, chunk_size)。
+    """
+    bauds = [b for b in caps.get('baud_rates', []) if b <= max_baud]
+    baud = max(bauds) if bauds else baudrate
+    baud = max(baud, baudrate)
+
+    rates = sorted(caps.get('sample_rates', [SAMPLE_RATE]))
+    if rate:
+        if rate not in rates:
+            raise ValueError(f"设备不支持 {rate} Hz, 可选: {rates}")
+        sample_rate = rate
+    else:
+        fit = [r for r in rates if r * 2 * 10 * LINK_HEADROOM <= baud]
+        sample_rate = max(fit) if fit else rates[0]
+
+    chunk = min(CHUNK_SIZE, caps.get('max_frame', CHUNK_SIZE)) & ~1
+    return baud, sample_rate, chunk
+
+
+class StreamingWavWriter:
+    """流式 WAV 写入器
 
-# 帧头
-FRAME_HEADER = bytes([0xAA, 0x55])
+    先写入占位文件头，音频数据经固定大小的缓冲区追加写入，并定期回填
+    RIFF/data 长度。内存占用恒定，进程异常退出时已写入的数据仍可播放。
+    可按时长或大小切分为多个文件 (name_000.wav, name_001.wav, ...)。
+    RIFF/data 长度是 u32, 未要求切分时数据接近 4 GiB 也会换到 name_001.wav 继续写。
+    """
+    HEADER_SIZE = 44
+    MAX_DATA_BYTES = 0xFFFFFFFF - 36    # RIFF 长度 = 36 + data 长度, 不能溢出
+
+    def __init__(self, filename, sample_rate=SAMPLE_RATE, channels=CHANNELS,
+                 sample_width=BITS_PER_SAMPLE // 8, buffer_size=64 * 1024,
+                 patch_interval=1.0, rotate_seconds=0, rotate_bytes=0):
+        self.path = Path(filename)
+        self.sample_rate = sample_rate
+        self.channels = channels
+        self.sample_width = sample_width
+        self.block_align = channels * sample_width
+        self.byte_rate = sample_rate * self.block_align
+        self.buffer_size = buffer_size
+        self.patch_interval = patch_interval
+        
+        # 切分阈值 (字节), 对齐到采样帧; 始终不超过 WAV 长度字段的上限
+        limits = [self.MAX_DATA_BYTES]
+        if rotate_seconds > 0:
+            limits.append(int(rotate_seconds * self.byte_rate))
+        if rotate_bytes > 0:
+            limits.append(int(rotate_bytes) - self.HEADER_SIZE)
+        self.split = len(limits) > 1    # 用户要求切分时第一个文件也带编号
+        self.rotate_limit = max(self.block_align,
+                                min(limits) // self.block_align * self.block_align)
+        
+        self.buffer = bytearray()
+        self.file = None
+        self.file_bytes = 0
+        self.total_bytes = 0
+        self.files = []
+        self.last_patch = 0.0
+        self._open_next()
+    
+    def _next_name(self):
+        if not self.split and not self.files:
+            return self.path
+        return self.path.with_name(f"{self.path.stem}_{len(self.files):03d}{self.path.suffix}")
+    
+    def _open_next(self):
+        name = self._next_name()
+        self.file = open(name, 'wb')
+        self.files.append(name)
+        self.file_bytes = 0
+        self.file.write(self._header(0))
+        self.file.flush()
+        self.last_patch = time.monotonic()
+    
+    def _header(self, data_bytes):
+        return struct.pack('<4sI4s4sIHHIIHH4sI',
+                           b'RIFF', 36 + data_bytes, b'WAVE',
+                           b'fmt ', 16, 1, self.channels, self.sample_rate,
+                           self.byte_rate, self.block_align, self.sample_width * 8,
+                           b'data', data_bytes)
+    
+    def _flush_buffer(self):
+        if self.buffer:
+            self.file.write(self.buffer)
+            self.buffer.clear()
+    
+    def _patch_header(self):
+        """回填 RIFF/data 长度并落盘"""
+        self.file.seek(4)
+        self.file.write(struct.pack('<I', 36 + self.file_bytes))
+        self.file.seek(40)
+        self.file.write(struct.pack('<I', self.file_bytes))
+        self.file.seek(0, 2)
+        self.file.flush()
+        self.last_patch = time.monotonic()
+    
+    def _close_current(self):
+        self._flush_buffer()
+        self._patch_header()
+        self.file.close()
+        self.file = None
+    
+    def write(self, data):
+        """追加音频数据"""
+        view = memoryview(data)
+        while len(view) > 0:
+            part = view[:self.rotate_limit - self.file_bytes]
+            
+            self.buffer.extend(part)
+            self.file_bytes += len(part)
+            self.total_bytes += len(part)
+            view = view[len(part):]
+            
+            if len(self.buffer) >= self.buffer_size:
+                self._flush_buffer()
+            
+            if self.file_bytes >= self.rotate_limit:
+                self._close_current()
+                self._open_next()
+        
+        if time.monotonic() - self.last_patch >= self.patch_interval:
+            self._flush_buffer()
+            self._patch_header()
+    
+    def close(self):
+        """写出剩余数据并关闭; 空的最后一个切分文件会被删除"""
+        if self.file is None:
+            return
+        self._close_current()
+        if self.file_bytes == 0:
+            self.files[-1].unlink(missing_ok=True)
+            self.files.pop()
+    
+    @property
+    def duration(self):
+        return self.total_bytes / self.byte_rate
+    
+    def print_summary(self, log=print):
+        if not self.files:
+            log("没有接收到音频数据")
+            return
+        for name in self.files:
+            log(f"已保存: {name}")
+        log(f"  采样率: {self.sample_rate} Hz")
+        log(f"  位宽: {self.sample_width * 8} bit")
+        log(f"  声道: {self.channels}")
+        log(f"  大小: {self.total_bytes} 字节")
+        log(f"  时长: {self.duration:.2f} 秒")
 
 
 class AudioSerialTool:
-    def __init__(self, port, baudrate=230400):
+    def __init__(self, port, baudrate=230400, name=None):
         self.port = port
         self.baudrate = baudrate
+        self.initial_baud = baudrate    # 断开前切回, 下次以默认波特率连接的程序才能通信
+        self.name = name            # 多设备模式下的日志前缀
         self.serial = None
         self.running = False
-        self.audio_data = bytearray()
+        self.wav_writer = None
+        self.jitter_buffer = None   # 实时监听
+        self.log_file = sys.stdout
         self.rx_thread = None
+        self.abort = threading.Event()
+        self.start_barrier = None   # 多设备同步启动
+        self.start_time = None
+        self.caps = None            # 设备能力描述 (协商后)
+        self.caps_event = threading.Event()
+        self.acks = {}              # 命令 → 最近一次应答状态
+        self.ack_cond = threading.Condition()
+        self.cmd_rtt_max_ms = 0.0   # 命令往返时间最大值 (发送到收到应答)
+        self.sample_rate = SAMPLE_RATE
+        self.chunk_size = CHUNK_SIZE
+        self.pace_factor = PACE_FACTOR
+        self.tx_seq = 0             # 下一个音频帧序号 (CMD_AUDIO_SEQ)
+        self.fec_tx = None          # 发往设备的音频前向纠错 (FecEncoder), None 为关闭
+        self.fec_rx = FecDecoder()  # 设备发来的带序号音频 (设备开启前向纠错时)
+        self.link_stats = None      # 最近一次 CMD_STATS
+        self.stats_event = threading.Event()
+        self.profiles = None        # 链路调优参数 (LinkProfileStore)
+        self.capture = None         # 会话抓包 (CaptureWriter)
+        self.cache = None           # 转码缓存 (TranscodeCache)
+        self.duplex_active = False  # 全双工: 音频帧带流 ID
+        self.reset_stats()
+    
+    def reset_stats(self):
+        """清零收发统计"""
+        self.stats = {
+            'tx_bytes': 0, 'tx_frames': 0,
+            'rx_bytes': 0, 'rx_frames': 0, 'audio_bytes': 0, 'rx_audio_bytes': 0,
+            'checksum_errors': 0, 'length_errors': 0,
+        }
+    
+    def log(self, *args, end='\n', **kwargs):
+        """输出日志; 多设备模式下加设备前缀并省略进度行"""
+        if not self.name:
+            print(*args, end=end, file=self.log_file, **kwargs)
+            return
+        if end != '\n':
+            return
+        text = ' '.join(str(a) for a in args).strip('\r\n')
+        with _log_lock:
+            self.log_file.write(f"[{self.name}] {text}\n")
+            self.log_file.flush()
+    
+    def sync_start(self):
+        """等待所有设备就绪后同时开始 (单设备时直接返回)"""
+        if self.start_barrier:
+            try:
+                self.start_barrier.wait(timeout=10)
+            except threading.BrokenBarrierError:
+                self.log("警告: 同步启动超时, 独立开始")
+        self.start_time = time.monotonic()
         
     def connect(self):
         """连接串口"""
@@ -81,297 +399,1057 @@ class AudioSerialTool:
                 timeout=0.1,
                 write_timeout=1
             )
-            print(f"已连接到 {self.port}, 波特率: {self.baudrate}")
+            self.log(f"已连接到 {self.port}, 波特率: {self.baudrate}")
             return True
         except Exception as e:
-            print(f"连接失败: {e}")
+            self.log(f"连接失败: {e}")
             return False
     
     def disconnect(self):
-        """断开串口"""
+        """断开串口 (协商过波特率时先切回初始波特率)"""
+        if self.serial:
+            try:
+                self.restore_baud()
+            except OSError as e:
+                self.log(f"切回初始波特率失败: {e}")
         self.running = False
         if self.rx_thread:
             self.rx_thread.join(timeout=1)
+        self.close_wav_writer()
         if self.serial:
             self.serial.close()
             self.serial = None
-        print("已断开连接")
-    
-    def calc_checksum(self, data):
-        """计算校验和"""
-        checksum = 0
-        for b in data:
-            checksum ^= b
-        return checksum
+        if self.capture:
+            self.capture.close()
+            self.log(f"抓包已保存: {self.capture.records} 条记录, {self.capture.bytes} 字节")
+            self.capture = None
+        self.log("已断开连接")
     
     def send_frame(self, cmd, data=b''):
         """发送帧"""
         if not self.serial:
             return False
         
-        length = len(data)
-        header = struct.pack('<2sBH', FRAME_HEADER, cmd, length)
-        checksum = self.calc_checksum(header[2:] + data)
-        frame = header + data + bytes([checksum])
-        
-        self.serial.write(frame)
+        if cmd in (CMD_START_RECORD, CMD_START_PLAY, CMD_START_DUPLEX):
+            # 设备在会话开始时复位前向纠错, 两边的校验组对齐
+            if self.fec_tx:
+                self.fec_tx.reset()
+            self.fec_rx.reset()
+        self.send_encoded(encode_frame(cmd, data), len(data) if cmd == CMD_AUDIO_DATA else 0)
         return True
     
-    def parse_frame(self, buffer):
-        """解析帧，返回 (cmd, data, remaining_buffer) 或 None"""
-        # 查找帧头
-        idx = buffer.find(FRAME_HEADER)
-        if idx < 0:
-            return None, buffer[-1:] if buffer else b''
-        
-        buffer = buffer[idx:]
-        
-        # 检查最小帧长度
-        if len(buffer) < 6:  # 帧头2 + 命令1 + 长度2 + 校验1
-            return None, buffer
-        
-        cmd = buffer[2]
-        length = struct.unpack('<H', buffer[3:5])[0]
-        
-        # 检查完整帧
-        frame_len = 5 + length + 1
-        if len(buffer) < frame_len:
-            return None, buffer
-        
-        data = buffer[5:5+length]
-        checksum = buffer[5+length]
+    def send_encoded(self, frame, audio_bytes=0):
+        """发送已编码的帧 (如转码缓存中的音频帧)"""
+        self.serial.write(frame)
+        if self.capture:
+            self.capture.write(DIR_TX, frame)
+        self.stats['tx_bytes'] += len(frame)
+        self.stats['tx_frames'] += 1
+        self.stats['audio_bytes'] += audio_bytes
+    
+    def supports_seq(self):
+        """设备是否接受带序号的音频帧并做丢包隐藏 (协议 1.6 及以上)"""
+        return bool(self.caps) and self.caps.get('version', (0, 0)) >= (1, 6)
+    
+    def send_audio_frame(self, frame, audio_bytes):
+        """发送已编码的 CMD_AUDIO_DATA 帧 (如转码缓存中的帧)
         
-        # 验证校验和
-        calc_checksum = self.calc_checksum(buffer[2:5+length])
-        if checksum != calc_checksum:
-            print(f"校验和错误: 期望 0x{calc_checksum:02X}, 收到 0x{checksum:02X}")
-            return None, buffer[2:]
+        设备支持时换成带序号的 CMD_AUDIO_SEQ 帧, 设备按序号检测丢帧并合成补偿;
+        开启前向纠错时每组之后补一个校验帧。旧固件原样发送。
+        """
+        if not self.supports_seq():
+            self.send_encoded(frame, audio_bytes)
+            return
+        seq = self.tx_seq
+        self.tx_seq = (seq + 1) & 0xFFFF
+        data = frame[FRAME_HEAD_SIZE:-1]
+        self.send_encoded(encode_frame(CMD_AUDIO_SEQ, struct.pack('<H', seq) + data), audio_bytes)
+        parity = self.fec_tx.add(seq, data) if self.fec_tx else None
+        if parity:
+            self.send_encoded(encode_frame(CMD_AUDIO_FEC, parity))
+    
+    def supports_fec(self):
+        """设备是否支持校验帧前向纠错 (协议 1.7 及以上)"""
+        return bool(self.caps) and self.caps.get('version', (0, 0)) >= (1, 7)
+    
+    def set_fec(self, group):
+        """开启双向前向纠错: 每 group 个音频帧一个校验帧, 可重建组内任意一帧 (0 关闭)
         
-        return (cmd, data), buffer[frame_len:]
+        带宽开销约 1/group; 组越小, 能修复的丢帧越密。
+        """
+        if not self.supports_fec():
+            if group:
+                self.log("设备不支持前向纠错 (需要协议 1.7), 忽略 --fec")
+            return False
+        if group:
+            group = max(2, min(group, self.caps.get('fec_group', FEC_MAX_GROUP)))
+        self.start_rx()
+        if self.command(CMD_SET_FEC, bytes([group])) != ACK_OK:
+            self.log("设备拒绝前向纠错设置")
+            return False
+        self.fec_tx = FecEncoder(group) if group else None
+        if group:
+            # 校验帧比数据帧多校验头, 全双工再多一个流 ID
+            limit = self.caps.get('max_frame', 2048) - FEC_HEADER.size - 1
+            self.chunk_size = min(self.chunk_size, limit) & ~1
+            self.log(f"前向纠错: 每 {group} 帧一个校验帧 (带宽开销 {100 / group:.0f}%)")
+        return True
+    
+    def on_decode_error(self, status):
+        """帧解码错误回调"""
+        if status == FRAME_DECODE_BAD_CHECKSUM:
+            self.log("\n校验和错误, 丢弃一帧")
+        elif status == FRAME_DECODE_BAD_LENGTH:
+            self.log("\n数据长度无效, 重新同步")
     
     def rx_loop(self):
-        """接收循环"""
-        buffer = bytearray()
+        """接收循环 (增量解码，不复制积压数据)"""
+        decoder = FrameDecoder(on_error=self.on_decode_error)
         
         while self.running:
             try:
-                data = self.serial.read(1024)
-                if data:
-                    buffer.extend(data)
-                    
-                    while True:
-                        result, buffer = self.parse_frame(bytes(buffer))
-                        buffer = bytearray(buffer)
-                        
-                        if result is None:
-                            break
-                        
-                        cmd, frame_data = result
-                        self.handle_frame(cmd, frame_data)
-                        
+                data = self.serial.read(max(1024, self.serial.in_waiting))
+                if not data:
+                    continue
+                if self.capture:
+                    self.capture.write(DIR_RX, data)
+                self.stats['rx_bytes'] += len(data)
+                for cmd, frame_data in decoder.feed(data):
+                    self.handle_frame(cmd, frame_data)
+                frames, checksum_errors, length_errors = decoder.stats
+                self.stats['rx_frames'] = frames
+                self.stats['checksum_errors'] = checksum_errors
+                self.stats['length_errors'] = length_errors
+                
             except Exception as e:
                 if self.running:
-                    print(f"接收错误: {e}")
+                    self.log(f"接收错误: {e}")
                 break
     
+    def deliver_audio(self, data):
+        """交付一帧设备发来的音频 (全双工只取麦克风流)"""
+        if self.duplex_active:
+            if not data or data[0] != STREAM_MIC:
+                return
+            data = data[1:]
+        self.stats['audio_bytes'] += len(data)
+        self.stats['rx_audio_bytes'] += len(data)
+        if self.jitter_buffer:
+            self.jitter_buffer.push(data)
+        if self.wav_writer:
+            self.wav_writer.write(data)
+            self.log(f"\r接收音频数据: {self.wav_writer.total_bytes} 字节", end='', flush=True)
+    
     def handle_frame(self, cmd, data):
         """处理接收到的帧"""
         if cmd == CMD_AUDIO_DATA:
-            self.audio_data.extend(data)
-            print(f"\r接收音频数据: {len(self.audio_data)} 字节", end='', flush=True)
+            self.deliver_audio(data)
+        elif cmd == CMD_AUDIO_SEQ:
+            # 设备开启了前向纠错: 缺帧时暂扣后续帧, 校验帧到达后按顺序交付
+            if len(data) >= 2:
+                for frame in self.fec_rx.receive(struct.unpack_from('<H', data)[0], bytes(data[2:])):
+                    self.deliver_audio(frame)
+        elif cmd == CMD_AUDIO_FEC:
+            for frame in self.fec_rx.parity(bytes(data)):
+                self.deliver_audio(frame)
         elif cmd == CMD_ACK:
             if len(data) > 0:
-                print(f"\n收到应答: 命令 0x{data[0]:02X}")
+                status = data[1] if len(data) > 1 else ACK_OK
+                with self.ack_cond:
+                    self.acks[data[0]] = status
+                    self.ack_cond.notify_all()
+                if status == ACK_OK:
+                    self.log(f"\n收到应答: 命令 0x{data[0]:02X}")
+                else:
+                    self.log(f"\n命令 0x{data[0]:02X} 被拒绝 (状态 {status})")
+        elif cmd == CMD_CAPS:
+            self.caps = parse_caps(data)
+            self.caps_event.set()
+        elif cmd == CMD_STATS:
+            self.link_stats = parse_stats(data)
+            self.stats_event.set()
         else:
-            print(f"\n收到未知命令: 0x{cmd:02X}")
+            self.log(f"\n收到未知命令: 0x{cmd:02X}")
     
     def handshake(self):
         """握手"""
-        print("发送握手...")
+        self.log("发送握手...")
         self.send_frame(CMD_HANDSHAKE)
         time.sleep(0.5)
     
-    def start_record(self, output_file, duration=10):
-        """开始录音"""
-        self.audio_data = bytearray()
+    def set_baudrate(self, baud):
+        """切换本机串口波特率 (抓包中同时记录)"""
+        self.serial.flush()
+        self.serial.baudrate = baud
+        self.baudrate = baud
+        if self.capture:
+            self.capture.baud_changed(baud)
+    
+    def start_rx(self):
+        """启动接收线程 (已在运行时直接返回)"""
+        if self.rx_thread and self.rx_thread.is_alive():
+            return
         self.running = True
-        
-        # 启动接收线程
         self.rx_thread = threading.Thread(target=self.rx_loop)
         self.rx_thread.start()
+    
+    def stop_rx(self):
+        """停止接收线程"""
+        self.running = False
+        if self.rx_thread:
+            self.rx_thread.join()
+            self.rx_thread = None
+    
+    def restore_baud(self):
+        """把设备切回初始波特率; 回放可能直接改过串口波特率, 以串口实际值为准"""
+        self.baudrate = self.serial.baudrate
+        if self.baudrate == self.initial_baud:
+            return
+        self.start_rx()
+        if self.command(CMD_SET_LINK, struct.pack('<I', self.initial_baud)) != ACK_OK:
+            self.log(f"设备未切回 {self.initial_baud} bps, 仍为 {self.baudrate} bps")
+            return
+        self.set_baudrate(self.initial_baud)
+        # 设备试用期内收到有效帧才保留新波特率
+        if self.query_caps() is None:
+            self.log(f"切回 {self.initial_baud} bps 后无应答")
+    
+    def probe_caps(self):
+        """查询设备能力; 无应答时按固件支持的波特率逐个探测
+        
+        上次主机异常退出时设备可能停留在协商后的波特率。探测成功后本机串口保持该波特率,
+        断开时由 restore_baud 切回初始波特率。
+        """
+        caps = self.query_caps()
+        if caps:
+            return caps
+        for baud in LINK_BAUD_RATES:
+            if baud == self.initial_baud:
+                continue
+            self.set_baudrate(baud)
+            self.serial.reset_input_buffer()
+            caps = self.query_caps()
+            if caps:
+                self.log(f"设备停留在 {baud} bps")
+                return caps
+        self.set_baudrate(self.initial_baud)
+        return None
+    
+    def query_caps(self, timeout=0.5):
+        """查询设备能力, 旧固件无应答时返回 None
+
+        设备链路空闲后会进入浅睡眠, 唤醒它的那一帧会丢失, 无应答时重发一次。
+        """
+        self.caps = None
+        for _ in range(2):
+            self.caps_event.clear()
+            self.send_frame(CMD_GET_CAPS)
+            if self.caps_event.wait(timeout):
+                break
+        return self.caps
+    
+    def query_stats(self, reset=False, timeout=0.5):
+        """查询设备链路统计, 不支持时返回 None"""
+        self.link_stats = None
+        self.stats_event.clear()
+        self.send_frame(CMD_GET_STATS, bytes([1 if reset else 0]))
+        self.stats_event.wait(timeout)
+        return self.link_stats
+    
+    def set_record_frame(self, size):
+        """设置设备录音帧大小 (字节), 超出设备录音帧上限时不发送"""
+        limit = self.caps.get('max_record_frame') if self.caps else None
+        if limit and size > limit:
+            self.log(f"录音帧 {size} 字节超出设备上限 {limit}")
+            return False
+        self.acks.pop(CMD_SET_TUNING, None)
+        self.send_frame(CMD_SET_TUNING, struct.pack('<H', size))
+        return self.wait_ack(CMD_SET_TUNING) == ACK_OK
+    
+    def calibrate(self, duration=1.0, save=True):
+        """测量链路并保存本设备的最佳帧长/发送节奏/录音帧"""
+        if not self.caps or self.caps.get('version', (0, 0)) < (1, 3):
+            self.log("设备不支持链路统计 (需要协议 1.3), 无法校准")
+            return None
+        self.start_rx()
+        profile = LinkCalibrator(self, duration).run()
+        if profile:
+            self.apply_profile(profile)
+            if save:
+                store = self.profiles or LinkProfileStore()
+                store.put(port_label(self.port), self.caps, profile)
+                self.log(f"已保存到 {store.path}")
+        return profile
+    
+    def apply_profile(self, profile):
+        """使用校准结果 (仅在波特率与校准时一致时调用)"""
+        self.chunk_size = min(profile['chunk_size'], self.caps.get('max_frame', profile['chunk_size'])) & ~1
+        self.pace_factor = profile['pace_factor']
+        if profile.get('record_frame'):
+            self.set_record_frame(profile['record_frame'])
+    
+    def wait_ack(self, cmd, timeout=0.5):
+        """等待指定命令的应答, 返回状态 (超时为 None)"""
+        with self.ack_cond:
+            self.ack_cond.wait_for(lambda: cmd in self.acks, timeout)
+            return self.acks.pop(cmd, None)
+    
+    def command(self, cmd, data=b'', timeout=0.5):
+        """发送命令并等待应答, 记录往返时间; 返回状态 (超时为 None)
+
+        设备的应答走控制通道, 不排在录音/麦克风帧后面, 流传输中往返时间也只有几毫秒,
+        不再需要发送后固定等待。
+        """
+        for _ in range(2):   # 设备浅睡眠时第一帧只用于唤醒, 无应答重发一次
+            with self.ack_cond:
+                self.acks.pop(cmd, None)
+            start = time.monotonic()
+            self.send_frame(cmd, data)
+            status = self.wait_ack(cmd, timeout)
+            if status is not None:
+                break
+        if status is None:
+            self.log(f"\n命令 0x{cmd:02X} 无应答")
+        else:
+            self.cmd_rtt_max_ms = max(self.cmd_rtt_max_ms, (time.monotonic() - start) * 1000)
+        return status
+    
+    def negotiate(self, max_baud=DEFAULT_MAX_BAUD, rate=None):
+        """按设备能力协商波特率、采样率和包大小
+
+        设备不支持 CMD_GET_CAPS (旧固件) 时保持默认参数。
+        """
+        self.start_rx()
+        caps = self.probe_caps()
+        if not caps:
+            self.log("设备未返回能力描述, 使用默认参数")
+            return False
+        
+        # 本设备有校准结果时以校准时的波特率为上限
+        profile = self.profiles.get(port_label(self.port), caps) if self.profiles else None
+        if profile:
+            max_baud = min(max_baud, profile['baud'])
+        
+        try:
+            baud, sample_rate, chunk = choose_link_params(caps, self.baudrate, max_baud, rate)
+        except ValueError as e:
+            self.log(f"协商失败: {e}")
+            return False
+        
+        if baud != self.baudrate:
+            self.acks.pop(CMD_SET_LINK, None)
+            self.send_frame(CMD_SET_LINK, struct.pack('<I', baud))
+            if self.wait_ack(CMD_SET_LINK) == ACK_OK:
+                old = self.baudrate
+                self.set_baudrate(baud)
+                # 以新波特率重新查询, 确认链路可用 (设备超时未收到有效帧会自动回退)
+                if not self.query_caps():
+                    self.log(f"波特率 {baud} 不可用, 回退到 {old}")
+                    self.set_baudrate(old)
+                    time.sleep(2.1)
+                    baud, sample_rate, chunk = choose_link_params(caps, old, old, rate)
+            else:
+                baud = self.baudrate
+                _, sample_rate, chunk = choose_link_params(caps, baud, baud, rate)
+        
+        # 采样率随 SET_FORMAT 下发, 按键触发的录音也使用协商结果
+        self.acks.pop(CMD_SET_FORMAT, None)
+        self.send_frame(CMD_SET_FORMAT, struct.pack('<BI', AUDIO_FORMAT_PCM, sample_rate))
+        if self.wait_ack(CMD_SET_FORMAT) not in (ACK_OK, None):
+            self.log(f"设备拒绝采样率 {sample_rate} Hz, 使用 {caps.get('current_rate', SAMPLE_RATE)} Hz")
+            sample_rate = caps.get('current_rate', SAMPLE_RATE)
+        
+        self.sample_rate = sample_rate
+        self.chunk_size = chunk
+        if profile and profile['baud'] == self.baudrate:
+            self.apply_profile(profile)
+            self.log(f"使用校准参数 ({profile.get('calibrated', '')})")
+        self.log(f"协商结果: 波特率 {self.baudrate}, 采样率 {sample_rate} Hz, 包大小 {self.chunk_size}")
+        return True
+    
+    def send_format(self, audio_format):
+        """设置音频格式; 协商过的设备同时下发 PCM 采样率"""
+        if self.caps:
+            return self.command(CMD_SET_FORMAT, struct.pack('<BI', audio_format, self.sample_rate))
+        return self.command(CMD_SET_FORMAT, bytes([audio_format]))
+    
+    def start_capture(self, filename):
+        """开始记录链路双向原始数据"""
+        self.capture = CaptureWriter(filename, self.baudrate)
+        self.log(f"抓包: {filename}")
+    
+    def replay(self, filename, speed=1.0, info_only=False):
+        """回放抓包并与原始应答比较, 返回是否一致"""
+        reader = CaptureReader(filename)
+        ref_tx, ref_rx = analyze_capture(reader)
+        print_capture_summary(reader, ref_tx, ref_rx, self.log)
+        if info_only:
+            return True
+        self.log("开始回放...")
+        replayer = SessionReplayer(reader, self.serial, speed).run()
+        return print_replay_report(ref_tx, ref_rx, replayer, self.log)
+    
+    def open_wav_writer(self, output_file, rotate_seconds=0, rotate_mb=0):
+        """创建流式 WAV 写入器"""
+        self.wav_writer = StreamingWavWriter(output_file, sample_rate=self.sample_rate,
+                                             rotate_seconds=rotate_seconds,
+                                             rotate_bytes=int(rotate_mb * 1024 * 1024))
+    
+    def close_wav_writer(self):
+        """关闭 WAV 写入器并打印摘要"""
+        if self.wav_writer:
+            self.wav_writer.close()
+            self.wav_writer.print_summary(self.log)
+            self.wav_writer = None
+    
+    def start_record(self, output_file, duration=10, rotate_seconds=0, rotate_mb=0):
+        """开始录音"""
+        self.open_wav_writer(output_file, rotate_seconds, rotate_mb)
+        
+        # 启动接收线程
+        self.start_rx()
         
         # 发送开始录音命令
-        print(f"开始录音, 时长: {duration} 秒...")
+        self.sync_start()
+        self.log(f"开始录音, 时长: {duration} 秒...")
         self.send_frame(CMD_START_RECORD)
         
         try:
-            time.sleep(duration)
+            self.abort.wait(duration)
         except KeyboardInterrupt:
-            print("\n录音被中断")
+            self.log("\n录音被中断")
         
         # 停止录音
-        print("\n停止录音...")
-        self.send_frame(CMD_STOP_RECORD)
-        time.sleep(0.5)
+        self.log("\n停止录音...")
+        self.command(CMD_STOP_RECORD)
+        time.sleep(0.15)    # 应答先于批量通道中剩余的录音帧 (至多 4 帧) 到达
         
-        self.running = False
-        self.rx_thread.join()
+        self.stop_rx()
+        self.report_fec()
         
-        # 保存为 WAV 文件
-        if self.audio_data:
-            self.save_wav(output_file)
+        # 关闭 WAV 文件 (数据已在接收过程中写入)
+        self.close_wav_writer()
+    
+    def open_track(self, filename, host_decode=False, chunk_size=None):
+        """打开播放曲目并打印参数, 失败返回 None"""
+        try:
+            pipeline, audio_format, info = open_playback_stream(
+                filename, self.sample_rate, chunk_size or self.chunk_size,
+                host_decode=host_decode, cache=self.cache)
+        except (OSError, RuntimeError, wave.Error, EOFError) as e:
+            self.log(f"无法打开音频文件: {e}")
+            return None
+        
+        self.log(f"播放文件: {filename}{' (缓存)' if info.get('cached') else ''}")
+        if audio_format == AUDIO_FORMAT_MP3:
+            self.log(f"  格式: MP3 (硬件解码)")
+            self.log(f"  大小: {info['total_bytes']} 字节")
+        elif 'src_rate' in info:
+            self.log(f"  格式: PCM")
+            self.log(f"  源格式: {info['src_rate']} Hz, {info['src_bits']} bit, {info['src_channels']} 声道")
+            if info['converted']:
+                self.log(f"  转换为: {info['rate']} Hz, 16 bit, 单声道")
+            self.log(f"  时长: {info['duration']:.2f} 秒")
         else:
-            print("没有接收到音频数据")
-    
-    def save_wav(self, filename):
-        """保存 WAV 文件"""
-        with wave.open(filename, 'wb') as wf:
-            wf.setnchannels(CHANNELS)
-            wf.setsampwidth(BITS_PER_SAMPLE // 8)
-            wf.setframerate(SAMPLE_RATE)
-            wf.writeframes(bytes(self.audio_data))
-        
-        print(f"已保存: {filename}")
-        print(f"  采样率: {SAMPLE_RATE} Hz")
-        print(f"  位宽: {BITS_PER_SAMPLE} bit")
-        print(f"  声道: {CHANNELS}")
-        print(f"  大小: {len(self.audio_data)} 字节")
-        print(f"  时长: {len(self.audio_data) / (SAMPLE_RATE * CHANNELS * BITS_PER_SAMPLE // 8):.2f} 秒")
-    
-    def load_audio_file(self, filename):
-        """加载音频文件（支持 WAV 和 MP3 格式）
-        
-        返回：(frames, sample_rate, sample_width, channels, audio_format) 或 None
+            self.log(f"  格式: PCM (ffmpeg 解码为 {info['rate']} Hz, 16 bit, 单声道)")
+        return pipeline, audio_format, info
+    
+    def send_interval(self, audio_format):
+        """每包发送间隔 (秒)
+        
+        MP3 需要更长的等待时间，因为 ESP32 需要解码
+        约 50ms 足够 ESP32 解码一个 MP3 帧并写入 I2S
+        PCM 按包时长 × pcm_pace() 发送
         """
-        filepath = Path(filename)
-        if not filepath.exists():
-            print(f"文件不存在: {filename}")
-            return None
+        if audio_format == AUDIO_FORMAT_MP3:
+            return 0.05
+        return self.chunk_size / (self.sample_rate * 2) * self.pcm_pace()
+    
+    def pcm_pace(self):
+        """PCM 发送节奏系数
         
-        ext = filepath.suffix.lower()
-        
-        if ext == '.wav':
-            # 加载 WAV 文件 - 发送 PCM 数据
-            with wave.open(filename, 'rb') as wf:
-                channels = wf.getnchannels()
-                sample_width = wf.getsampwidth()
-                framerate = wf.getframerate()
-                frames = wf.readframes(wf.getnframes())
-            return frames, framerate, sample_width, channels, AUDIO_FORMAT_PCM
-        
-        elif ext == '.mp3':
-            # 加载 MP3 文件 - 直接发送原始 MP3 数据（ESP32端解码）
-            print(f"MP3 文件将由 ESP32 硬件解码")
-            with open(filename, 'rb') as f:
-                frames = f.read()
-            # 返回 MP3 原始数据，采样率/声道由 ESP32 解码后确定
-            return frames, 0, 0, 0, AUDIO_FORMAT_MP3
+        协议 1.5 及以上设备按缓冲深度自适应重采样, 吸收两边的时钟偏差, 按实时发送即可;
+        旧固件按 pace_factor 略快发送 (默认 94%, 可由 calibrate 校准), 设备端缓冲略有富余而不会欠载
+        """
+        if self.caps and self.caps.get('version', (0, 0)) >= (1, 5):
+            return 1.0
+        return self.pace_factor
+    
+    def stream_track(self, pipeline, audio_format, info, next_time):
+        """按绝对时间表发送一个曲目的全部音频帧, 返回下一包的计划发送时间
         
-        else:
-            print(f"不支持的音频格式: {ext}")
-            print("支持的格式: .wav, .mp3")
-            return None
+        时间表跨曲目连续, 转换耗时和曲目切换都不会累积到间隔中。
+        """
+        delay = self.send_interval(audio_format)
+        total = info.get('total_bytes')
+        total_chunks = (total + self.chunk_size - 1) // self.chunk_size if total else None
+        count = 0
+        for frame, n in pipeline.frames():
+            if self.abort.is_set():
+                break
+            wait = next_time - time.monotonic()
+            if wait > 0:
+                time.sleep(wait)
+            self.send_audio_frame(frame, n)
+            # 曲目末尾的 PCM 短包按实际时长计时, 避免设备端缓冲在曲目边界被拉空
+            next_time += delay if audio_format == AUDIO_FORMAT_MP3 else delay * n / self.chunk_size
+            count += 1
+            progress = f"{count}/{total_chunks}" if total_chunks else f"{count}"
+            self.log(f"\r进度: {progress}", end='', flush=True)
+        if pipeline.sender_waits > 1:
+            self.log(f"\n  警告: 发送端等待解码 {pipeline.sender_waits - 1} 次")
+        return next_time
     
-    def play_audio(self, filename):
-        """发送音频文件播放（支持 WAV 和 MP3 格式）"""
-        # 加载音频文件
-        result = self.load_audio_file(filename)
-        if result is None:
-            return
+    def play_audio(self, filename, host_decode=False):
+        """发送音频文件播放（支持 WAV 和 MP3 格式）
         
-        frames, framerate, sample_width, channels, audio_format = result
+        文件经后台线程流式读取/转换/分包，发送端只从预取队列取包，
+        长文件也可立即开始播放，内存占用有界。
+        """
+        track = self.open_track(filename, host_decode)
+        if not track:
+            return
+        pipeline, audio_format, info = track
         
-        print(f"播放文件: {filename}")
-        if audio_format == AUDIO_FORMAT_MP3:
-            print(f"  格式: MP3 (硬件解码)")
-            print(f"  大小: {len(frames)} 字节")
-        else:
-            print(f"  格式: PCM")
-            print(f"  采样率: {framerate} Hz")
-            print(f"  位宽: {sample_width * 8} bit")
-            print(f"  声道: {channels}")
-            print(f"  大小: {len(frames)} 字节")
-            print(f"  时长: {len(frames) / (framerate * channels * sample_width):.2f} 秒")
+        # 先启动解码线程, 命令交互期间即可填满预取队列
+        pipeline.start()
         
         # 启动接收线程
-        self.running = True
-        self.rx_thread = threading.Thread(target=self.rx_loop)
-        self.rx_thread.start()
+        self.start_rx()
+        started = False
         
-        # 发送设置格式命令 (新增)
-        print(f"设置音频格式: {'MP3' if audio_format == AUDIO_FORMAT_MP3 else 'PCM'}")
-        self.send_frame(CMD_SET_FORMAT, bytes([audio_format]))
-        time.sleep(0.2)
+        try:
+            # 发送设置格式命令 (新增)
+            self.log(f"设置音频格式: {'MP3' if audio_format == AUDIO_FORMAT_MP3 else 'PCM'}")
+            self.send_format(audio_format)
+            
+            # 发送开始播放命令
+            self.sync_start()
+            if self.command(CMD_START_PLAY) == ACK_ERR_STATE:
+                raise RuntimeError("设备拒绝开始播放 (正忙或被其他链路占用)")
+            started = True
+            
+            self.log(f"发送音频数据... (包大小: {self.chunk_size}, "
+                     f"间隔: {int(self.send_interval(audio_format) * 1000)}ms)")
+            self.stream_track(pipeline, audio_format, info, time.monotonic())
+            self.log("\n发送完成")
+        except Exception as e:
+            self.log(f"\n播放失败: {e}")
+        finally:
+            pipeline.stop()
         
-        # 发送开始播放命令
-        self.send_frame(CMD_START_PLAY)
-        time.sleep(0.5)
+        # 停止播放 (未开始时不发, 以免停掉其他链路的会话)
+        if started:
+            time.sleep(0.5)
+            if self.fec_tx:
+                self.report_fec(self.query_stats())
+            self.command(CMD_STOP_PLAY)
         
-        # 分包发送音频数据
-        # 使用较小的包大小和更长的间隔以提高可靠性
-        chunk_size = 512  # 统一使用 512 字节包大小
-        total_chunks = (len(frames) + chunk_size - 1) // chunk_size
+        self.stop_rx()
+    
+    def report_fec(self, st=None):
+        """打印前向纠错统计 (未收到校验帧的方向不打印)"""
+        fr = self.fec_rx.stats
+        if fr['parity']:
+            self.log(f"前向纠错 (设备 → 本机): 校验帧 {fr['parity']}, 丢帧 {fr['lost']}, "
+                     f"重建 {fr['recovered']}, 未能重建 {fr['failed']}")
+        if st and st.get('fec_parity'):
+            self.log(f"前向纠错 (本机 → 设备): 校验帧 {st['fec_parity']}, 丢帧 {st['seq_lost']}, "
+                     f"重建 {st['fec_recovered']}, 未能重建 {st['fec_failed']}")
+    
+    def supports_gapless(self):
+        """设备是否支持 CMD_NEXT_TRACK (协议 1.2 及以上)"""
+        return bool(self.caps) and self.caps.get('version', (0, 0)) >= (1, 2)
+    
+    def play_playlist(self, files, host_decode=False):
+        """无缝连续播放多个文件
         
-        # MP3 需要更长的等待时间，因为 ESP32 需要解码
-        # 约 50ms 足够 ESP32 解码一个 MP3 帧并写入 I2S
-        delay = 0.05 if audio_format == AUDIO_FORMAT_MP3 else 0.03
+        设备整个列表只开始/停止播放一次, I2S 保持运行; 曲目之间发送
+        CMD_NEXT_TRACK 标记边界 (仅在格式变化时重建解码器)。当前曲目发送时
+        下一曲目已在后台解码预取, 发送时间表跨曲目连续, 曲目之间没有空隙。
+        旧固件不支持时逐个播放。
+        """
+        if not self.supports_gapless():
+            self.log("设备不支持无缝播放, 逐个播放")
+            for filename in files:
+                if self.abort.is_set():
+                    break
+                self.play_audio(filename, host_decode)
+            return
         
-        print(f"发送音频数据... (包大小: {chunk_size}, 间隔: {int(delay*1000)}ms)")
-        for i in range(0, len(frames), chunk_size):
-            chunk = frames[i:i+chunk_size]
-            self.send_frame(CMD_AUDIO_DATA, chunk)
-            print(f"\r进度: {i // chunk_size + 1}/{total_chunks}", end='', flush=True)
-            time.sleep(delay)
+        # 打开第一个可用曲目
+        pending = list(files)
+        current = None
+        while pending and not current:
+            current = self.open_track(pending.pop(0), host_decode)
+        if not current:
+            return
+        current[0].start()
         
-        print("\n发送完成")
+        self.start_rx()
+        played = 0
+        following = None
+        started = False
+        try:
+            pipeline, audio_format, info = current
+            self.send_format(audio_format)
+            self.sync_start()
+            if self.command(CMD_START_PLAY) == ACK_ERR_STATE:
+                raise RuntimeError("设备拒绝开始播放 (正忙或被其他链路占用)")
+            started = True
+            
+            next_time = time.monotonic()
+            while current and not self.abort.is_set():
+                pipeline, audio_format, info = current
+                
+                # 预取下一曲目: 在当前曲目发送期间完成打开和首批解码
+                following = None
+                while pending and not following:
+                    following = self.open_track(pending.pop(0), host_decode)
+                if following:
+                    following[0].start()
+                
+                try:
+                    next_time = self.stream_track(pipeline, audio_format, info, next_time)
+                finally:
+                    pipeline.stop()
+                played += 1
+                self.log(f"\n曲目 {played} 发送完成")
+                
+                current = following
+                if current and not self.abort.is_set():
+                    _, next_format, _ = current
+                    payload = struct.pack('<BI', next_format, self.sample_rate)
+                    self.send_frame(CMD_NEXT_TRACK, payload)
+            
+            self.log(f"播放列表发送完成, 共 {played} 首")
+        except Exception as e:
+            self.log(f"\n播放失败: {e}")
+        finally:
+            for track in (current, following):
+                if track:
+                    track[0].stop()
         
-        # 停止播放
-        time.sleep(0.5)
-        self.send_frame(CMD_STOP_PLAY)
+        # 等待设备播完缓冲区后停止
+        if started:
+            time.sleep(0.5)
+            self.command(CMD_STOP_PLAY)
+        self.stop_rx()
+    
+    def supports_duplex(self):
+        """设备是否支持全双工 (协议 1.4 及以上)"""
+        return bool(self.caps) and self.caps.get('version', (0, 0)) >= (1, 4)
+    
+    def supports_aec(self):
+        """设备是否支持全双工回声消除 (协议 1.8 及以上)"""
+        return bool(self.caps) and self.caps.get('version', (0, 0)) >= (1, 8)
+    
+    def send_speaker_stream(self, source, end_time=None):
+        """发送喇叭流 (带流 ID)
         
-        self.running = False
-        self.rx_thread.join()
+        文件按采样时钟时间表发送; 本机麦克风由声卡时钟驱动, 到达即发。
+        与麦克风接收方向互不等待, 各自按自己的时钟流动。
+        """
+        prefix = bytes([STREAM_SPK])
+        live = getattr(source, 'live', False)
+        next_time = time.monotonic()
+        for chunk in source.chunks():
+            if self.abort.is_set() or not self.running:
+                break
+            if end_time and time.monotonic() >= end_time:
+                break
+            if not live:
+                wait = next_time - time.monotonic()
+                if wait > 0:
+                    time.sleep(wait)
+                next_time += len(chunk) / (self.sample_rate * 2) * self.pcm_pace()
+            self.send_audio_frame(encode_frame(CMD_AUDIO_DATA, prefix + chunk), len(chunk))
+    
+    def duplex(self, filename=None, sink=None, device=None, save=None, duration=0, aec=True):
+        """全双工对讲: 设备麦克风 → 本地输出, 文件或本机麦克风 → 设备喇叭
+        
+        设备录音和播放共用一个采样率 (仅 PCM); 音频帧首字节为流 ID。
+        aec 为 False 时关闭设备端回声消除 (对比效果或外接耳机时用)。
+        """
+        if not self.supports_duplex():
+            self.log("设备不支持全双工 (需要协议 1.4)")
+            return
+        
+        # 数据字段要多放一个流 ID 字节
+        chunk = min(self.chunk_size, self.caps.get('max_frame', 2048) - 2)
+        if filename:
+            track = self.open_track(filename, host_decode=True, chunk_size=chunk)
+            if not track:
+                return
+            source = track[0]
+        else:
+            try:
+                source = SoundDeviceSource(self.sample_rate, chunk, device)
+            except Exception as e:
+                self.log(f"无法打开本机麦克风: {e}")
+                return
+        
+        self.jitter_buffer = JitterBuffer(self.sample_rate)
+        try:
+            output = open_sink(self.jitter_buffer, sink, device)
+        except Exception as e:
+            self.log(f"无法打开音频输出: {e}")
+            self.jitter_buffer = None
+            return
+        if save:
+            self.open_wav_writer(save)
+        
+        self.start_rx()
+        self.query_stats(reset=True)
+        if self.supports_aec():
+            # 设备记住开关状态, 每次都明确设置
+            if self.command(CMD_SET_AEC, bytes([1 if aec else 0])) != ACK_OK:
+                self.log("设备拒绝回声消除设置")
+        elif not aec:
+            self.log("设备不支持回声消除 (需要协议 1.8), 忽略 --no-aec")
+        self.acks.pop(CMD_START_DUPLEX, None)
+        self.duplex_active = True
+        self.send_frame(CMD_START_DUPLEX, struct.pack('<I', self.sample_rate))
+        if self.wait_ack(CMD_START_DUPLEX) != ACK_OK:
+            self.log("设备拒绝进入全双工")
+            self.duplex_active = False
+            self.stop_rx()
+            self.jitter_buffer = None
+            self.close_wav_writer()
+            return
+        
+        output.start()
+        source.start()
+        self.log(f"全双工对讲中 ({self.sample_rate} Hz, 包大小 {chunk}), 按 Ctrl+C 退出")
+        try:
+            self.send_speaker_stream(source, time.monotonic() + duration if duration else None)
+            if filename:
+                self.log("文件发送完成")
+        except KeyboardInterrupt:
+            self.log("\n用户中断")
+        finally:
+            source.stop()
+        
+        time.sleep(0.3)
+        st = self.query_stats()
+        self.command(CMD_STOP_DUPLEX)
+        self.duplex_active = False
+        output.stop()
+        self.stop_rx()
+        
+        jb = self.jitter_buffer.snapshot()
+        self.log(f"麦克风流: 接收 {self.stats['rx_audio_bytes']} 字节, 本地欠载 {jb['underruns']}, "
+                 f"丢弃 {jb['dropped_ms']:.0f}ms")
+        if st:
+            self.log(f"设备: 麦克风帧 {st.get('mic_frames', 0)}, 发送通道满丢弃 {st.get('mic_drops', 0)}, "
+                     f"喇叭欠载 {st['play_underruns']}")
+            if 'tx_delay_max_us_ctrl' in st:
+                self.log(f"发送排队: 控制平均 {st['tx_delay_avg_us_ctrl']}us / 最大 {st['tx_delay_max_us_ctrl']}us, "
+                         f"音频最大 {st['tx_delay_max_us_bulk']}us; 命令往返最大 {self.cmd_rtt_max_ms:.1f}ms")
+            if 'cpu1_idle_pct' in st:
+                self.log(f"电源: 估算平均 {st['pm_avg_current_ua'] / 1000:.1f}mA, "
+                         f"CPU 空闲 {st['cpu0_idle_pct']}% / {st['cpu1_idle_pct']}%")
+            if 'stream_level_ms' in st:
+                self.log(f"喇叭缓冲: 深度 {st['stream_level_ms']}ms, 时钟偏差补偿 {st['stream_drift_ppm']:+d}ppm")
+            if 'plc_frames' in st:
+                self.log(f"丢帧: 检测 {st['seq_lost']}, 隐藏 {st['plc_frames']}, 重复/乱序丢弃 {st['seq_late']}")
+            if 'tsm_cycles_max' in st:
+                self.log(f"时长伸缩: 拉长 {st['stream_stretches']} 块, 压缩 {st['stream_compressions']} 块, "
+                         f"单块最大 {st['tsm_cycles_max']} 周期")
+            if st.get('aec_taps'):
+                delay = f"{st['aec_delay'] * 1000 / self.sample_rate:.0f}ms" if st['aec_delay'] else "未锁定"
+                self.log(f"回声消除: {st['aec_taps']} 阶, 参考延迟 {delay}, ERLE {st['aec_erle_db']}dB, "
+                         f"每帧平均 {st['aec_cycles_avg']} / 最大 {st['aec_cycles_max']} 周期, "
+                         f"复位 {st['aec_resets']}")
+            elif 'aec_taps' in st:
+                self.log("回声消除: 未启用")
+        self.report_fec(st)
+        self.jitter_buffer = None
+        self.close_wav_writer()
     
     # 保留 play_wav 作为别名以保持向后兼容
     def play_wav(self, filename):
         """发送 WAV 文件播放（已弃用，请使用 play_audio）"""
         self.play_audio(filename)
 
-    def listen_record(self, output_file):
+    def listen_record(self, output_file, rotate_seconds=0, rotate_mb=0):
         """监听模式：等待按键开始/停止录音"""
-        self.audio_data = bytearray()
-        self.running = True
-        
+        self.open_wav_writer(output_file, rotate_seconds, rotate_mb)
         # 启动接收线程
-        self.rx_thread = threading.Thread(target=self.rx_loop)
-        self.rx_thread.start()
+        self.start_rx()
         
-        print("监听模式已启动")
-        print("按 ESP32 上的 KEY0 开始录音")
-        print("再按 KEY0 停止录音")
-        print("按 Ctrl+C 退出监听模式")
-        print("="*40)
+        self.log("监听模式已启动")
+        self.log("按 ESP32 上的 KEY0 开始录音")
+        self.log("再按 KEY0 停止录音")
+        self.log("按 Ctrl+C 退出监听模式")
+        self.log("="*40)
         
         try:
             while self.running:
                 time.sleep(0.1)
         except KeyboardInterrupt:
-            print("\n用户中断")
+            self.log("\n用户中断")
         
-        self.running = False
-        self.rx_thread.join()
+        self.stop_rx()
         
-        # 保存为 WAV 文件
-        if self.audio_data:
-            self.save_wav(output_file)
+        # 关闭 WAV 文件 (数据已在接收过程中写入)
+        self.close_wav_writer()
+    
+    def soak(self, files=None, duration=600, repeat=1, host_decode=False):
+        """长时间会话后检查设备流路径零堆分配, 返回 True 表示通过
+
+        有文件时按播放列表连续播放 (同一会话), 否则录音 duration 秒 (数据丢弃)。
+        固件需开启 CONFIG_HEAP_USE_HOOKS; 会话中出现堆操作时固件在停止时断言复位, 读不到统计也算失败。
+        """
+        if files:
+            self.play_playlist(files * max(1, repeat), host_decode)
         else:
-            print("没有接收到音频数据")
+            self.start_rx()
+            self.log(f"录音 {duration:.0f} 秒 (数据丢弃)...")
+            if self.command(CMD_START_RECORD) == ACK_OK:
+                try:
+                    self.abort.wait(duration)
+                except KeyboardInterrupt:
+                    self.log("\n测试被中断")
+                self.command(CMD_STOP_RECORD)
+                time.sleep(0.15)
+            self.stop_rx()
+        
+        self.start_rx()
+        st = self.query_stats()
+        self.stop_rx()
+        ops = st.get('heap_ops') if st else None
+        if ops is None:
+            self.log("未读到设备统计 (固件不支持, 或检查失败后已复位)")
+            return False
+        if ops == HEAP_OPS_UNTRACKED:
+            self.log("设备未开启零分配检查 (需 CONFIG_HEAP_USE_HOOKS)")
+            return False
+        self.log(f"会话期间设备堆操作: {ops} 次 -> {'通过' if ops == 0 else '失败'}")
+        return ops == 0
+    
+    def monitor(self, sink=None, device=None, save=None, send_start=True):
+        """实时监听: 录音帧经自适应抖动缓冲送到本地声卡或文件/管道"""
+        self.jitter_buffer = JitterBuffer(self.sample_rate)
+        try:
+            output = open_sink(self.jitter_buffer, sink, device)
+        except Exception as e:
+            self.log(f"无法打开音频输出: {e}")
+            self.jitter_buffer = None
+            return
+        
+        if save:
+            self.open_wav_writer(save)
+        
+        self.start_rx()
+        output.start()
+        
+        if send_start:
+            self.send_frame(CMD_START_RECORD)
+        self.log(f"实时监听中 ({'声卡' if sink is None else sink}), 按 Ctrl+C 退出")
+        
+        try:
+            while self.running and not self.abort.is_set():
+                time.sleep(1.0)
+                st = self.jitter_buffer.snapshot()
+                delay = estimate_delay_ms(st, output.latency_ms, self.baudrate)
+                self.log(f"\r缓冲 {st['depth_ms']:5.1f}ms  门限 {st['prime_ms']:3.0f}ms  "
+                         f"欠载 {st['underruns']}  丢弃 {st['dropped_ms']:.0f}ms  "
+                         f"估算延迟 {delay:5.1f}ms", end='', flush=True)
+        except KeyboardInterrupt:
+            self.log("\n用户中断")
+        
+        if send_start:
+            self.command(CMD_STOP_RECORD)
+        
+        output.stop()
+        self.stop_rx()
+        self.jitter_buffer = None
+        self.close_wav_writer()
+
+
+def print_caps(caps, log=print):
+    """打印设备能力描述"""
+    names = {AUDIO_FORMAT_PCM: 'PCM', AUDIO_FORMAT_MP3: 'MP3'}
+    if 'version' in caps:
+        log(f"  协议版本: {caps['version'][0]}.{caps['version'][1]}")
+    if 'sample_rates' in caps:
+        log(f"  采样率: {', '.join(str(r) for r in caps['sample_rates'])} Hz")
+    if 'formats' in caps:
+        log(f"  格式: {', '.join(names.get(f, hex(f)) for f in caps['formats'])}")
+    if 'bits' in caps:
+        log(f"  PCM: {caps['bits']} bit, {caps['channels']} 声道")
+    if 'max_frame' in caps:
+        log(f"  最大帧数据: {caps['max_frame']} 字节")
+    if 'max_record_frame' in caps:
+        log(f"  录音帧上限: {caps['max_record_frame']} 字节")
+    if 'uart_rx_buf' in caps:
+        log(f"  缓冲区: UART 收 {caps['uart_rx_buf']} / 发 {caps['uart_tx_buf']} 字节, "
+            f"I2S DMA {caps['dma_count']} × {caps['dma_len']}")
+    if 'codecs' in caps:
+        log(f"  解码器: {', '.join(caps['codecs'])}")
+    if 'baud_rates' in caps:
+        log(f"  波特率: {', '.join(str(b) for b in caps['baud_rates'])}")
+    if 'current_rate' in caps:
+        log(f"  当前: {caps['current_rate']} Hz, {caps['current_baud']} bps, "
+            f"录音帧 {caps['record_frame']} 字节")
+    if 'fec_group' in caps:
+        log(f"  前向纠错: 每组最多 {caps['fec_group']} 帧")
+
+
+def load_playlist(files, list_file=None):
+    """合并命令行文件与播放列表文件; 列表中的相对路径相对于列表文件所在目录"""
+    result = list(files)
+    if list_file:
+        base = Path(list_file).parent
+        with open(list_file, 'r', encoding='utf-8') as f:
+            for line in f:
+                line = line.strip()
+                if not line or line.startswith('#'):
+                    continue
+                path = Path(line)
+                result.append(str(path if path.is_absolute() else base / path))
+    return result
+
+
+def port_label(port):
+    """串口名转为可用于文件名/日志的短名 (/dev/ttyUSB0 → ttyUSB0)"""
+    return Path(port).name or port
+
+
+def load_fleet_jobs(args):
+    """解析多设备任务
+
+    --jobs 指定 JSON 文件时每台设备可有不同任务, 例如:
+        [{"port": "COM9", "action": "record", "output": "a.wav", "duration": 30},
+         {"port": "COM10", "action": "play", "file": "prompt.wav"}]
+    否则对逗号分隔的所有串口执行同一任务, 输出文件名中的 {port} 替换为串口短名。
+    """
+    if args.jobs:
+        with open(args.jobs, 'r', encoding='utf-8') as f:
+            jobs = json.load(f)
+    else:
+        jobs = []
+        for port in [p.strip() for p in args.port.split(',') if p.strip()]:
+            job = {'port': port, 'action': args.action}
+            if args.action == 'record':
+                job['output'] = args.output.format(port=port_label(port))
+                job['duration'] = args.duration
+            else:
+                job['file'] = args.target
+            jobs.append(job)
+    
+    for job in jobs:
+        if job.get('action') not in ('record', 'play'):
+            raise ValueError(f"未知任务类型: {job.get('action')}")
+        if job['action'] == 'play' and not job.get('file'):
+            raise ValueError(f"{job['port']}: 播放任务缺少 file")
+        job.setdefault('output', f"recording_{port_label(job['port'])}.wav")
+        job.setdefault('duration', 10)
+    return jobs
+
+
+def run_fleet(jobs, baudrate, negotiate=True, max_baud=DEFAULT_MAX_BAUD, capture=None, cache=None):
+    """并发驱动多块开发板
+
+    每台设备一个工作线程 (各自再带一个接收线程)。所有设备连接并准备好后
+    在同一栅栏处放行, 发出开始命令的时间差即启动偏差。
+    """
+    tools = []
+    for job in jobs:
+        tool = AudioSerialTool(job['port'], job.get('baud', baudrate), name=port_label(job['port']))
+        if tool.connect():
+            tool.cache = cache
+            tool.profiles = LinkProfileStore()
+            if capture:
+                tool.start_capture(capture.format(port=port_label(job['port'])))
+            if negotiate:
+                tool.negotiate(job.get('max_baud', max_baud), job.get('rate'))
+            tools.append((tool, job))
+    
+    if not tools:
+        print("没有可用的设备")
+        return
+    
+    barrier = threading.Barrier(len(tools))
+    results = {}
+    
+    def worker(tool, job):
+        tool.start_barrier = barrier
+        t0 = time.monotonic()
+        ok = True
+        try:
+            if job['action'] == 'record':
+                tool.start_record(job['output'], job['duration'])
+            else:
+                tool.play_audio(job['file'])
+        except Exception as e:
+            tool.log(f"任务失败: {e}")
+            ok = False
+        finally:
+            # 未到达同步点就结束的设备不应拖住其他设备
+            if tool.start_time is None:
+                barrier.abort()
+                ok = False
+            tool.disconnect()
+        results[tool.port] = (ok, time.monotonic() - t0)
+    
+    threads = [threading.Thread(target=worker, args=(tool, job), name=f"fleet_{tool.name}")
+               for tool, job in tools]
+    print(f"启动 {len(threads)} 台设备...")
+    for t in threads:
+        t.start()
+    try:
+        for t in threads:
+            while t.is_alive():
+                t.join(timeout=0.2)
+    except KeyboardInterrupt:
+        print("\n中断所有设备...")
+        for tool, _ in tools:
+            tool.abort.set()
+        for t in threads:
+            t.join()
+    
+    # 汇总
+    starts = [tool.start_time for tool, _ in tools if tool.start_time is not None]
+    base = min(starts) if starts else 0
+    totals = {k: 0 for k in tools[0][0].stats}
+    print("=" * 78)
+    print(f"{'设备':<12}{'任务':<8}{'结果':<6}{'启动偏移':>10}{'耗时':>9}"
+          f"{'发送':>11}{'接收':>11}{'音频速率':>10}{'错误':>6}")
+    for tool, job in tools:
+        ok, elapsed = results.get(tool.port, (False, 0.0))
+        st = tool.stats
+        for k in totals:
+            totals[k] += st[k]
+        offset = f"{(tool.start_time - base) * 1000:.1f}ms" if tool.start_time is not None else '-'
+        audio_rate = st['audio_bytes'] / elapsed / 1024 if elapsed > 0 else 0
+        errors = st['checksum_errors'] + st['length_errors']
+        print(f"{tool.name:<12}{job['action']:<8}{'成功' if ok else '失败':<6}{offset:>10}"
+              f"{elapsed:>8.1f}s{st['tx_bytes']:>11}{st['rx_bytes']:>11}"
+              f"{audio_rate:>7.1f}KB/s{errors:>6}")
+    print("-" * 78)
+    print(f"合计: 发送 {totals['tx_bytes']} 字节 / {totals['tx_frames']} 帧, "
+          f"接收 {totals['rx_bytes']} 字节 / {totals['rx_frames']} 帧, "
+          f"校验错误 {totals['checksum_errors']}, 长度错误 {totals['length_errors']}")
+    if len(starts) > 1:
+        print(f"启动偏差: {(max(starts) - min(starts)) * 1000:.1f} ms")
 
 
 def main():
     parser = argparse.ArgumentParser(description='ESP32-S3 音频串口传输工具')
-    parser.add_argument('port', help='串口名称 (如 COM3 或 /dev/ttyUSB0)')
-    parser.add_argument('--baud', type=int, default=230400, help='波特率 (默认: 230400)')
+    parser.add_argument('port', help='串口名称 (如 COM3 或 /dev/ttyUSB0; fleet 模式可用逗号分隔多个)')
+    parser.add_argument('--baud', type=int, default=230400, help='初始波特率 (默认: 230400)')
+    parser.add_argument('--max-baud', type=int, default=DEFAULT_MAX_BAUD,
+                        help=f'自动协商的波特率上限 (默认: {DEFAULT_MAX_BAUD})')
+    parser.add_argument('--rate', type=int, help='指定 PCM 采样率 (默认: 按链路带宽自动选择)')
+    parser.add_argument('--no-negotiate', action='store_true', help='不查询设备能力, 使用默认参数')
+    parser.add_argument('--profiles', help='链路校准参数文件 (默认: ~/.config/esp32_audio/link_profiles.json)')
+    parser.add_argument('--cache-dir', help='转码缓存目录 (默认: ~/.cache/esp32_audio 或 $AUDIO_CACHE_DIR)')
+    parser.add_argument('--capture', help='记录链路双向原始数据到抓包文件 (fleet 模式可用 {port})')
+    parser.add_argument('--fec', type=int, default=0, metavar='K',
+                        help=f'前向纠错: 双向每 K 个音频帧加一个校验帧, 可重建组内任一丢帧 '
+                             f'(2..{FEC_MAX_GROUP}, 开销 1/K; 默认: 关闭, 需要协议 1.7)')
     
     subparsers = parser.add_subparsers(dest='command', help='命令')
     
@@ -379,17 +1457,80 @@ def main():
     record_parser = subparsers.add_parser('record', help='录音')
     record_parser.add_argument('-o', '--output', default='recording.wav', help='输出文件 (默认: recording.wav)')
     record_parser.add_argument('-d', '--duration', type=int, default=10, help='录音时长(秒) (默认: 10)')
+    record_parser.add_argument('--rotate-seconds', type=float, default=0, help='按时长切分文件(秒) (默认: 不切分)')
+    record_parser.add_argument('--rotate-mb', type=float, default=0, help='按大小切分文件(MB) (默认: 不切分)')
     
     # 播放命令
     play_parser = subparsers.add_parser('play', help='播放音频文件')
-    play_parser.add_argument('file', help='音频文件 (支持 WAV/MP3 格式)')
+    play_parser.add_argument('file', help='音频文件 (支持 WAV/MP3 格式, 安装 ffmpeg 后支持其他格式)')
+    play_parser.add_argument('--host-decode', action='store_true', help='MP3 在 PC 端解码为 PCM 后发送 (需要 ffmpeg)')
+    play_parser.add_argument('--no-cache', action='store_true', help='不使用转码缓存')
+    
+    # 播放列表
+    playlist_parser = subparsers.add_parser('playlist', help='无缝连续播放多个文件')
+    playlist_parser.add_argument('files', nargs='*', help='音频文件')
+    playlist_parser.add_argument('-l', '--list', help='播放列表文件 (每行一个路径, # 开头为注释, 兼容 m3u)')
+    playlist_parser.add_argument('--repeat', type=int, default=1, help='列表重复次数 (默认: 1)')
+    playlist_parser.add_argument('--host-decode', action='store_true', help='MP3 在 PC 端解码为 PCM 后发送 (需要 ffmpeg)')
+    playlist_parser.add_argument('--no-cache', action='store_true', help='不使用转码缓存')
     
     # 握手命令
     subparsers.add_parser('handshake', help='握手测试')
     
+    # 设备能力
+    subparsers.add_parser('caps', help='查询设备能力描述')
+    
+    # 链路校准
+    calibrate_parser = subparsers.add_parser('calibrate', help='测量链路并保存最佳帧长/发送节奏/录音帧')
+    calibrate_parser.add_argument('-t', '--duration', type=float, default=1.0, help='每项测试时长(秒) (默认: 1.0)')
+    calibrate_parser.add_argument('--no-save', action='store_true', help='只测量, 不保存结果')
+    
+    # 转码缓存
+    cache_parser = subparsers.add_parser('cache', help='查看/清空转码缓存')
+    cache_parser.add_argument('--clear', action='store_true', help='清空缓存')
+    
+    # 抓包回放
+    replay_parser = subparsers.add_parser('replay', help='回放抓包文件并比较应答')
+    replay_parser.add_argument('file', help='抓包文件 (由 --capture 生成)')
+    replay_parser.add_argument('--speed', type=float, default=1.0, help='回放速度倍数, 0 为全速 (默认: 1.0)')
+    replay_parser.add_argument('--info', action='store_true', help='只显示抓包统计, 不连接设备')
+    
     # 监听模式
     listen_parser = subparsers.add_parser('listen', help='监听模式（等待按键录音）')
     listen_parser.add_argument('-o', '--output', default='recording.wav', help='输出文件 (默认: recording.wav)')
+    listen_parser.add_argument('--rotate-seconds', type=float, default=0, help='按时长切分文件(秒) (默认: 不切分)')
+    listen_parser.add_argument('--rotate-mb', type=float, default=0, help='按大小切分文件(MB) (默认: 不切分)')
+    
+    # 实时监听
+    monitor_parser = subparsers.add_parser('monitor', help='实时监听开发板麦克风')
+    monitor_parser.add_argument('--sink', help='输出到文件或管道 (- 为标准输出), 默认使用声卡')
+    monitor_parser.add_argument('--device', help='声卡设备名或编号')
+    monitor_parser.add_argument('--save', help='同时保存为 WAV 文件')
+    monitor_parser.add_argument('--no-start', action='store_true', help='不发送开始录音命令 (由 KEY0 触发)')
+    
+    # 全双工对讲
+    duplex_parser = subparsers.add_parser('duplex', help='全双工对讲 (同时录音和播放)')
+    duplex_parser.add_argument('file', nargs='?', help='发送到喇叭的音频文件 (默认: 本机麦克风)')
+    duplex_parser.add_argument('--sink', help='设备麦克风输出到文件或管道 (- 为标准输出), 默认使用声卡')
+    duplex_parser.add_argument('--device', help='声卡设备名或编号')
+    duplex_parser.add_argument('--save', help='同时保存设备麦克风为 WAV 文件')
+    duplex_parser.add_argument('-d', '--duration', type=float, default=0, help='时长(秒) (默认: 直到文件结束或 Ctrl+C)')
+    duplex_parser.add_argument('--no-aec', action='store_true', help='关闭设备端回声消除')
+    
+    # 零分配检查
+    soak_parser = subparsers.add_parser('soak', help='长时间会话后检查设备流路径零堆分配 (固件需开启 CONFIG_HEAP_USE_HOOKS)')
+    soak_parser.add_argument('files', nargs='*', help='连续播放的音频文件 (默认: 录音)')
+    soak_parser.add_argument('-d', '--duration', type=float, default=600, help='录音时长(秒) (默认: 600)')
+    soak_parser.add_argument('--repeat', type=int, default=1, help='播放列表重复次数 (默认: 1)')
+    soak_parser.add_argument('--host-decode', action='store_true', help='MP3 在 PC 端解码为 PCM 后发送 (需要 ffmpeg)')
+    
+    # 多设备模式
+    fleet_parser = subparsers.add_parser('fleet', help='多设备并发录音/播放')
+    fleet_parser.add_argument('action', nargs='?', choices=['record', 'play'], default='record', help='任务类型 (默认: record)')
+    fleet_parser.add_argument('target', nargs='?', help='play: 音频文件')
+    fleet_parser.add_argument('-o', '--output', default='recording_{port}.wav', help='录音输出文件模板 (默认: recording_{port}.wav)')
+    fleet_parser.add_argument('-d', '--duration', type=int, default=10, help='录音时长(秒) (默认: 10)')
+    fleet_parser.add_argument('--jobs', help='JSON 任务文件, 可为每台设备指定不同任务')
     
     args = parser.parse_args()
     
@@ -397,26 +1538,98 @@ def main():
         parser.print_help()
         return
     
+    if args.command == 'cache':
+        cache = TranscodeCache(args.cache_dir)
+        if args.clear:
+            cache.clear()
+        count, size = cache.usage()
+        print(f"转码缓存: {cache.dir}, {count} 个文件, {size / 1024 / 1024:.1f} MB")
+        return
+    
+    if args.command == 'fleet':
+        try:
+            jobs = load_fleet_jobs(args)
+        except (OSError, ValueError, KeyError) as e:
+            print(f"任务配置错误: {e}")
+            return
+        run_fleet(jobs, args.baud, not args.no_negotiate, args.max_baud, args.capture,
+                  TranscodeCache(args.cache_dir))
+        return
+    
+    if args.command == 'replay':
+        tool = AudioSerialTool(args.port, args.baud)
+        try:
+            if args.info:
+                tool.replay(args.file, info_only=True)
+            elif tool.connect():
+                ok = tool.replay(args.file, args.speed)
+                tool.disconnect()
+                sys.exit(0 if ok else 1)
+        except (OSError, ValueError) as e:
+            print(f"回放失败: {e}")
+            sys.exit(1)
+        return
+    
+    if args.command in ('monitor', 'duplex') and args.sink == '-':
+        # 标准输出只用于音频数据 (由 sys.__stdout__ 写出), 日志和其他提示全部改走标准错误
+        sys.stdout = sys.stderr
+    
     tool = AudioSerialTool(args.port, args.baud)
+    # 校准时不套用旧的校准结果
+    profiles = LinkProfileStore(args.profiles)
+    tool.profiles = None if args.command == 'calibrate' else profiles
     
     if not tool.connect():
         return
+    if args.capture:
+        tool.start_capture(args.capture)
     
     try:
+        if args.command == 'caps':
+            tool.start_rx()
+            caps = tool.probe_caps()
+            if caps:
+                tool.log("设备能力:")
+                print_caps(caps, tool.log)
+            else:
+                tool.log("设备未返回能力描述 (固件不支持 CMD_GET_CAPS)")
+            return
+        if not args.no_negotiate:
+            tool.negotiate(args.max_baud, args.rate)
+        if args.fec:
+            tool.set_fec(args.fec)
+        
         if args.command == 'record':
-            tool.start_record(args.output, args.duration)
+            tool.start_record(args.output, args.duration, args.rotate_seconds, args.rotate_mb)
         elif args.command == 'play':
-            tool.play_audio(args.file)
+            if not args.no_cache:
+                tool.cache = TranscodeCache(args.cache_dir)
+            tool.play_audio(args.file, args.host_decode)
+        elif args.command == 'calibrate':
+            tool.profiles = profiles
+            tool.calibrate(args.duration, not args.no_save)
+        elif args.command == 'playlist':
+            files = load_playlist(args.files, args.list) * max(1, args.repeat)
+            if not files:
+                tool.log("播放列表为空")
+                return
+            if not args.no_cache:
+                tool.cache = TranscodeCache(args.cache_dir)
+            tool.play_playlist(files, args.host_decode)
         elif args.command == 'handshake':
-            tool.running = True
-            tool.rx_thread = threading.Thread(target=tool.rx_loop)
-            tool.rx_thread.start()
+            tool.start_rx()
             tool.handshake()
             time.sleep(1)
-            tool.running = False
-            tool.rx_thread.join()
+            tool.stop_rx()
+        elif args.command == 'monitor':
+            tool.monitor(args.sink, args.device, args.save, not args.no_start)
+        elif args.command == 'duplex':
+            tool.duplex(args.file, args.sink, args.device, args.save, args.duration, not args.no_aec)
         elif args.command == 'listen':
-            tool.listen_record(args.output)
+            tool.listen_record(args.output, args.rotate_seconds, args.rotate_mb)
+        elif args.command == 'soak':
+            if not tool.soak(args.files, args.duration, args.repeat, args.host_decode):
+                sys.exit(1)
     except KeyboardInterrupt:
         print("\n操作被中断")
     finally:
@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+音频前向纠错 - PC 端实现 (与固件 audio_fec.c 格式一致)
+
+每组连续序号的音频帧 (CMD_AUDIO_SEQ) 之后跟一个校验帧 (CMD_AUDIO_FEC):
+    [首帧序号 u16][帧数 u8][各帧长度异或 u16][各帧数据按字节异或, 短帧补 0]
+数据指序号之后的全部内容 (全双工含流 ID)。组内恰好缺一帧时, 收到的各帧与校验数据
+再异或一次即为缺失的帧, 不需要重传, 也就没有往返延迟。带宽开销为 1/组大小。
+"""
+
+import struct
+
+FEC_HEADER = struct.Struct('<HBH')
+MAX_GROUP = 8           # 与固件 AUDIO_FEC_MAX_GROUP 一致: 接收方最多暂扣的帧数
+_WINDOW = 32            # 组内序号跨度上限 (与固件 mask 位数一致)
+
+
+def _xor_into(acc, data):
+    """acc ^= data, acc 不够长时补 0"""
+    n = len(data)
+    if n > len(acc):
+        acc.extend(bytes(n - len(acc)))
+    # 整帧按大整数异或, 比逐字节循环快得多
+    acc[:n] = (int.from_bytes(acc[:n], 'little') ^ int.from_bytes(data, 'little')).to_bytes(n, 'little')
+
+
+class FecEncoder:
+    """发送方: 每 group 帧生成一个校验帧"""
+
+    def __init__(self, group):
+        self.group = group
+        self.reset()
+
+    def reset(self):
+        """丢弃未满的组 (开始新会话时调用)"""
+        self.first = None
+        self.count = 0
+        self.len_xor = 0
+        self.acc = bytearray()
+
+    def add(self, seq, data):
+        """加入一帧 (序号之后的数据), 组满时返回校验帧数据, 否则返回 None"""
+        if self.first is None:
+            self.first = seq
+        self.count += 1
+        self.len_xor ^= len(data)
+        _xor_into(self.acc, data)
+        if self.count < self.group:
+            return None
+        parity = FEC_HEADER.pack(self.first, self.count, self.len_xor) + bytes(self.acc)
+        self.reset()
+        return parity
+
+
+class FecDecoder:
+    """接收方: 按序号顺序交付音频帧, 缺一帧时暂扣后续帧等校验帧重建
+
+    receive() / parity() 返回可以按顺序交付的数据列表; 无法重建的帧直接跳过,
+    由上层的抖动缓冲按欠载处理。
+    """
+
+    def __init__(self):
+        self.stats = {'lost': 0, 'late': 0, 'parity': 0, 'recovered': 0, 'failed': 0}
+        self.reset()
+
+    def reset(self):
+        """开始新会话 (设备的序号从 0 重新计数)"""
+        self.expect = None
+        self.hold = None            # 等待重建的序号
+        self.held = []
+        self._reset_group()
+
+    def _reset_group(self):
+        self.base = None
+        self.mask = 0
+        self.len_xor = 0
+        self.acc = bytearray()
+
+    def _add(self, seq, data):
+        if self.base is None:
+            self.base = seq
+        off = (seq - self.base) & 0xFFFF
+        if off >= _WINDOW:
+            self._reset_group()     # 校验帧丢失或序号跳变: 从这一帧重新开始
+            self.base = seq
+            off = 0
+        if self.mask & (1 << off):
+            return
+        self.mask |= 1 << off
+        self.len_xor ^= len(data)
+        _xor_into(self.acc, data)
+
+    def _release(self, rebuilt):
+        out = [rebuilt] if rebuilt else []
+        out += self.held
+        self.held = []
+        self.hold = None
+        return out
+
+    def receive(self, seq, data):
+        """收到一帧带序号的音频 (序号之后的数据)"""
+        out = []
+        gap = (seq - self.expect) & 0xFFFF if self.expect is not None else 0
+        if _WINDOW < gap < 0x10000 - _WINDOW:
+            # 设备重新计数 (按键开始的新会话) 或长时间中断: 放出暂扣的帧后重新同步
+            out += self._release(None)
+            self.reset()
+            gap = 0
+        self._add(seq, data)
+        if self.expect is not None:
+            if gap >= 0x8000:
+                self.stats['late'] += 1
+                return out
+            if gap:
+                self.stats['lost'] += gap
+                if self.hold is not None:
+                    self.stats['failed'] += 1
+                    out += self._release(None)
+                if gap == 1:
+                    self.hold = self.expect
+        self.expect = (seq + 1) & 0xFFFF
+
+        if self.hold is None:
+            out.append(data)
+        else:
+            self.held.append(data)
+            if len(self.held) >= MAX_GROUP:
+                self.stats['failed'] += 1
+                out += self._release(None)
+        return out
+
+    def _recover(self, data):
+        """按校验帧重建, 返回 (结果, 序号, 数据), 结果为 'complete' / 'rebuilt' / 'failed'"""
+        if len(data) < FEC_HEADER.size:
+            return 'failed', None, None
+        first, count, len_xor = FEC_HEADER.unpack_from(data)
+        if not 0 < count <= _WINDOW:
+            return 'failed', None, None
+        full = (1 << count) - 1
+        rel = 0
+        if self.mask:
+            shift = (self.base - first) & 0xFFFF
+            if shift >= count:
+                return 'failed', None, None
+            rel = self.mask << shift
+            if rel & ~full:
+                return 'failed', None, None
+        missing = full & ~rel
+        if not missing:
+            return 'complete', None, None
+        payload = data[FEC_HEADER.size:]
+        length = len_xor ^ self.len_xor
+        if missing & (missing - 1) or length > len(payload):
+            return 'failed', None, None
+        acc = bytearray(self.acc)
+        _xor_into(acc, payload)
+        return 'rebuilt', (first + missing.bit_length() - 1) & 0xFFFF, bytes(acc[:length])
+
+    def parity(self, data):
+        """收到校验帧, 返回重建后可以交付的数据"""
+        self.stats['parity'] += 1
+        result, lost, rebuilt = self._recover(data)
+        self._reset_group()
+
+        if result == 'rebuilt' and self.hold == lost:
+            self.stats['recovered'] += 1
+            return self._release(rebuilt)
+        if result == 'rebuilt' and self.hold is None and lost == self.expect:
+            # 组内最后一帧丢失, 还没有后续帧发现它
+            self.stats['lost'] += 1
+            self.stats['recovered'] += 1
+            self.expect = (lost + 1) & 0xFFFF
+            return [rebuilt]
+        if self.hold is not None:
+            self.stats['failed'] += 1
+            return self._release(None)
+        return []
@@ -0,0 +1,260 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+串口协议帧编解码 - PC 端绑定
+
+与固件共用 components/BSP/UART_AUDIO/frame_codec.c：
+- 存在共享库 (libframe_codec.so / frame_codec.dll / libframe_codec.dylib) 时通过 ctypes 调用 C 实现
+- 否则退回等价的纯 Python 实现（同样是增量、无整块复制的解析）
+
+编译共享库：
+    python tools/frame_codec.py build
+
+也可以通过环境变量 FRAME_CODEC_LIB 指定共享库路径。
+"""
+
+import ctypes
+import os
+import subprocess
+import sys
+from pathlib import Path
+
+FRAME_HEADER = bytes([0xAA, 0x55])
+FRAME_HEAD_SIZE = 5
+FRAME_OVERHEAD = 6
+
+# 解码结果 (与 frame_decode_status_t 一致)
+FRAME_DECODE_NEED_MORE = 0
+FRAME_DECODE_OK = 1
+FRAME_DECODE_BAD_CHECKSUM = 2
+FRAME_DECODE_BAD_LENGTH = 3
+
+# PC 端允许的最大数据长度 (与固件 FRAME_MAX_DATA_SIZE 一致, 超出的长度在解析帧头时即判为错误)
+HOST_MAX_DATA_SIZE = 2048
+
+TOOLS_DIR = Path(__file__).resolve().parent
+CODEC_SOURCE = TOOLS_DIR.parent / 'components' / 'BSP' / 'UART_AUDIO' / 'frame_codec.c'
+
+if sys.platform.startswith('win'):
+    LIB_NAME = 'frame_codec.dll'
+elif sys.platform == 'darwin':
+    LIB_NAME = 'libframe_codec.dylib'
+else:
+    LIB_NAME = 'libframe_codec.so'
+
+
+class _FrameView(ctypes.Structure):
+    _fields_ = [
+        ('cmd', ctypes.c_uint8),
+        ('len', ctypes.c_uint16),
+        ('data', ctypes.c_void_p),
+    ]
+
+
+class _DecoderStats(ctypes.Structure):
+    _fields_ = [
+        ('frames', ctypes.c_uint32),
+        ('checksum_errors', ctypes.c_uint32),
+        ('length_errors', ctypes.c_uint32),
+    ]
+
+
+def _load_library():
+    """加载共享库，失败返回 None"""
+    candidates = []
+    if os.environ.get('FRAME_CODEC_LIB'):
+        candidates.append(Path(os.environ['FRAME_CODEC_LIB']))
+    candidates.append(TOOLS_DIR / LIB_NAME)
+
+    for path in candidates:
+        if not path.exists():
+            continue
+        try:
+            lib = ctypes.CDLL(str(path))
+        except OSError:
+            continue
+
+        lib.frame_checksum.argtypes = [ctypes.c_uint8, ctypes.c_void_p, ctypes.c_size_t]
+        lib.frame_checksum.restype = ctypes.c_uint8
+        lib.frame_encode.argtypes = [ctypes.c_void_p, ctypes.c_size_t, ctypes.c_uint8,
+                                     ctypes.c_char_p, ctypes.c_uint16]
+        lib.frame_encode.restype = ctypes.c_size_t
+        lib.frame_decoder_size.argtypes = []
+        lib.frame_decoder_size.restype = ctypes.c_size_t
+        lib.frame_decoder_init.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint16]
+        lib.frame_decoder_init.restype = None
+        lib.frame_decoder_reset.argtypes = [ctypes.c_void_p]
+        lib.frame_decoder_reset.restype = None
+        lib.frame_decoder_feed.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t,
+                                           ctypes.POINTER(ctypes.c_size_t),
+                                           ctypes.POINTER(_FrameView)]
+        lib.frame_decoder_feed.restype = ctypes.c_int
+        lib.frame_decoder_get_stats.argtypes = [ctypes.c_void_p]
+        lib.frame_decoder_get_stats.restype = ctypes.POINTER(_DecoderStats)
+        return lib
+
+    return None
+
+
+_lib = _load_library()
+NATIVE = _lib is not None
+
+
+def _xor_fold(data):
+    """纯 Python XOR 校验：转为大整数后对半折叠，避免逐字节循环"""
+    n = len(data)
+    if n == 0:
+        return 0
+    x = int.from_bytes(data, 'little')
+    while n > 1:
+        half = (n + 1) // 2
+        x = (x & ((1 << (half * 8)) - 1)) ^ (x >> (half * 8))
+        n = half
+    return x & 0xFF
+
+
+def checksum(data, seed=0):
+    """计算 XOR 校验和"""
+    return seed ^ _xor_fold(data)
+
+
+def encode_frame(cmd, data=b''):
+    """编码完整帧"""
+    length = len(data)
+    if _lib is not None:
+        out = ctypes.create_string_buffer(FRAME_OVERHEAD + length)
+        n = _lib.frame_encode(out, len(out), cmd, bytes(data), length)
+        return out.raw[:n]
+
+    header = bytes([FRAME_HEADER[0], FRAME_HEADER[1], cmd, length & 0xFF, (length >> 8) & 0xFF])
+    return header + bytes(data) + bytes([checksum(header[2:]) ^ _xor_fold(data)])
+
+
+class FrameDecoder:
+    """增量帧解码器
+
+    feed(data) 逐帧产出 (cmd, payload)。解码器只保留跨块的半帧数据，
+    不会在每次解析时复制整个积压缓冲区。
+    """
+
+    def __init__(self, max_len=HOST_MAX_DATA_SIZE, on_error=None):
+        self.max_len = max_len
+        self.on_error = on_error
+        if _lib is not None:
+            self._dec = ctypes.create_string_buffer(_lib.frame_decoder_size())
+            self._payload = ctypes.create_string_buffer(max_len)
+            self._frame = _FrameView()
+            self._consumed = ctypes.c_size_t(0)
+            _lib.frame_decoder_init(self._dec, self._payload, max_len)
+        else:
+            self._pending = bytearray()
+            self._frames = 0
+            self._checksum_errors = 0
+            self._length_errors = 0
+
+    @property
+    def stats(self):
+        """返回 (正确帧数, 校验错误数, 长度错误数)"""
+        if _lib is not None:
+            s = _lib.frame_decoder_get_stats(self._dec).contents
+            return s.frames, s.checksum_errors, s.length_errors
+        return self._frames, self._checksum_errors, self._length_errors
+
+    def reset(self):
+        if _lib is not None:
+            _lib.frame_decoder_reset(self._dec)
+        else:
+            self._pending.clear()
+
+    def _error(self, status):
+        if self.on_error:
+            self.on_error(status)
+
+    def feed(self, data):
+        """喂入一块数据，逐个产出完整帧 (cmd, payload: bytes)"""
+        if not data:
+            return
+        if _lib is not None:
+            yield from self._feed_native(bytes(data))
+        else:
+            yield from self._feed_python(data)
+
+    def _feed_native(self, data):
+        # bytes 对象在本函数内保持存活，C 端直接读取其内存
+        base = ctypes.cast(ctypes.c_char_p(data), ctypes.c_void_p).value
+        offset = 0
+        total = len(data)
+        frame = self._frame
+        consumed = self._consumed
+
+        while offset < total:
+            status = _lib.frame_decoder_feed(self._dec, base + offset, total - offset,
+                                             ctypes.byref(consumed), ctypes.byref(frame))
+            offset += consumed.value
+            if status == FRAME_DECODE_OK:
+                yield frame.cmd, ctypes.string_at(frame.data, frame.len) if frame.len else b''
+            elif status != FRAME_DECODE_NEED_MORE:
+                self._error(status)
+
+    def _feed_python(self, data):
+        buf = self._pending
+        buf.extend(data)
+        view = memoryview(buf)
+        pos = 0
+        end = len(buf)
+
+        try:
+            while True:
+                idx = buf.find(FRAME_HEADER, pos)
+                if idx < 0:
+                    # 保留可能是帧头第一字节的末尾字节
+                    pos = end - 1 if end and buf[-1] == FRAME_HEADER[0] else end
+                    break
+                pos = idx
+                if end - pos < FRAME_OVERHEAD:
+                    break
+
+                length = buf[pos + 3] | (buf[pos + 4] << 8)
+                if length > self.max_len:
+                    self._length_errors += 1
+                    self._error(FRAME_DECODE_BAD_LENGTH)
+                    pos += 1
+                    continue
+
+                frame_len = FRAME_OVERHEAD + length
+                if end - pos < frame_len:
+                    break
+
+                with view[pos + 2:pos + FRAME_HEAD_SIZE + length] as body:
+                    valid = _xor_fold(body) == buf[pos + FRAME_HEAD_SIZE + length]
+                    payload = bytes(body[3:]) if valid else None
+                if valid:
+                    self._frames += 1
+                    yield buf[pos + 2], payload
+                    pos += frame_len
+                else:
+                    # 帧头可能是数据中的巧合或已损坏, 只丢弃第一字节, 从下一字节起重新搜索
+                    self._checksum_errors += 1
+                    self._error(FRAME_DECODE_BAD_CHECKSUM)
+                    pos += 1
+        finally:
+            view.release()
+            # 一次性丢弃已解析的数据
+            del buf[:pos]
+
+
+def build_library(output=None, compiler=None):
+    """用本机 C 编译器编译共享库"""
+    output = Path(output) if output else TOOLS_DIR / LIB_NAME
+    compiler = compiler or os.environ.get('CC', 'cc')
+    cmd = [compiler, '-O2', '-shared', '-fPIC', str(CODEC_SOURCE), '-o', str(output)]
+    print(' '.join(cmd))
+    subprocess.check_call(cmd)
+    return output
+
+
+if __name__ == '__main__':
+    if len(sys.argv) > 1 and sys.argv[1] == 'build':
+        print(f"已生成: {build_library(*sys.argv[2:3])}")
+    else:
+        print(f"frame_codec: {'C 共享库' if NATIVE else '纯 Python'}")
@@ -0,0 +1,258 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+串口链路自动调优
+
+不同 USB 转串口芯片和线缆能稳定承受的帧长和发送速率差别很大。校准分三步,
+每步都依赖设备上报的链路统计 (CMD_GET_STATS):
+
+1. 链路突发测试: 空闲模式下以不同帧长和线路负载发送音频帧, 设备只计数,
+   测量有效吞吐量、错误率和串口接收缓冲区最高占用, 选出最佳帧长。
+2. 播放节奏测试: 以选定帧长实际播放静音, 扫描发送间隔系数, 选出无欠载且
+   缓冲区增长最慢 (最接近实时) 的系数。
+3. 录音帧测试: 扫描设备录音分帧大小, 选出不丢数据的最小帧 (延迟最低)。
+
+结果按 串口 + 设备 MAC 保存, 之后连接同一设备时自动使用。
+"""
+
+import json
+import os
+import struct
+import time
+from pathlib import Path
+
+from frame_codec import FRAME_OVERHEAD, encode_frame
+
+CMD_START_RECORD = 0x01
+CMD_STOP_RECORD = 0x02
+CMD_AUDIO_DATA = 0x03
+CMD_START_PLAY = 0x04
+CMD_STOP_PLAY = 0x05
+
+# 参数文件
+DEFAULT_PROFILE_PATH = Path(os.environ.get('AUDIO_LINK_PROFILES',
+                                           Path.home() / '.config' / 'esp32_audio' / 'link_profiles.json'))
+
+# 扫描范围
+CHUNK_CANDIDATES = (256, 512, 1024, 1536, 2048)
+LOAD_CANDIDATES = (0.70, 0.85, 0.95)          # 线路负载 (占波特率理论字节率的比例)
+PACE_CANDIDATES = (0.94, 0.97, 0.985, 0.995)  # 发送间隔 / 包时长
+RECORD_FRAME_CANDIDATES = (256, 512, 1024)
+
+# 判定门限
+MAX_ERROR_RATE = 0.001          # 允许的帧错误率
+MAX_BUFFER_FILL = 0.5           # 串口接收缓冲区最高占用比例
+MIN_RECORD_DELIVERY = 0.97      # 录音数据到达率
+
+# CMD_STATS 字段 (与固件 link_stats_t 一致)
+STATS_FIELDS = ('frames', 'checksum_errors', 'length_errors', 'audio_bytes',
+                'rx_high_water', 'rx_buf_size', 'play_underruns', 'play_min_slack_ms',
+                'mode_switches', 'mode_latency_max_us', 'mic_frames', 'mic_drops',
+                'mix_blocks', 'mix_cycles_avg', 'mix_cycles_max',
+                'mix_underruns_stream', 'mix_underruns_prompt', 'mix_underruns_aux0', 'mix_underruns_aux1',
+                'play_drops', 'pool_exhausted',
+                'tx_frames_ctrl', 'tx_frames_bulk', 'tx_delay_avg_us_ctrl', 'tx_delay_avg_us_bulk',
+                'tx_delay_max_us_ctrl', 'tx_delay_max_us_bulk', 'tx_drops',
+                'pm_decode_ms', 'pm_session_ms', 'pm_link_ms', 'pm_sleep_ms', 'pm_avg_current_ua',
+                'cpu0_idle_pct', 'cpu1_idle_pct', 'heap_ops', 'stream_drift_ppm', 'stream_level_ms',
+                'stream_stretches', 'stream_compressions', 'tsm_cycles_max',
+                'seq_lost', 'seq_late', 'plc_frames',
+                'fec_parity', 'fec_recovered', 'fec_failed', 'fec_tx_parity',
+                'aec_taps', 'aec_delay', 'aec_erle_db', 'aec_cycles_avg', 'aec_cycles_max', 'aec_resets')
+SIGNED_FIELDS = ('stream_drift_ppm', 'aec_erle_db')
+
+
+def parse_stats(data):
+    n = min(len(data) // 4, len(STATS_FIELDS))
+    values = struct.unpack(f'<{n}I', data[:n * 4])
+    stats = dict(zip(STATS_FIELDS, values))
+    if stats.get('play_min_slack_ms') == 0xFFFFFFFF:
+        stats['play_min_slack_ms'] = None
+    for name in SIGNED_FIELDS:
+        if name in stats:
+            stats[name] = struct.unpack('<i', struct.pack('<I', stats[name]))[0]
+    return stats
+
+
+def device_id(caps):
+    mac = caps.get('device_id')
+    return mac.hex(':') if mac else 'unknown'
+
+
+class LinkProfileStore:
+    """按 串口 + 设备 保存的调优参数"""
+
+    def __init__(self, path=None):
+        self.path = Path(path) if path else DEFAULT_PROFILE_PATH
+
+    def _load(self):
+        try:
+            with open(self.path, 'r', encoding='utf-8') as f:
+                return json.load(f)
+        except (OSError, ValueError):
+            return {}
+
+    @staticmethod
+    def key(port, caps):
+        return f"{port}|{device_id(caps)}"
+
+    def get(self, port, caps):
+        return self._load().get(self.key(port, caps))
+
+    def put(self, port, caps, profile):
+        data = self._load()
+        data[self.key(port, caps)] = profile
+        self.path.parent.mkdir(parents=True, exist_ok=True)
+        tmp = self.path.with_suffix('.tmp')
+        with open(tmp, 'w', encoding='utf-8') as f:
+            json.dump(data, f, indent=2, ensure_ascii=False)
+        os.replace(tmp, self.path)
+
+
+class LinkCalibrator:
+    """在已连接并协商过的 AudioSerialTool 上运行校准"""
+
+    def __init__(self, tool, duration=1.0):
+        self.tool = tool
+        self.duration = duration
+        self.log = tool.log
+
+    def _paced_send(self, frame, payload_len, interval, duration):
+        """按固定间隔发送同一帧, 返回发送帧数"""
+        count = 0
+        start = time.monotonic()
+        end = start + duration
+        next_time = start
+        while next_time < end and not self.tool.abort.is_set():
+            wait = next_time - time.monotonic()
+            if wait > 0:
+                time.sleep(wait)
+            self.tool.send_encoded(frame, payload_len)
+            count += 1
+            next_time += interval
+        return count
+
+    def burst_test(self, chunk, load):
+        """空闲模式下发送音频帧, 设备只计数"""
+        tool = self.tool
+        frame = encode_frame(CMD_AUDIO_DATA, bytes(chunk))
+        interval = (chunk + FRAME_OVERHEAD) * 10 / (tool.baudrate * load)
+        tool.query_stats(reset=True)
+        sent = self._paced_send(frame, chunk, interval, self.duration)
+        time.sleep(0.2)
+        st = tool.query_stats(reset=True)
+        if st is None:
+            return None
+        received = st['audio_bytes'] // chunk
+        errors = st['checksum_errors'] + st['length_errors'] + max(0, sent - received)
+        return {
+            'chunk': chunk, 'load': load, 'sent': sent,
+            'goodput': st['audio_bytes'] / self.duration,
+            'error_rate': errors / sent if sent else 1.0,
+            'buffer_fill': st['rx_high_water'] / st['rx_buf_size'] if st['rx_buf_size'] else 0,
+        }
+
+    def pace_test(self, chunk, pace):
+        """以静音实际播放, 测量欠载和缓冲余量"""
+        tool = self.tool
+        frame = encode_frame(CMD_AUDIO_DATA, bytes(chunk))
+        interval = chunk / (tool.sample_rate * 2) * pace
+        tool.send_format(0)
+        tool.send_frame(CMD_START_PLAY)
+        time.sleep(0.2)
+        tool.query_stats(reset=True)
+        self._paced_send(frame, chunk, interval, self.duration * 1.5)
+        st = tool.query_stats(reset=True)
+        tool.send_frame(CMD_STOP_PLAY)
+        time.sleep(0.2)
+        if st is None:
+            return None
+        return {
+            'pace': pace,
+            'underruns': st['play_underruns'],
+            'min_slack_ms': st['play_min_slack_ms'],
+            'buffer_fill': st['rx_high_water'] / st['rx_buf_size'] if st['rx_buf_size'] else 0,
+        }
+
+    def record_test(self, frame_size):
+        """按指定录音帧大小录音, 测量数据到达率"""
+        tool = self.tool
+        if not tool.set_record_frame(frame_size):
+            return None
+        before = dict(tool.stats)
+        tool.send_frame(CMD_START_RECORD)
+        time.sleep(self.duration)
+        tool.send_frame(CMD_STOP_RECORD)
+        time.sleep(0.3)
+        audio = tool.stats['rx_audio_bytes'] - before['rx_audio_bytes']
+        errors = (tool.stats['checksum_errors'] - before['checksum_errors'] +
+                  tool.stats['length_errors'] - before['length_errors'])
+        expected = tool.sample_rate * 2 * self.duration
+        return {'record_frame': frame_size, 'delivery': audio / expected, 'errors': errors}
+
+    def run(self):
+        tool = self.tool
+        max_frame = tool.caps.get('max_frame', 2048)
+        chunks = [c for c in CHUNK_CANDIDATES if c <= max_frame]
+
+        self.log(f"链路突发测试 ({tool.baudrate} bps, 每项 {self.duration:.1f} 秒):")
+        self.log(f"  {'帧长':>6}{'负载':>7}{'有效吞吐':>12}{'错误率':>9}{'缓冲占用':>9}")
+        bursts = []
+        for chunk in chunks:
+            for load in LOAD_CANDIDATES:
+                r = self.burst_test(chunk, load)
+                if r is None:
+                    continue
+                bursts.append(r)
+                self.log(f"  {chunk:>6}{load:>7.0%}{r['goodput'] / 1024:>9.1f}KB/s"
+                         f"{r['error_rate']:>9.2%}{r['buffer_fill']:>9.0%}")
+        good = [r for r in bursts
+                if r['error_rate'] <= MAX_ERROR_RATE and r['buffer_fill'] <= MAX_BUFFER_FILL]
+        if not good:
+            self.log("所有组合均有错误, 保持默认参数")
+            return None
+        # 吞吐相同时选较小的帧 (延迟低, 单帧出错损失小)
+        best = max(good, key=lambda r: (round(r['goodput'] / 256), -r['chunk']))
+        chunk = best['chunk']
+        self.log(f"选定帧长: {chunk} 字节 (有效吞吐 {best['goodput'] / 1024:.1f} KB/s)")
+
+        self.log(f"播放节奏测试 ({tool.sample_rate} Hz):")
+        pace = None
+        for p in PACE_CANDIDATES:
+            r = self.pace_test(chunk, p)
+            if r is None:
+                continue
+            slack = f"{r['min_slack_ms']}ms" if r['min_slack_ms'] is not None else '-'
+            self.log(f"  间隔系数 {p:.3f}: 欠载 {r['underruns']}, 最小余量 {slack}, "
+                     f"缓冲占用 {r['buffer_fill']:.0%}")
+            if r['underruns'] == 0 and r['buffer_fill'] <= MAX_BUFFER_FILL:
+                pace = p        # 越接近 1 缓冲增长越慢, 继续尝试更大的系数
+        if pace is None:
+            pace = PACE_CANDIDATES[0]
+            self.log(f"  所有系数均有欠载, 使用 {pace}")
+
+        self.log("录音帧测试:")
+        record_frame = None
+        max_record = tool.caps.get('max_record_frame', 2042)
+        for size in [s for s in RECORD_FRAME_CANDIDATES if s <= max_record]:
+            r = self.record_test(size)
+            if r is None:
+                continue
+            self.log(f"  {size} 字节: 到达率 {r['delivery']:.1%}, 错误 {r['errors']}")
+            if record_frame is None and r['delivery'] >= MIN_RECORD_DELIVERY and r['errors'] == 0:
+                record_frame = size
+        if record_frame is None:
+            record_frame = tool.caps.get('record_frame', 512)
+        tool.set_record_frame(record_frame)
+
+        profile = {
+            'baud': tool.baudrate,
+            'sample_rate': tool.sample_rate,
+            'chunk_size': chunk,
+            'pace_factor': pace,
+            'record_frame': record_frame,
+            'goodput': round(best['goodput']),
+            'calibrated': time.strftime('%Y-%m-%d %H:%M:%S'),
+        }
+        self.log(f"校准结果: 帧长 {chunk}, 间隔系数 {pace}, 录音帧 {record_frame}")
+        return profile
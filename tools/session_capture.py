@@ -0,0 +1,312 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+串口会话抓包与回放
+
+抓包文件记录链路双向的原始字节和微秒时间戳，用于复现与时序相关的现场问题，
+也可作为性能回归用例反复回放。
+
+文件格式 (小端):
+    文件头: 魔数 'ASCAP' | 版本(1B) | 初始波特率(u32) | 开始时间(u64, Unix 微秒)
+    记录:   时间增量(u32, 微秒) | 方向(1B) | 长度(u16) | 数据
+方向: 0 = PC→设备, 1 = 设备→PC, 2 = 波特率切换 (数据为 u32 新波特率)
+
+回放把 PC→设备 的数据按原始间隔 (可缩放或全速) 发给设备或模拟器，同时解码
+设备的应答，与抓包中的应答逐帧比较，并报告吞吐量和命令应答延迟。
+"""
+
+import struct
+import threading
+import time
+from collections import Counter
+
+from frame_codec import FrameDecoder
+
+CAPTURE_MAGIC = b'ASCAP'
+CAPTURE_VERSION = 1
+
+DIR_TX = 0          # PC → 设备
+DIR_RX = 1          # 设备 → PC
+DIR_BAUD = 2        # 波特率切换
+
+_FILE_HEADER = struct.Struct('<5sBIQ')
+_RECORD_HEADER = struct.Struct('<IBH')
+_MAX_RECORD = 0xFFFF
+
+# 统计时视为音频数据的命令 (与 audio_tool.CMD_AUDIO_DATA / CMD_AUDIO_SEQ / CMD_AUDIO_FEC 一致)
+CMD_AUDIO_DATA = 0x03
+CMD_AUDIO_SEQ = 0x12
+CMD_AUDIO_FEC = 0x13
+AUDIO_CMDS = (CMD_AUDIO_DATA, CMD_AUDIO_SEQ, CMD_AUDIO_FEC)
+CMD_ACK = 0x07
+
+
+class CaptureWriter:
+    """抓包写入器 (线程安全, 收发线程共用)"""
+
+    def __init__(self, filename, baudrate):
+        self.file = open(filename, 'wb')
+        self.lock = threading.Lock()
+        self.file.write(_FILE_HEADER.pack(CAPTURE_MAGIC, CAPTURE_VERSION, baudrate,
+                                          time.time_ns() // 1000))
+        self.last_ns = time.perf_counter_ns()
+        self.records = 0
+        self.bytes = 0
+
+    def write(self, direction, data):
+        """追加一条记录, 超长数据拆成多条"""
+        if not data:
+            return
+        with self.lock:
+            if not self.file:
+                return
+            now = time.perf_counter_ns()
+            delta = min((now - self.last_ns) // 1000, 0xFFFFFFFF)
+            self.last_ns = now
+            view = memoryview(data)
+            for i in range(0, len(view), _MAX_RECORD):
+                part = view[i:i + _MAX_RECORD]
+                self.file.write(_RECORD_HEADER.pack(delta, direction, len(part)))
+                self.file.write(part)
+                delta = 0
+                self.records += 1
+            self.bytes += len(data)
+
+    def baud_changed(self, baudrate):
+        self.write(DIR_BAUD, struct.pack('<I', baudrate))
+
+    def close(self):
+        with self.lock:
+            if self.file:
+                self.file.close()
+                self.file = None
+
+
+class CaptureReader:
+    """抓包读取器, 逐条产出 (相对时间 us, 方向, 数据)"""
+
+    def __init__(self, filename):
+        self.filename = filename
+        with open(filename, 'rb') as f:
+            head = f.read(_FILE_HEADER.size)
+        if len(head) < _FILE_HEADER.size:
+            raise ValueError("抓包文件过短")
+        magic, version, self.baudrate, self.start_us = _FILE_HEADER.unpack(head)
+        if magic != CAPTURE_MAGIC:
+            raise ValueError("不是抓包文件")
+        if version != CAPTURE_VERSION:
+            raise ValueError(f"不支持的抓包版本: {version}")
+
+    def __iter__(self):
+        t = 0
+        with open(self.filename, 'rb') as f:
+            f.seek(_FILE_HEADER.size)
+            while True:
+                head = f.read(_RECORD_HEADER.size)
+                if len(head) < _RECORD_HEADER.size:
+                    return
+                delta, direction, length = _RECORD_HEADER.unpack(head)
+                data = f.read(length)
+                if len(data) < length:
+                    return          # 进程异常退出时的半条记录
+                t += delta
+                yield t, direction, data
+
+
+class LinkStats:
+    """单向帧统计: 按命令计数, 记录每帧到达时间"""
+
+    def __init__(self):
+        self.bytes = 0
+        self.frames = []            # (时间 us, cmd, payload)
+        self.first_us = None
+        self.last_us = None
+
+    def add(self, t_us, data, decoder):
+        self.bytes += len(data)
+        if self.first_us is None:
+            self.first_us = t_us
+        self.last_us = t_us
+        for cmd, payload in decoder.feed(data):
+            self.frames.append((t_us, cmd, payload))
+
+    @property
+    def duration_s(self):
+        if self.first_us is None:
+            return 0.0
+        return (self.last_us - self.first_us) / 1e6
+
+    @property
+    def throughput(self):
+        """字节/秒"""
+        d = self.duration_s
+        return self.bytes / d if d > 0 else 0.0
+
+    def commands(self):
+        """非音频帧序列 (cmd, payload)"""
+        return [(cmd, payload) for _, cmd, payload in self.frames if cmd not in AUDIO_CMDS]
+
+    def audio_bytes(self):
+        return sum(len(p) for _, cmd, p in self.frames if cmd in AUDIO_CMDS)
+
+
+def ack_latencies(tx, rx):
+    """命令 → 对应 ACK 的延迟 (ms), 按发送顺序配对"""
+    pending = {}
+    for t, cmd, _ in tx.frames:
+        if cmd not in AUDIO_CMDS:
+            pending.setdefault(cmd, []).append(t)
+    latencies = []
+    for t, cmd, payload in rx.frames:
+        if cmd == CMD_ACK and payload and pending.get(payload[0]):
+            sent = pending[payload[0]].pop(0)
+            latencies.append((t - sent) / 1000)
+    return latencies
+
+
+def analyze_capture(reader):
+    """从抓包中统计双向帧 (用作回放的基准)"""
+    tx, rx = LinkStats(), LinkStats()
+    tx_dec, rx_dec = FrameDecoder(), FrameDecoder()
+    for t, direction, data in reader:
+        if direction == DIR_TX:
+            tx.add(t, data, tx_dec)
+        elif direction == DIR_RX:
+            rx.add(t, data, rx_dec)
+    return tx, rx
+
+
+def _percentile(values, p):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p))]
+
+
+def _latency_text(values):
+    if not values:
+        return '-'
+    return (f"平均 {sum(values) / len(values):6.1f}ms  P95 {_percentile(values, 0.95):6.1f}ms  "
+            f"最大 {max(values):6.1f}ms")
+
+
+class SessionReplayer:
+    """按抓包时序向设备回放 PC 端数据并比较应答
+
+    speed: 1.0 为原速, 2.0 为两倍速, 0 为全速 (不等待)。
+    """
+
+    def __init__(self, reader, serial_port, speed=1.0, settle=1.0):
+        self.reader = reader
+        self.serial = serial_port
+        self.speed = speed
+        self.settle = settle        # 发送结束后继续接收应答的时间 (秒)
+        self.running = False
+        self.start_ns = 0
+        self.tx = LinkStats()
+        self.rx = LinkStats()
+        self.late_us = []           # 实际发送时刻相对计划的滞后
+
+    def _now_us(self):
+        return (time.perf_counter_ns() - self.start_ns) // 1000
+
+    def _rx_loop(self):
+        decoder = FrameDecoder()
+        while self.running:
+            data = self.serial.read(max(1024, self.serial.in_waiting))
+            if data:
+                self.rx.add(self._now_us(), data, decoder)
+
+    def run(self):
+        self.serial.baudrate = self.reader.baudrate
+        self.serial.reset_input_buffer()
+        tx_dec = FrameDecoder()
+        self.running = True
+        self.start_ns = time.perf_counter_ns()
+        rx_thread = threading.Thread(target=self._rx_loop, name='replay_rx', daemon=True)
+        rx_thread.start()
+
+        try:
+            for t, direction, data in self.reader:
+                if direction == DIR_RX:
+                    continue
+                if self.speed > 0:
+                    due = t / self.speed
+                    wait = due - self._now_us()
+                    if wait > 0:
+                        time.sleep(wait / 1e6)
+                    self.late_us.append(max(0, self._now_us() - due))
+                if direction == DIR_BAUD:
+                    self.serial.flush()
+                    self.serial.baudrate = struct.unpack('<I', data)[0]
+                    continue
+                self.serial.write(data)
+                self.tx.add(self._now_us(), data, tx_dec)
+            self.serial.flush()
+            time.sleep(self.settle)
+        finally:
+            self.running = False
+            rx_thread.join(timeout=1)
+        return self
+
+
+def compare_sessions(ref_tx, ref_rx, live_tx, live_rx, speed=1.0):
+    """比较回放应答与抓包应答, 返回差异描述列表"""
+    diffs = []
+    ref_cmds = ref_rx.commands()
+    live_cmds = live_rx.commands()
+    for i, (a, b) in enumerate(zip(ref_cmds, live_cmds)):
+        if a != b:
+            diffs.append(f"第 {i + 1} 个应答不同: 抓包 0x{a[0]:02X} {a[1].hex()} / "
+                         f"回放 0x{b[0]:02X} {b[1].hex()}")
+    if len(ref_cmds) != len(live_cmds):
+        diffs.append(f"应答数量不同: 抓包 {len(ref_cmds)} / 回放 {len(live_cmds)}")
+
+    ref_counts = Counter(cmd for _, cmd, _ in ref_rx.frames)
+    live_counts = Counter(cmd for _, cmd, _ in live_rx.frames)
+    for cmd in sorted(set(ref_counts) | set(live_counts)):
+        if cmd in AUDIO_CMDS:
+            continue
+        if ref_counts[cmd] != live_counts[cmd]:
+            diffs.append(f"命令 0x{cmd:02X} 帧数不同: 抓包 {ref_counts[cmd]} / 回放 {live_counts[cmd]}")
+
+    # 音频为实时采集数据, 只比较数量 (按回放速度折算, 允许 10% 偏差; 全速时不比较)
+    ref_audio, live_audio = ref_rx.audio_bytes(), live_rx.audio_bytes()
+    expected = ref_audio / speed if speed > 0 else None
+    if expected and abs(live_audio - expected) > expected * 0.1:
+        diffs.append(f"接收音频量偏差过大: 预期 {expected:.0f} / 回放 {live_audio} 字节")
+    return diffs
+
+
+def print_capture_summary(reader, tx, rx, log=print):
+    start = time.strftime('%Y-%m-%d %H:%M:%S', time.localtime(reader.start_us / 1e6))
+    log(f"抓包: {reader.filename}")
+    log(f"  开始时间: {start}, 初始波特率: {reader.baudrate}")
+    log(f"  PC→设备: {tx.bytes} 字节, {len(tx.frames)} 帧, {tx.throughput / 1024:.2f} KB/s")
+    log(f"  设备→PC: {rx.bytes} 字节, {len(rx.frames)} 帧, {rx.throughput / 1024:.2f} KB/s")
+    log(f"  命令应答延迟: {_latency_text(ack_latencies(tx, rx))}")
+
+
+def print_replay_report(ref_tx, ref_rx, replayer, log=print):
+    live_tx, live_rx = replayer.tx, replayer.rx
+    speed = f"{replayer.speed:g}x" if replayer.speed > 0 else '全速'
+    log(f"回放 ({speed}):")
+    log(f"{'':14}{'抓包':>16}{'回放':>16}")
+    log(f"{'发送吞吐':<12}{ref_tx.throughput / 1024:>13.1f}KB/s{live_tx.throughput / 1024:>13.1f}KB/s")
+    log(f"{'接收吞吐':<12}{ref_rx.throughput / 1024:>13.1f}KB/s{live_rx.throughput / 1024:>13.1f}KB/s")
+    log(f"{'接收帧数':<12}{len(ref_rx.frames):>16}{len(live_rx.frames):>16}")
+    log(f"{'接收音频':<12}{ref_rx.audio_bytes():>16}{live_rx.audio_bytes():>16}")
+    log(f"  抓包应答延迟: {_latency_text(ack_latencies(ref_tx, ref_rx))}")
+    log(f"  回放应答延迟: {_latency_text(ack_latencies(live_tx, live_rx))}")
+    if replayer.speed > 0 and replayer.late_us:
+        late_ms = [u / 1000 for u in replayer.late_us]
+        log(f"  发送调度滞后: 平均 {sum(late_ms) / len(late_ms):.2f}ms, 最大 {max(late_ms):.2f}ms")
+
+    diffs = compare_sessions(ref_tx, ref_rx, live_tx, live_rx, replayer.speed)
+    if diffs:
+        log(f"应答不一致 ({len(diffs)} 项):")
+        for d in diffs[:20]:
+            log(f"  {d}")
+    else:
+        log("应答一致")
+    return not diffs
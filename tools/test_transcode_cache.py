@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+转码缓存回归测试
+
+    python -m unittest test_transcode_cache     (在 tools 目录下运行)
+"""
+
+import struct
+import tempfile
+import unittest
+import wave
+from pathlib import Path
+
+from audio_stream import open_playback_stream
+from transcode_cache import TranscodeCache
+
+
+def write_tone(path, rate=8000, seconds=0.5):
+    """写一个 16bit 单声道 WAV"""
+    frames = int(rate * seconds)
+    with wave.open(str(path), 'wb') as w:
+        w.setnchannels(1)
+        w.setsampwidth(2)
+        w.setframerate(rate)
+        w.writeframes(b''.join(struct.pack('<h', (i * 97) % 4096 - 2048) for i in range(frames)))
+
+
+class RepeatedTrackTest(unittest.TestCase):
+    """播放列表重复同一文件且缓存为空: 预取会为同一键同时打开两个写入者"""
+
+    def setUp(self):
+        self.tmp = tempfile.TemporaryDirectory()
+        self.dir = Path(self.tmp.name)
+        self.wav = self.dir / 'tone.wav'
+        write_tone(self.wav)
+        self.cache = TranscodeCache(self.dir / 'cache')
+
+    def tearDown(self):
+        self.tmp.cleanup()
+
+    def play(self, stream):
+        return [bytes(frame) for frame, _ in stream.start().frames()]
+
+    def test_two_writers_same_key(self):
+        first, _, info1 = open_playback_stream(self.wav, 8000, 512, cache=self.cache)
+        second, _, info2 = open_playback_stream(self.wav, 8000, 512, cache=self.cache)
+        self.assertFalse(info1.get('cached') or info2.get('cached'))
+
+        frames1 = self.play(first)
+        frames2 = self.play(second)
+        self.assertEqual(frames1, frames2)
+
+        cached, _, info = open_playback_stream(self.wav, 8000, 512, cache=self.cache)
+        self.assertTrue(info.get('cached'))
+        self.assertEqual(self.play(cached), frames1)
+        cached.close()
+        self.assertEqual(list((self.dir / 'cache').glob('*.tmp')), [])
+
+
+if __name__ == '__main__':
+    unittest.main()
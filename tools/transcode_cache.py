@@ -0,0 +1,238 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+转码缓存 (按内容寻址)
+
+同一提示音反复播放时，第一次播放边发送边把编码好的音频帧写入缓存，之后的播放
+直接内存映射缓存文件按帧发送，跳过读取、解码、重采样和帧编码。
+
+缓存键 = 源文件内容 SHA-256 + 目标参数 (采样率 / 包大小 / 解码方式)。为避免每次
+都对大文件求哈希，另存一个 (路径, 大小, 修改时间) → 哈希 的索引。
+
+缓存文件格式:
+    魔数 'ATCACHE1' | 描述长度(u32) | 描述 (JSON) | 帧 (完整协议帧, 首尾相接)
+除最后一帧外每帧数据长度均为 chunk_size, 帧位置可直接计算。
+"""
+
+import hashlib
+import json
+import mmap
+import os
+import struct
+import tempfile
+import threading
+from pathlib import Path
+
+from frame_codec import FRAME_HEAD_SIZE, FRAME_OVERHEAD
+
+CACHE_MAGIC = b'ATCACHE1'
+CACHE_VERSION = 1           # 转换算法或格式变化时递增, 旧缓存自动失效
+
+# 默认缓存目录和容量上限
+DEFAULT_CACHE_DIR = Path(os.environ.get('AUDIO_CACHE_DIR',
+                                        Path.home() / '.cache' / 'esp32_audio'))
+DEFAULT_MAX_BYTES = 512 * 1024 * 1024
+
+_HASH_BLOCK = 1024 * 1024
+_HEADER = struct.Struct('<8sI')
+
+
+class CachedStream:
+    """缓存命中时的播放流, 接口与 AudioStreamPipeline 一致"""
+
+    def __init__(self, path):
+        self.file = open(path, 'rb')
+        self.map = mmap.mmap(self.file.fileno(), 0, access=mmap.ACCESS_READ)
+        magic, desc_len = _HEADER.unpack_from(self.map, 0)
+        if magic != CACHE_MAGIC:
+            self.close()
+            raise ValueError("缓存文件损坏")
+        desc = json.loads(self.map[_HEADER.size:_HEADER.size + desc_len])
+        self.audio_format = desc['audio_format']
+        self.info = desc['info']
+        self.chunk_size = desc['chunk_size']
+        self.frame_count = desc['frames']
+        self.offset = _HEADER.size + desc_len
+        self.sender_waits = 0
+        self.stopped = False
+
+    def start(self):
+        return self
+
+    def frames(self):
+        """逐帧产出 (完整协议帧, 数据长度), 帧数据直接引用内存映射"""
+        view = memoryview(self.map)
+        pos = self.offset
+        end = len(self.map)
+        step = FRAME_OVERHEAD + self.chunk_size
+        try:
+            while pos < end and not self.stopped:
+                n = min(step, end - pos)
+                with view[pos:pos + n] as frame:
+                    yield frame, n - FRAME_OVERHEAD
+                pos += n
+        finally:
+            view.release()
+
+    def chunks(self):
+        for frame, n in self.frames():
+            yield bytes(frame[FRAME_HEAD_SIZE:FRAME_HEAD_SIZE + n])
+
+    def stop(self):
+        self.stopped = True
+        try:
+            self.close()
+        except BufferError:     # 帧生成器尚未释放, 由垃圾回收关闭
+            pass
+
+    def close(self):
+        if self.map:
+            self.map.close()
+            self.map = None
+        if self.file:
+            self.file.close()
+            self.file = None
+
+
+class CacheWriter:
+    """边播放边写缓存; 完整播放后 commit 才生效, 中断时丢弃"""
+
+    def __init__(self, cache, key, audio_format, info, chunk_size):
+        self.cache = cache
+        self.key = key
+        self.path = cache.path_for(key)
+        # 同一键可能同时有多个写入者 (播放列表重复曲目时预取), 临时文件名必须唯一
+        fd, tmp = tempfile.mkstemp(prefix=f"{self.path.name}.", suffix='.tmp', dir=self.path.parent)
+        self.tmp = Path(tmp)
+        self.file = os.fdopen(fd, 'wb')
+        self.frames = 0
+        self.payload_bytes = 0
+        # 帧数在写完后才知道, 描述预留固定长度并在 commit 时回填
+        self.desc = {'version': CACHE_VERSION, 'audio_format': audio_format,
+                     'info': info, 'chunk_size': chunk_size, 'frames': 0}
+        self.desc_len = len(json.dumps(self.desc)) + 64
+        self.file.write(_HEADER.pack(CACHE_MAGIC, self.desc_len))
+        self.file.write(bytes(self.desc_len))
+
+    def add(self, frame):
+        self.file.write(frame)
+        self.frames += 1
+        self.payload_bytes += len(frame) - FRAME_OVERHEAD
+
+    def commit(self):
+        self.desc['frames'] = self.frames
+        self.desc['info']['total_bytes'] = self.payload_bytes
+        desc = json.dumps(self.desc).encode().ljust(self.desc_len)
+        self.file.seek(_HEADER.size)
+        self.file.write(desc)
+        self.file.close()
+        os.replace(self.tmp, self.path)
+        self.cache.prune()
+
+    def discard(self):
+        if not self.file.closed:
+            self.file.close()
+        try:
+            os.unlink(self.tmp)
+        except OSError:
+            pass
+
+
+class TranscodeCache:
+    """按内容寻址的转码缓存目录"""
+
+    def __init__(self, directory=None, max_bytes=DEFAULT_MAX_BYTES):
+        self.dir = Path(directory) if directory else DEFAULT_CACHE_DIR
+        self.dir.mkdir(parents=True, exist_ok=True)
+        self.max_bytes = max_bytes
+        self.index_path = self.dir / 'index.json'
+        self.lock = threading.Lock()
+        self.index = self._load_index()
+
+    def _load_index(self):
+        try:
+            with open(self.index_path, 'r', encoding='utf-8') as f:
+                return json.load(f)
+        except (OSError, ValueError):
+            return {}
+
+    def _save_index(self):
+        tmp = self.index_path.with_suffix(f'.{os.getpid()}.tmp')
+        with open(tmp, 'w', encoding='utf-8') as f:
+            json.dump(self.index, f)
+        os.replace(tmp, self.index_path)
+
+    def content_hash(self, filename):
+        """文件内容 SHA-256; 路径/大小/修改时间未变时直接使用索引中的结果"""
+        path = str(Path(filename).resolve())
+        st = os.stat(path)
+        stamp = [st.st_size, st.st_mtime_ns]
+        with self.lock:
+            entry = self.index.get(path)
+            if entry and entry[:2] == stamp:
+                return entry[2]
+
+        h = hashlib.sha256()
+        with open(path, 'rb') as f:
+            for block in iter(lambda: f.read(_HASH_BLOCK), b''):
+                h.update(block)
+        digest = h.hexdigest()
+        with self.lock:
+            self.index[path] = stamp + [digest]
+            self._save_index()
+        return digest
+
+    def key(self, filename, rate, chunk_size, host_decode=False):
+        digest = self.content_hash(filename)
+        ext = Path(filename).suffix.lower().lstrip('.')
+        mode = 'host' if host_decode else 'auto'
+        return f"{digest[:32]}-{ext}-{rate}-{chunk_size}-{mode}-v{CACHE_VERSION}"
+
+    def path_for(self, key):
+        return self.dir / f"{key}.frames"
+
+    def open(self, key):
+        """缓存命中返回 CachedStream, 否则返回 None"""
+        path = self.path_for(key)
+        if not path.exists():
+            return None
+        try:
+            stream = CachedStream(path)
+        except (OSError, ValueError, KeyError):
+            return None
+        os.utime(path)          # 用修改时间记录最近使用, 供淘汰
+        return stream
+
+    def writer(self, key, audio_format, info, chunk_size):
+        return CacheWriter(self, key, audio_format, info, chunk_size)
+
+    def prune(self):
+        """超出容量时按最近使用时间淘汰"""
+        files = []
+        for p in self.dir.glob('*.frames'):
+            try:
+                st = p.stat()
+            except OSError:
+                continue
+            files.append((st.st_mtime, st.st_size, p))
+        total = sum(size for _, size, _ in files)
+        for _, size, p in sorted(files):
+            if total <= self.max_bytes:
+                break
+            try:
+                p.unlink()
+                total -= size
+            except OSError:
+                pass
+
+    def clear(self):
+        for p in self.dir.glob('*.frames'):
+            p.unlink()
+        with self.lock:
+            self.index = {}
+            self._save_index()
+
+    def usage(self):
+        """返回 (文件数, 总字节数)"""
+        sizes = [p.stat().st_size for p in self.dir.glob('*.frames')]
+        return len(sizes), sum(sizes)